@@ -9,18 +9,24 @@
 
 #include "MainWindow.h"
 
+#include <cmath>
 #include <QCheckBox>
 #include <QGraphicsView>
 #include <QLabel>
 #include <QPushButton>
 #include <QSettings>
 #include <QSpinBox>
+#include <QStatusBar>
+#include <QThread>
 #include <QTextEdit>
 #include <QLineEdit>
+#include <QWheelEvent>
 #include "ui_MainWindow.h"
+#include "exporter.h"
 #include "game.h"
 #include "graphics.h"
 #include "logger.h"
+#include "spectator.h"
 
 MainWindow::MainWindow(QWidget *parent) :
     QMainWindow(parent),
@@ -47,16 +53,28 @@ MainWindow::MainWindow(QWidget *parent) :
     QObject::connect(m_browseSecondBotDialog, SIGNAL(fileSelected(QString)), secondBotFile, SLOT(setText(QString)));
     QObject::connect(m_browseMapBotDialog, SIGNAL(fileSelected(QString)), mapFile, SLOT(setText(QString)));
 
-    //Set up the game.
+    //Set up the game.  The engine and the bots run on a thread of their own, so that turns
+    //and rendering don't hold each other up.  The window shows a copy of the game, which
+    //the engine brings up to date through queued signals at the end of every turn.
+    qRegisterMetaType<std::string>("std::string");
+    qRegisterMetaType<GameSnapshot>("GameSnapshot");
+    qRegisterMetaType<GameDelta>("GameDelta");
+
+    m_engineThread = new QThread(this);
+    m_engine = new PlanetWarsGame(NULL);
+    m_engine->moveToThread(m_engineThread);
     m_game = new PlanetWarsGame(this);
 
-    Player* firstPlayer = m_game->getFirstPlayer();
-    Player* secondPlayer = m_game->getSecondPlayer();
+    QObject::connect(m_engine, SIGNAL(wasResetTo(GameSnapshot)), m_game, SLOT(showSnapshot(GameSnapshot)));
+    QObject::connect(m_engine, SIGNAL(turnEndedWith(GameDelta)), m_game, SLOT(showDelta(GameDelta)));
+
+    Player* firstPlayer = m_engine->getFirstPlayer();
+    Player* secondPlayer = m_engine->getSecondPlayer();
 
     //Connect the text fields to appropriate game variables.
     QObject::connect(firstBotFile, SIGNAL(textChanged(QString)), firstPlayer, SLOT(setLaunchCommand(QString)));
     QObject::connect(secondBotFile, SIGNAL(textChanged(QString)), secondPlayer, SLOT(setLaunchCommand(QString)));
-    QObject::connect(mapFile, SIGNAL(textChanged(QString)), m_game, SLOT(setMapFileName(QString)));
+    QObject::connect(mapFile, SIGNAL(textChanged(QString)), m_engine, SLOT(setMapFileName(QString)));
 
     //Connect the buttons to the game object controls.
     QPushButton* resetButton = this->findChild<QPushButton*>("resetButton");
@@ -64,10 +82,10 @@ MainWindow::MainWindow(QWidget *parent) :
     QPushButton* pauseButton = this->findChild<QPushButton*>("pauseButton");
     QPushButton* stepButton = this->findChild<QPushButton*>("stepForwardButton");
 
-    QObject::connect(resetButton, SIGNAL(clicked()), m_game, SLOT(reset()));
-    QObject::connect(playButton, SIGNAL(clicked()), m_game, SLOT(run()));
-    QObject::connect(pauseButton, SIGNAL(clicked()), m_game, SLOT(pause()));
-    QObject::connect(stepButton, SIGNAL(clicked()), m_game, SLOT(step()));
+    QObject::connect(resetButton, SIGNAL(clicked()), m_engine, SLOT(reset()));
+    QObject::connect(playButton, SIGNAL(clicked()), m_engine, SLOT(run()));
+    QObject::connect(pauseButton, SIGNAL(clicked()), m_engine, SLOT(pause()));
+    QObject::connect(stepButton, SIGNAL(clicked()), m_engine, SLOT(step()));
 
     //Set up the graphics view.
     PlanetWarsView* planetWarsView = new PlanetWarsView(this);
@@ -76,7 +94,11 @@ MainWindow::MainWindow(QWidget *parent) :
 
     QGraphicsView* gameView = this->findChild<QGraphicsView*>("gameView");
     gameView->setScene(planetWarsView);
+    gameView->setTransformationAnchor(QGraphicsView::AnchorUnderMouse);
+    gameView->viewport()->installEventFilter(this);
+    m_graphicsView = gameView;
     QObject::connect(m_game, SIGNAL(wasReset()), planetWarsView, SLOT(reset()));
+    QObject::connect(planetWarsView, SIGNAL(turnRepainted(qreal,qreal)), this, SLOT(showRepaintedArea(qreal,qreal)));
 
     //Set up the logger
     QTextEdit* logOutput = this->findChild<QTextEdit*>("logOutput");
@@ -86,36 +108,37 @@ MainWindow::MainWindow(QWidget *parent) :
 
     QPushButton* clearLogButton = this->findChild<QPushButton*>("clearLogButton");
     QObject::connect(clearLogButton, SIGNAL(clicked()), logOutput, SLOT(clear()));
+    QObject::connect(m_engine, SIGNAL(wasReset()), logger, SLOT(startNewGame()));
 
     //Connect various parts of the game engine to the logger.
-    QObject::connect(m_game, SIGNAL(logMessage(std::string,QObject*)),
-                     logger, SLOT(recordMessage(std::string,QObject*)));
-    QObject::connect(m_game, SIGNAL(logError(std::string,QObject*)),
-                     logger, SLOT(recordError(std::string,QObject*)));
+    QObject::connect(m_engine, SIGNAL(logMessage(std::string,QString)),
+                     logger, SLOT(recordMessage(std::string,QString)));
+    QObject::connect(m_engine, SIGNAL(logError(std::string,QString)),
+                     logger, SLOT(recordError(std::string,QString)));
 
     //Connect the first player to the logger.
-    QObject::connect(firstPlayer, SIGNAL(logMessage(std::string,QObject*)),
-                     logger, SLOT(recordMessage(std::string,QObject*)));
-    QObject::connect(firstPlayer, SIGNAL(logError(std::string,QObject*)),
-                     logger, SLOT(recordError(std::string,QObject*)));
-    QObject::connect(firstPlayer, SIGNAL(logStdErr(std::string,QObject*)),
-                     logger, SLOT(recordStdErr(std::string,QObject*)));
-    QObject::connect(firstPlayer, SIGNAL(logStdIn(std::string,QObject*)),
-                     logger, SLOT(recordStdIn(std::string,QObject*)));
-    QObject::connect(firstPlayer, SIGNAL(logStdOut(std::string,QObject*)),
-                     logger, SLOT(recordStdOut(std::string,QObject*)));
+    QObject::connect(firstPlayer, SIGNAL(logMessage(std::string,QString)),
+                     logger, SLOT(recordMessage(std::string,QString)));
+    QObject::connect(firstPlayer, SIGNAL(logError(std::string,QString)),
+                     logger, SLOT(recordError(std::string,QString)));
+    QObject::connect(firstPlayer, SIGNAL(logStdErr(std::string,QString)),
+                     logger, SLOT(recordStdErr(std::string,QString)));
+    QObject::connect(firstPlayer, SIGNAL(logStdIn(std::string,QString)),
+                     logger, SLOT(recordStdIn(std::string,QString)));
+    QObject::connect(firstPlayer, SIGNAL(logStdOut(std::string,QString)),
+                     logger, SLOT(recordStdOut(std::string,QString)));
 
     //Connect the second player to the logger.
-    QObject::connect(secondPlayer, SIGNAL(logMessage(std::string,QObject*)),
-                     logger, SLOT(recordMessage(std::string,QObject*)));
-    QObject::connect(secondPlayer, SIGNAL(logError(std::string,QObject*)),
-                     logger, SLOT(recordError(std::string,QObject*)));
-    QObject::connect(secondPlayer, SIGNAL(logStdErr(std::string,QObject*)),
-                     logger, SLOT(recordStdErr(std::string,QObject*)));
-    QObject::connect(secondPlayer, SIGNAL(logStdIn(std::string,QObject*)),
-                     logger, SLOT(recordStdIn(std::string,QObject*)));
-    QObject::connect(secondPlayer, SIGNAL(logStdOut(std::string,QObject*)),
-                     logger, SLOT(recordStdOut(std::string,QObject*)));
+    QObject::connect(secondPlayer, SIGNAL(logMessage(std::string,QString)),
+                     logger, SLOT(recordMessage(std::string,QString)));
+    QObject::connect(secondPlayer, SIGNAL(logError(std::string,QString)),
+                     logger, SLOT(recordError(std::string,QString)));
+    QObject::connect(secondPlayer, SIGNAL(logStdErr(std::string,QString)),
+                     logger, SLOT(recordStdErr(std::string,QString)));
+    QObject::connect(secondPlayer, SIGNAL(logStdIn(std::string,QString)),
+                     logger, SLOT(recordStdIn(std::string,QString)));
+    QObject::connect(secondPlayer, SIGNAL(logStdOut(std::string,QString)),
+                     logger, SLOT(recordStdOut(std::string,QString)));
 
     //Connect logging settings in the GUI to the logger settings.
     QCheckBox* logFirstPlayerStdIn = this->findChild<QCheckBox*>("logFirstPlayerStdIn");
@@ -146,18 +169,18 @@ MainWindow::MainWindow(QWidget *parent) :
     QCheckBox* showGrowthRates = this->findChild<QCheckBox*>("showGrowthRates");
     QCheckBox* showPlanetIds = this->findChild<QCheckBox*>("showPlanetIds");
 
-    m_game->setTurnLength(turnLength->value());
-    m_game->setFirstTurnLength(firstTurnLength->value());
-    m_game->setTimerIgnored(ignoreTimer->isChecked());
-    m_game->setMaxTurns(maxTurns->value());
+    m_engine->setTurnLength(turnLength->value());
+    m_engine->setFirstTurnLength(firstTurnLength->value());
+    m_engine->setTimerIgnored(ignoreTimer->isChecked());
+    m_engine->setMaxTurns(maxTurns->value());
 
     planetWarsView->setShowGrowthRates(showGrowthRates->isChecked());
     planetWarsView->setShowPlanetIds(showPlanetIds->isChecked());
 
-    QObject::connect(turnLength, SIGNAL(valueChanged(int)), m_game, SLOT(setTurnLength(int)));
-    QObject::connect(firstTurnLength, SIGNAL(valueChanged(int)), m_game, SLOT(setFirstTurnLength(int)));
-    QObject::connect(ignoreTimer, SIGNAL(toggled(bool)), m_game, SLOT(setTimerIgnored(bool)));
-    QObject::connect(maxTurns, SIGNAL(valueChanged(int)), m_game, SLOT(setMaxTurns(int)));
+    QObject::connect(turnLength, SIGNAL(valueChanged(int)), m_engine, SLOT(setTurnLength(int)));
+    QObject::connect(firstTurnLength, SIGNAL(valueChanged(int)), m_engine, SLOT(setFirstTurnLength(int)));
+    QObject::connect(ignoreTimer, SIGNAL(toggled(bool)), m_engine, SLOT(setTimerIgnored(bool)));
+    QObject::connect(maxTurns, SIGNAL(valueChanged(int)), m_engine, SLOT(setMaxTurns(int)));
 
     QObject::connect(ignoreTimer, SIGNAL(clicked(bool)), turnLength, SLOT(setDisabled(bool)));
     QObject::connect(ignoreTimer, SIGNAL(clicked(bool)), firstTurnLength, SLOT(setDisabled(bool)));
@@ -185,13 +208,79 @@ MainWindow::MainWindow(QWidget *parent) :
     logSecondPlayerStdIn->setChecked(settings.value("logSecondPlayerStdIn", false).toBool());
     logSecondPlayerStdOut->setChecked(settings.value("logSecondPlayerStdOut", false).toBool());
     logSecondPlayerStdErr->setChecked(settings.value("logSecondPlayerStdErr", false).toBool());
+
+    //Log size limits and the on-disk copy of the log.
+    RotatingLogFile* logFile = logger->getLogFile();
+    logger->setMaxBlockCount(settings.value("logMaxBlocks", 5000).toInt());
+    logFile->setDirectory(settings.value("logDirectory", "logs").toString());
+    logFile->setMaxFileSize(settings.value("logMaxFileSizeMb", 16).toLongLong() * 1024 * 1024);
+    logFile->setMaxFiles(settings.value("logMaxFiles", 10).toInt());
+    logFile->setCompressed(settings.value("logCompress", false).toBool());
+    logFile->setPerGame(settings.value("logPerGame", false).toBool());
+    logFile->setEnabled(settings.value("logToFile", false).toBool());
+
+    //Recording of the games.
+    m_replayFileName = settings.value("replayFileName", "").toString();
+    m_engine->setReplayFileName(m_replayFileName);
+
+    //Turn lengths in CPU time rather than wall time.
+    m_isCpuTimed = settings.value("isCpuTimed", false).toBool();
+    m_engine->setCpuTimed(m_isCpuTimed);
+    m_frameExporter = NULL;
+    QString exportFramesDirectory = settings.value("exportFramesDirectory", "").toString();
+
+    if (!exportFramesDirectory.isEmpty()) {
+        m_frameExporter = new FrameExporter(this);
+        m_frameExporter->setOutputDirectory(exportFramesDirectory);
+        m_frameExporter->setGame(m_game);
+
+        //The frames are only done once the engine has stopped playing.
+        QObject::connect(m_engine, SIGNAL(stopped()), m_frameExporter, SLOT(finishGame()));
+        QObject::connect(m_frameExporter, SIGNAL(logError(std::string,QString)),
+                         logger, SLOT(recordError(std::string,QString)));
+    }
+
+    m_spectatorServer = NULL;
+    m_spectatorClient = NULL;
+
+    //Everything is connected; let the engine go.
+    m_engineThread->start();
 }
 
 MainWindow::~MainWindow()
 {
+    //The engine and its bot processes get destroyed on the engine thread as it finishes.
+    m_engine->deleteLater();
+    m_engineThread->quit();
+    m_engineThread->wait();
+
     delete ui;
 }
 
+bool MainWindow::startSpectatorServer(const QString &address) {
+    if (NULL == m_spectatorServer) {
+        m_spectatorServer = new SpectatorServer(this);
+        m_spectatorServer->setGame(m_game);
+    }
+
+    return m_spectatorServer->listen(address);
+}
+
+void MainWindow::spectate(const QString &address) {
+    if (NULL == m_spectatorClient) {
+        m_spectatorClient = new SpectatorClient(m_game, this);
+
+        QObject::connect(m_spectatorClient, SIGNAL(logMessage(std::string,QString)),
+                         m_logger, SLOT(recordMessage(std::string,QString)));
+        QObject::connect(m_spectatorClient, SIGNAL(logError(std::string,QString)),
+                         m_logger, SLOT(recordError(std::string,QString)));
+    }
+
+    //The games come from the server, so there's nothing to start here.
+    ui->playButton->setEnabled(false);
+    m_spectatorClient->connectToServer(address);
+}
+
 void MainWindow::on_browseFirstBotButton_clicked()
 {
     m_browseFirstBotDialog->open();
@@ -211,14 +300,16 @@ void MainWindow::closeEvent(QCloseEvent* event) {
     //Store the settings.
     QSettings settings("PlanetWarrior.ini", QSettings::IniFormat);
 
-    settings.setValue("firstPlayer", m_game->getFirstPlayer()->getLaunchCommand().c_str());
-    settings.setValue("secondPlayer", m_game->getSecondPlayer()->getLaunchCommand().c_str());
-    settings.setValue("mapFileName", m_game->getMapFileName().c_str());
+    //The engine belongs to another thread, so read its settings off the inputs that feed it.
+    settings.setValue("firstPlayer", ui->firstBotFile->text());
+    settings.setValue("secondPlayer", ui->secondBotFile->text());
+    settings.setValue("mapFileName", ui->mapFile->text());
 
-    settings.setValue("turnLength", m_game->getTurnLength());
-    settings.setValue("firstTurnLength", m_game->getFirstTurnLength());
-    settings.setValue("isTimerIgnored", m_game->isTimerIgnored());
-    settings.setValue("maxTurns", m_game->getMaxTurns());
+    settings.setValue("turnLength", ui->turnLength->value());
+    settings.setValue("firstTurnLength", ui->firstTurnLength->value());
+    settings.setValue("isTimerIgnored", ui->ignoreTimer->isChecked());
+    settings.setValue("maxTurns", ui->maxTurns->value());
+    settings.setValue("isCpuTimed", m_isCpuTimed);
     settings.setValue("showGrowthRates", m_gameView->getShowGrowthRates());
     settings.setValue("showPlanetIds", m_gameView->getShowPlanetIds());
 
@@ -229,9 +320,42 @@ void MainWindow::closeEvent(QCloseEvent* event) {
     settings.setValue("logSecondPlayerStdOut", m_logger->isLoggingSecondPlayerStdOut());
     settings.setValue("logSecondPlayerStdErr", m_logger->isLoggingSecondPlayerStdErr());
 
+    RotatingLogFile* logFile = m_logger->getLogFile();
+    settings.setValue("logMaxBlocks", m_logger->getMaxBlockCount());
+    settings.setValue("logToFile", logFile->isEnabled());
+    settings.setValue("logDirectory", logFile->getDirectory());
+    settings.setValue("logMaxFileSizeMb", logFile->getMaxFileSize() / (1024 * 1024));
+    settings.setValue("logMaxFiles", logFile->getMaxFiles());
+    settings.setValue("logCompress", logFile->isCompressed());
+    settings.setValue("logPerGame", logFile->isPerGame());
+
+    settings.setValue("replayFileName", m_replayFileName);
+    settings.setValue("exportFramesDirectory", m_frameExporter != NULL ? m_frameExporter->getOutputDirectory() : QString());
+
     event->accept();
 }
 
+bool MainWindow::eventFilter(QObject *watched, QEvent *event) {
+    if (watched == m_graphicsView->viewport() && QEvent::Wheel == event->type()) {
+        //Each notch of the wheel zooms in or out by 15%.
+        QWheelEvent* wheelEvent = static_cast<QWheelEvent*>(event);
+        const qreal factor = pow(1.15, wheelEvent->delta() / 120.0);
+        m_graphicsView->scale(factor, factor);
+        return true;
+    }
+
+    return QMainWindow::eventFilter(watched, event);
+}
+
+void MainWindow::showRepaintedArea(qreal invalidatedArea, qreal mapArea) {
+    if (mapArea <= 0) {
+        return;
+    }
+
+    this->statusBar()->showMessage(QString("Repainted %1% of the map on the last turn.")
+                                   .arg(100 * invalidatedArea / mapArea, 0, 'f', 1));
+}
+
 void MainWindow::on_playButton_clicked()
 {
 
@@ -239,5 +363,5 @@ void MainWindow::on_playButton_clicked()
 
 void MainWindow::on_renderDelay_valueChanged(int value)
 {
-    m_game->setRenderDelay(value);
+    QMetaObject::invokeMethod(m_engine, "setRenderDelay", Q_ARG(int, value));
 }
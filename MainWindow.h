@@ -18,6 +18,11 @@
 class PlanetWarsGame;
 class PlanetWarsView;
 class Logger;
+class FrameExporter;
+class SpectatorServer;
+class SpectatorClient;
+class QGraphicsView;
+class QThread;
 
 namespace Ui {
     class MainWindow;
@@ -32,10 +37,17 @@ public:
     explicit MainWindow(QWidget *parent = 0);
     ~MainWindow();
 
+    //Broadcast the games played in this window to spectators.
+    bool startSpectatorServer(const QString& address);
+
+    //Show the games broadcast by another instance instead of running them.
+    void spectate(const QString& address);
+
 private:
     Ui::MainWindow *ui;
 
 private slots:
+    void showRepaintedArea(qreal invalidatedArea, qreal mapArea);
     void on_renderDelay_valueChanged(int value);
     void on_playButton_clicked();
     void on_browseMapFileButton_clicked();
@@ -45,14 +57,25 @@ private slots:
 protected:
     void closeEvent(QCloseEvent *);
 
+    //Zoom the game view with the mouse wheel.
+    bool eventFilter(QObject* watched, QEvent* event);
+
 private:
     QFileDialog* m_browseFirstBotDialog;
     QFileDialog* m_browseSecondBotDialog;
     QFileDialog* m_browseMapBotDialog;
 
-    PlanetWarsGame* m_game;
+    PlanetWarsGame* m_engine;           //The game being played, on m_engineThread.
+    QThread* m_engineThread;
+    PlanetWarsGame* m_game;             //The copy of the game that is shown.
     PlanetWarsView* m_gameView;
+    QGraphicsView* m_graphicsView;
     Logger* m_logger;
+    FrameExporter* m_frameExporter;
+    QString m_replayFileName;
+    bool m_isCpuTimed;
+    SpectatorServer* m_spectatorServer;
+    SpectatorClient* m_spectatorClient;
 };
 
 #endif // MAINWINDOW_H
@@ -3,9 +3,11 @@
 ######################################################################
 
 TEMPLATE = app
+QT += network
 INCLUDEPATH += .
 
 # Input
-HEADERS += game.h graphics.h logger.h utils.h MainWindow.h
+include(engine.pri)
+HEADERS += botprocess.h console.h deadlinetimer.h exporter.h game.h graphics.h logger.h logmask.h mapcache.h properties.h results.h spectator.h sprt.h MainWindow.h
 FORMS += MainWindow.ui
-SOURCES += game.cpp graphics.cpp logger.cpp main.cpp utils.cpp MainWindow.cpp
+SOURCES += botprocess.cpp console.cpp deadlinetimer.cpp exporter.cpp game.cpp graphics.cpp logger.cpp logmask.cpp main.cpp mapcache.cpp properties.cpp results.cpp spectator.cpp sprt.cpp MainWindow.cpp
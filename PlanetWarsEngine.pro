@@ -0,0 +1,10 @@
+# The engine library, for running games from other programs through planetwars.h.
+
+TEMPLATE = lib
+CONFIG += staticlib
+CONFIG -= qt
+TARGET = planetwars
+INCLUDEPATH += .
+
+# Input
+include(engine.pri)
@@ -0,0 +1,361 @@
+//Available under GPL v3 license.
+//Author: Iouri Khramtsov.
+
+//This file contains the operating system specific parts of running the bot processes.
+
+#include "botprocess.h"
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <sstream>
+#include "utils.h"
+
+#ifdef Q_OS_LINUX
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+
+//Write a value into a file such as a cgroup control file.
+bool WriteFile(const std::string& path, const std::string& value) {
+    FILE* file = fopen(path.c_str(), "w");
+
+    if (NULL == file) {
+        return false;
+    }
+
+    const bool isWritten = (value.size() == fwrite(value.data(), 1, value.size(), file));
+    return (0 == fclose(file)) && isWritten;
+}
+
+//Check whether a cgroup controller is enabled for the sub-groups of a directory.
+bool IsControllerEnabled(const std::string& directory, const std::string& controller) {
+    FILE* file = fopen((directory + "/cgroup.subtree_control").c_str(), "r");
+
+    if (NULL == file) {
+        return false;
+    }
+
+    char line[1024];
+    const bool isRead = (NULL != fgets(line, sizeof(line), file));
+    fclose(file);
+
+    if (!isRead) {
+        return false;
+    }
+
+    std::vector<std::string> controllers = Tokenize(TrimSpaces(line), " ");
+
+    for (size_t i = 0; i < controllers.size(); ++i) {
+        if (controllers[i] == controller) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+//Enable a cgroup controller for the sub-groups of a directory, unless it already is.
+bool EnableController(const std::string& directory, const std::string& controller, std::string* error) {
+    if (IsControllerEnabled(directory, controller)
+        || (WriteFile(directory + "/cgroup.subtree_control", "+" + controller)
+            && IsControllerEnabled(directory, controller))) {
+        return true;
+    }
+
+    *error = "Unable to enable the " + controller + " controller in " + directory
+             + "/cgroup.subtree_control: " + strerror(errno);
+    return false;
+}
+
+} //namespace
+#endif
+
+bool ReadProcessUsage(Q_PID pid, ProcessUsage *usage) {
+#ifdef Q_OS_LINUX
+    char path[64];
+
+    //CPU times are fields 14 to 17 of /proc/<pid>/stat, in clock ticks.  The process name
+    //in field 2 may contain spaces, so start after its closing parenthesis.
+    snprintf(path, sizeof(path), "/proc/%ld/stat", static_cast<long>(pid));
+    FILE* statFile = fopen(path, "r");
+
+    if (NULL == statFile) {
+        return false;
+    }
+
+    char stat[1024];
+    const size_t statSize = fread(stat, 1, sizeof(stat) - 1, statFile);
+    fclose(statFile);
+    stat[statSize] = '\0';
+
+    const char* fields = strrchr(stat, ')');
+    unsigned long long utime = 0;
+    unsigned long long stime = 0;
+    long long cutime = 0;
+    long long cstime = 0;
+
+    if (NULL == fields
+        || 4 != sscanf(fields + 1, " %*c %*d %*d %*d %*d %*d %*u %*u %*u %*u %*u %llu %llu %lld %lld",
+                       &utime, &stime, &cutime, &cstime)) {
+        return false;
+    }
+
+    static const long ticksPerSecond = sysconf(_SC_CLK_TCK);
+    usage->cpuMs = static_cast<qint64>(utime + stime + cutime + cstime) * 1000 / ticksPerSecond;
+
+    //The peak RSS is the VmHWM line of /proc/<pid>/status, in kB.
+    snprintf(path, sizeof(path), "/proc/%ld/status", static_cast<long>(pid));
+    FILE* statusFile = fopen(path, "r");
+    usage->peakRssKb = 0;
+
+    if (NULL != statusFile) {
+        char line[256];
+
+        while (NULL != fgets(line, sizeof(line), statusFile)) {
+            if (0 == strncmp(line, "VmHWM:", 6)) {
+                usage->peakRssKb = atoll(line + 6);
+                break;
+            }
+        }
+
+        fclose(statusFile);
+    }
+
+    return true;
+
+#else
+    Q_UNUSED(pid);
+    Q_UNUSED(usage);
+    return false;
+#endif
+}
+
+BotLimits::BotLimits()
+    :cpuSeconds(0), memoryMb(0), maxProcesses(0) {
+}
+
+bool ParseCpuList(const std::string &text, std::vector<int> *cpus) {
+    cpus->clear();
+    std::vector<std::string> ranges = Tokenize(TrimSpaces(text), ",");
+
+    for (size_t i = 0; i < ranges.size(); ++i) {
+        int first = 0;
+        int last = 0;
+        char extra = 0;
+        const int numRead = sscanf(ranges[i].c_str(), "%d-%d%c", &first, &last, &extra);
+
+        if (1 == numRead) {
+            last = first;
+
+        } else if (2 != numRead) {
+            return false;
+        }
+
+        if (first < 0 || last < first) {
+            return false;
+        }
+
+        for (int cpu = first; cpu <= last; ++cpu) {
+            cpus->push_back(cpu);
+        }
+    }
+
+    return !cpus->empty();
+}
+
+bool ReadNumaNodeCpus(int node, std::vector<int> *cpus) {
+    char path[64];
+    snprintf(path, sizeof(path), "/sys/devices/system/node/node%d/cpulist", node);
+    FILE* file = fopen(path, "r");
+
+    if (NULL == file) {
+        return false;
+    }
+
+    char line[1024];
+    const bool isRead = (NULL != fgets(line, sizeof(line), file));
+    fclose(file);
+
+    return isRead && ParseCpuList(line, cpus);
+}
+
+bool PinToCpus(const std::vector<int> &cpus) {
+#ifdef Q_OS_LINUX
+    cpu_set_t set;
+    CPU_ZERO(&set);
+
+    for (size_t i = 0; i < cpus.size(); ++i) {
+        CPU_SET(cpus[i], &set);
+    }
+
+    return 0 == sched_setaffinity(0, sizeof(set), &set);
+
+#else
+    Q_UNUSED(cpus);
+    return false;
+#endif
+}
+
+bool PrepareCgroupDirectory(const BotLimits &limits, std::string *error) {
+    if (limits.cgroupDirectory.empty()) {
+        return true;
+    }
+
+#ifdef Q_OS_LINUX
+    if (limits.memoryMb > 0 && !EnableController(limits.cgroupDirectory, "memory", error)) {
+        return false;
+    }
+
+    if (limits.maxProcesses > 0 && !EnableController(limits.cgroupDirectory, "pids", error)) {
+        return false;
+    }
+
+    return true;
+
+#else
+    *error = "Cgroups are only supported on Linux.";
+    return false;
+#endif
+}
+
+/*===================================================
+                Class BotProcess.
+====================================================*/
+BotProcess::BotProcess(QObject *parent)
+    :QProcess(parent) {
+#ifdef Q_OS_LINUX
+    m_isPinned = false;
+    m_cpuLimit.rlim_cur = m_cpuLimit.rlim_max = RLIM_INFINITY;
+    m_memoryLimit.rlim_cur = m_memoryLimit.rlim_max = RLIM_INFINITY;
+    m_processLimit.rlim_cur = m_processLimit.rlim_max = RLIM_INFINITY;
+#endif
+}
+
+BotProcess::~BotProcess() {
+#ifdef Q_OS_LINUX
+    //The bot is gone by now, so its cgroup is empty and can be removed.
+    if (!m_cgroupPath.empty()) {
+        rmdir(m_cgroupPath.c_str());
+    }
+#endif
+}
+
+bool BotProcess::setLimits(const BotLimits &limits, const std::string &name, std::string *error) {
+#ifdef Q_OS_LINUX
+    m_isPinned = !limits.cpus.empty();
+    CPU_ZERO(&m_cpus);
+
+    for (size_t i = 0; i < limits.cpus.size(); ++i) {
+        CPU_SET(limits.cpus[i], &m_cpus);
+    }
+
+    if (limits.cpuSeconds > 0) {
+        m_cpuLimit.rlim_cur = m_cpuLimit.rlim_max = limits.cpuSeconds;
+    }
+
+    //The address space and process limits are only applied if the bot doesn't end up
+    //in a cgroup, where memory.max and pids.max take their place (see setupChildProcess()).
+    if (limits.memoryMb > 0) {
+        m_memoryLimit.rlim_cur = m_memoryLimit.rlim_max = static_cast<rlim_t>(limits.memoryMb) * 1024 * 1024;
+    }
+
+    if (limits.maxProcesses > 0) {
+        m_processLimit.rlim_cur = m_processLimit.rlim_max = limits.maxProcesses;
+    }
+
+    if (limits.cgroupDirectory.empty()) {
+        return true;
+    }
+
+    //Give the bot a cgroup of its own, named after this process so that concurrent games don't clash.
+    std::stringstream path;
+    path << limits.cgroupDirectory << "/planetwarrior-" << getpid() << "-" << name;
+    m_cgroupPath = path.str();
+
+    bool isCgroupReady = (0 == mkdir(m_cgroupPath.c_str(), 0755) || EEXIST == errno);
+
+    if (!isCgroupReady) {
+        *error = "Unable to create the cgroup " + m_cgroupPath + ": " + strerror(errno);
+        m_cgroupPath.clear();
+    }
+
+    //The control files are only there if the parent has the controllers enabled
+    //(see PrepareCgroupDirectory()).
+    if (isCgroupReady && limits.memoryMb > 0) {
+        std::stringstream memoryMax;
+        memoryMax << static_cast<qint64>(limits.memoryMb) * 1024 * 1024;
+
+        if (!WriteFile(m_cgroupPath + "/memory.max", memoryMax.str())) {
+            *error = "Unable to set memory.max in the cgroup " + m_cgroupPath + ".";
+            isCgroupReady = false;
+        }
+    }
+
+    if (isCgroupReady && limits.maxProcesses > 0) {
+        std::stringstream pidsMax;
+        pidsMax << limits.maxProcesses;
+
+        if (!WriteFile(m_cgroupPath + "/pids.max", pidsMax.str())) {
+            *error = "Unable to set pids.max in the cgroup " + m_cgroupPath + ".";
+            isCgroupReady = false;
+        }
+    }
+
+    if (!isCgroupReady) {
+        //Fall back on the rlimits.
+        if (!m_cgroupPath.empty()) {
+            rmdir(m_cgroupPath.c_str());
+            m_cgroupPath.clear();
+        }
+
+        return false;
+    }
+
+    m_cgroupProcsPath = m_cgroupPath + "/cgroup.procs";
+    return true;
+
+#else
+    Q_UNUSED(name);
+
+    if (!limits.cgroupDirectory.empty()) {
+        *error = "Cgroups are only supported on Linux.";
+        return false;
+    }
+
+    return true;
+#endif
+}
+
+void BotProcess::setupChildProcess() {
+#ifdef Q_OS_LINUX
+    //This runs in the child, between fork and exec; stick to plain system calls.
+    bool isInCgroup = false;
+
+    if (!m_cgroupProcsPath.empty()) {
+        const int procs = ::open(m_cgroupProcsPath.c_str(), O_WRONLY);
+
+        if (procs >= 0) {
+            //"0" stands for the writing process.
+            isInCgroup = (1 == ::write(procs, "0", 1));
+            ::close(procs);
+        }
+    }
+
+    if (m_isPinned) {
+        sched_setaffinity(0, sizeof(m_cpus), &m_cpus);
+    }
+
+    setrlimit(RLIMIT_CPU, &m_cpuLimit);
+
+    //Bots that reserve a lot of address space up front (JVMs, Go) only fit under an address
+    //space limit if it's far above what they use; in a cgroup, memory.max counts what they use.
+    //A bot that couldn't join its cgroup still gets limited somehow.
+    if (!isInCgroup) {
+        setrlimit(RLIMIT_AS, &m_memoryLimit);
+        setrlimit(RLIMIT_NPROC, &m_processLimit);
+    }
+#endif
+}
@@ -0,0 +1,82 @@
+//Available under GPL v3 license.
+//Author: Iouri Khramtsov.
+
+//This file contains the operating system specific parts of running the bot processes.
+
+#ifndef BOTPROCESS_H
+#define BOTPROCESS_H
+
+#include <string>
+#include <vector>
+#include <QProcess>
+
+#ifdef Q_OS_LINUX
+#include <sched.h>
+#include <sys/resource.h>
+#endif
+
+//Resources used by a process so far.
+struct ProcessUsage {
+    qint64 cpuMs;       //User and system time, including children that have been waited for.
+    qint64 peakRssKb;   //Peak resident set size.
+};
+
+//Read the resources used by a running process.  Return false if they can't be read
+//(the process is gone, or the system doesn't provide the numbers).
+bool ReadProcessUsage(Q_PID pid, ProcessUsage* usage);
+
+//Where a bot may run, and how much it may use.  Zeros and empty values mean no limit.
+struct BotLimits {
+    BotLimits();
+
+    std::vector<int> cpus;          //Cores the bot runs on.
+    int cpuSeconds;                 //Total CPU time over the game.
+    int memoryMb;                   //memory.max in a cgroup.  Without one, the address space.
+    int maxProcesses;               //pids.max in a cgroup.  Without one, RLIMIT_NPROC,
+                                    //which counts all the processes of the user.
+    std::string cgroupDirectory;    //A cgroup v2 directory we may create sub-groups in.
+};
+
+//Parse a list of cores such as "0-3,8".  Return false if it's malformed.
+bool ParseCpuList(const std::string& text, std::vector<int>* cpus);
+
+//Get the cores of a NUMA node.  Return false if there's no such node.
+bool ReadNumaNodeCpus(int node, std::vector<int>* cpus);
+
+//Keep the calling thread, and the threads and processes it starts from now on, on the given cores.
+bool PinToCpus(const std::vector<int>& cpus);
+
+//Enable the cgroup controllers the limits need for the sub-groups of their cgroup directory.
+//Return false and describe the problem if the directory can't be used.
+bool PrepareCgroupDirectory(const BotLimits& limits, std::string* error);
+
+//A bot process that gets its limits applied between fork and exec.
+class BotProcess : public QProcess {
+public:
+    BotProcess(QObject* parent);
+    ~BotProcess();
+
+    //Set the limits before starting the process.  The name tells apart the cgroups of
+    //the bots in one game.  If the cgroup can't be set up, fall back on the rlimits,
+    //return false and describe the problem.
+    bool setLimits(const BotLimits& limits, const std::string& name, std::string* error);
+
+protected:
+    void setupChildProcess();
+
+private:
+    //Everything the child needs is prepared in advance, since very little is safe
+    //to do between fork and exec.
+    std::string m_cgroupPath;       //Empty if the bot doesn't get a cgroup.
+    std::string m_cgroupProcsPath;
+
+#ifdef Q_OS_LINUX
+    bool m_isPinned;
+    cpu_set_t m_cpus;
+    rlimit m_cpuLimit;
+    rlimit m_memoryLimit;           //Only applied if the bot isn't in a cgroup.
+    rlimit m_processLimit;
+#endif
+};
+
+#endif // BOTPROCESS_H
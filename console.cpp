@@ -0,0 +1,32 @@
+//Available under GPL v3 license.
+//Author: Iouri Khramtsov.
+
+//This file contains the log sink used when the games are run without a window.
+
+#include "console.h"
+#include <cstdio>
+
+/*===================================================
+                Class ConsoleLogger.
+====================================================*/
+ConsoleLogger::ConsoleLogger(QObject *parent)
+    :QObject(parent) {
+}
+
+void ConsoleLogger::recordMessage(const std::string &message, const QString &sender) {
+    this->recordLog(message, sender, "");
+}
+
+void ConsoleLogger::recordError(const std::string &message, const QString &sender) {
+    this->recordLog(message, sender, " error");
+}
+
+void ConsoleLogger::recordStdErr(const std::string &message, const QString &sender) {
+    this->recordLog(message, sender, " stderr");
+}
+
+void ConsoleLogger::recordLog(const std::string &message, const QString &sender, const char *category) {
+    //Filtering has already been done by the sender (see LogMask).
+    fprintf(stderr, "[%s%s] %s\n", sender.toLocal8Bit().constData(),
+            category, message.c_str());
+}
@@ -0,0 +1,28 @@
+//Available under GPL v3 license.
+//Author: Iouri Khramtsov.
+
+//This file contains the log sink used when the games are run without a window.
+
+#ifndef CONSOLE_H
+#define CONSOLE_H
+
+#include <string>
+#include <QObject>
+
+//Writes the log messages of the game and the players to stderr.
+class ConsoleLogger : public QObject {
+    Q_OBJECT
+
+public:
+    ConsoleLogger(QObject* parent);
+
+public slots:
+    void recordMessage(const std::string& message, const QString& sender);
+    void recordError(const std::string& message, const QString& sender);
+    void recordStdErr(const std::string& message, const QString& sender);
+
+private:
+    void recordLog(const std::string& message, const QString& sender, const char* category);
+};
+
+#endif // CONSOLE_H
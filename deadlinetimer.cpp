@@ -0,0 +1,108 @@
+//Available under GPL v3 license.
+//Author: Iouri Khramtsov.
+
+//This file contains the timer used for the turn deadlines.
+
+#include "deadlinetimer.h"
+#include <cstring>
+#include <QSocketNotifier>
+#include <QTimer>
+
+#ifdef Q_OS_LINUX
+#include <sys/timerfd.h>
+#include <unistd.h>
+#endif
+
+/*===================================================
+                Class DeadlineTimer.
+====================================================*/
+DeadlineTimer::DeadlineTimer(QObject *parent)
+    :QObject(parent), m_fd(-1), m_notifier(NULL), m_fallbackTimer(NULL),
+      m_isActive(false), m_intervalMs(0), m_overshootUs(0) {
+
+#ifdef Q_OS_LINUX
+    m_fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+
+    if (m_fd >= 0) {
+        m_notifier = new QSocketNotifier(m_fd, QSocketNotifier::Read, this);
+        QObject::connect(m_notifier, SIGNAL(activated(int)), this, SLOT(expire()));
+    }
+#endif
+
+    if (NULL == m_notifier) {
+        m_fallbackTimer = new QTimer(this);
+        m_fallbackTimer->setSingleShot(true);
+        QObject::connect(m_fallbackTimer, SIGNAL(timeout()), this, SLOT(expire()));
+    }
+}
+
+DeadlineTimer::~DeadlineTimer() {
+#ifdef Q_OS_LINUX
+    if (m_fd >= 0) {
+        delete m_notifier;
+        close(m_fd);
+    }
+#endif
+}
+
+void DeadlineTimer::start(int ms) {
+    m_intervalMs = qMax(ms, 0);
+    m_isActive = true;
+    m_clock.start();
+
+#ifdef Q_OS_LINUX
+    if (m_fd >= 0) {
+        itimerspec deadline;
+        memset(&deadline, 0, sizeof(deadline));
+        deadline.it_value.tv_sec = m_intervalMs / 1000;
+        deadline.it_value.tv_nsec = (m_intervalMs % 1000) * 1000000L;
+
+        //An all-zero value would disarm the timer instead.
+        if (0 == m_intervalMs) {
+            deadline.it_value.tv_nsec = 1;
+        }
+
+        timerfd_settime(m_fd, 0, &deadline, NULL);
+        return;
+    }
+#endif
+
+    m_fallbackTimer->start(m_intervalMs);
+}
+
+void DeadlineTimer::stop() {
+    m_isActive = false;
+
+#ifdef Q_OS_LINUX
+    if (m_fd >= 0) {
+        itimerspec disarmed;
+        memset(&disarmed, 0, sizeof(disarmed));
+        timerfd_settime(m_fd, 0, &disarmed, NULL);
+        return;
+    }
+#endif
+
+    m_fallbackTimer->stop();
+}
+
+void DeadlineTimer::expire() {
+#ifdef Q_OS_LINUX
+    if (m_fd >= 0) {
+        //Take the expiration off the descriptor; a stale notification finds nothing to read.
+        quint64 numExpirations = 0;
+
+        if (static_cast<ssize_t>(sizeof(numExpirations)) != read(m_fd, &numExpirations, sizeof(numExpirations))) {
+            return;
+        }
+    }
+#endif
+
+    if (!m_isActive) {
+        return;
+    }
+
+    m_isActive = false;
+    m_overshootUs = m_clock.nsecsElapsed() / 1000 - static_cast<qint64>(m_intervalMs) * 1000;
+
+    emit timeout();
+}
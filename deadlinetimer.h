@@ -0,0 +1,51 @@
+//Available under GPL v3 license.
+//Author: Iouri Khramtsov.
+
+//This file contains the timer used for the turn deadlines.
+
+#ifndef DEADLINETIMER_H
+#define DEADLINETIMER_H
+
+#include <QElapsedTimer>
+#include <QObject>
+
+class QSocketNotifier;
+class QTimer;
+
+//A single-shot timer for deadlines, measured on the monotonic clock.  On Linux it's a timerfd
+//watched by the event loop next to the bots' pipes, which fires within the scheduler's
+//latency rather than QTimer's rounding; elsewhere it falls back on a QTimer.  It measures by
+//how much each deadline was overshot, i.e. how late timeout() was emitted.
+class DeadlineTimer : public QObject {
+    Q_OBJECT
+
+public:
+    DeadlineTimer(QObject* parent);
+    ~DeadlineTimer();
+
+    //Set the deadline a number of milliseconds from now, replacing any earlier one.
+    void start(int ms);
+    void stop();
+    bool isActive() const               {return m_isActive;}
+
+    //How late the most recent deadline fired, in microseconds.
+    qint64 getOvershootUs() const       {return m_overshootUs;}
+
+signals:
+    void timeout();
+
+private slots:
+    void expire();
+
+private:
+    int m_fd;                           //The timerfd; -1 if there is none.
+    QSocketNotifier* m_notifier;
+    QTimer* m_fallbackTimer;
+
+    bool m_isActive;
+    int m_intervalMs;
+    QElapsedTimer m_clock;              //Started along with the deadline.
+    qint64 m_overshootUs;
+};
+
+#endif // DEADLINETIMER_H
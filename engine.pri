@@ -0,0 +1,5 @@
+# The engine: the rules of the game on plain game states, and the C interface to them.
+# Doesn't use Qt; shared by the engine library (PlanetWarsEngine.pro) and the GUI.
+
+HEADERS += planetwars.h rules.h utils.h
+SOURCES += planetwars.cpp rules.cpp utils.cpp
@@ -0,0 +1,247 @@
+//Available under GPL v3 license.
+//Author: Iouri Khramtsov.
+
+//This file contains the offscreen renderer that turns games into image sequences.
+
+#include "exporter.h"
+#include <fstream>
+#include <QAtomicInt>
+#include <QDir>
+#include <QFile>
+#include <QImage>
+#include <QList>
+#include <QRunnable>
+#include <QThread>
+#include <QtConcurrentMap>
+#include "game.h"
+
+namespace {
+
+//Get the name of the image file for a frame.
+QString FrameFileName(const QString& directory, int frameIndex) {
+    return QDir(directory).filePath(QString("frame_%1.png").arg(frameIndex, 5, 10, QChar('0')));
+}
+
+//Renders one frame and saves it as a PNG file, then gives back its slot.
+class FrameTask : public QRunnable {
+public:
+    FrameTask(const FrameRenderer& renderer, const GameSnapshot& state, const QString& fileName,
+              QAtomicInt* numFailedFrames, QSemaphore* frameSlots)
+        :m_renderer(renderer), m_state(state), m_fileName(fileName), m_numFailedFrames(numFailedFrames),
+        m_frameSlots(frameSlots) {
+    }
+
+    void run() {
+        if (!m_renderer.render(m_state).save(m_fileName, "PNG")) {
+            m_numFailedFrames->ref();
+        }
+
+        m_frameSlots->release();
+    }
+
+private:
+    FrameRenderer m_renderer;
+    GameSnapshot m_state;
+    QString m_fileName;
+    QAtomicInt* m_numFailedFrames;
+    QSemaphore* m_frameSlots;
+};
+
+//Renders frames of a replay for QtConcurrent.
+class RenderFrame {
+public:
+    typedef QImage result_type;
+
+    RenderFrame(const FrameRenderer* renderer, const std::vector<GameSnapshot>* states)
+        :m_renderer(renderer), m_states(states) {
+    }
+
+    QImage operator()(int frameIndex) const {
+        return m_renderer->render((*m_states)[frameIndex]);
+    }
+
+private:
+    const FrameRenderer* m_renderer;
+    const std::vector<GameSnapshot>* m_states;
+};
+
+//Renders frames of a replay straight to PNG files for QtConcurrent.
+class SaveFrame {
+public:
+    SaveFrame(const FrameRenderer* renderer, const std::vector<GameSnapshot>* states,
+              const QString& directory, QAtomicInt* numFailedFrames)
+        :m_renderer(renderer), m_states(states), m_directory(directory), m_numFailedFrames(numFailedFrames) {
+    }
+
+    void operator()(int frameIndex) const {
+        if (!m_renderer->render((*m_states)[frameIndex]).save(FrameFileName(m_directory, frameIndex), "PNG")) {
+            m_numFailedFrames->ref();
+        }
+    }
+
+private:
+    const FrameRenderer* m_renderer;
+    const std::vector<GameSnapshot>* m_states;
+    QString m_directory;
+    QAtomicInt* m_numFailedFrames;
+};
+
+} //namespace
+
+/*===================================================
+               Class FrameExporter.
+====================================================*/
+FrameExporter::FrameExporter(QObject *parent)
+    :QObject(parent), m_settings(new GraphicsSettings(this)), m_renderer(m_settings),
+    m_game(NULL), m_frameIndex(0), m_numFailedFrames(0),
+    m_frameSlots(qMax(1, QThread::idealThreadCount()) * FRAMES_PER_THREAD) {
+    this->setObjectName("Frame Exporter");
+}
+
+FrameExporter::~FrameExporter() {
+    this->waitForDone();
+}
+
+bool FrameExporter::exportReplay(const QString &replayFileName, QString *error) {
+    std::ifstream replayFile(replayFileName.toLocal8Bit().constData());
+
+    if (replayFile.fail()) {
+        *error = "Unable to open the replay file.";
+        return false;
+    }
+
+    std::string replay = std::string(std::istreambuf_iterator<char>(replayFile), std::istreambuf_iterator<char>());
+    std::vector<GameSnapshot> states;
+    std::string parseError;
+
+    if (!ParseReplay(replay, &states, &parseError)) {
+        *error = QString(parseError.c_str());
+        return false;
+    }
+
+    if (states.empty()) {
+        *error = "The replay contains no turns.";
+        return false;
+    }
+
+    //The map doesn't change during a game, so the first turn gives the framing for all.
+    m_renderer.fitMap(states[0]);
+
+    if ("-" == m_outputDirectory) {
+        if (!this->exportRawStream(states)) {
+            *error = "Unable to write the frames to stdout.";
+            return false;
+        }
+
+        return true;
+
+    } else {
+        if (!QDir().mkpath(m_outputDirectory)) {
+            *error = "Unable to create the output directory.";
+            return false;
+        }
+
+        return this->exportPngSequence(states, error);
+    }
+}
+
+bool FrameExporter::exportPngSequence(const std::vector<GameSnapshot> &states, QString *error) {
+    //Every frame is independent, so they can all be rendered and saved in parallel.
+    QList<int> frames;
+
+    for (int i = 0; i < static_cast<int>(states.size()); ++i) {
+        frames.append(i);
+    }
+
+    QAtomicInt numFailedFrames(0);
+    QtConcurrent::blockingMap(frames, SaveFrame(&m_renderer, &states, m_outputDirectory, &numFailedFrames));
+
+    if (0 != static_cast<int>(numFailedFrames)) {
+        *error = QString("Unable to write %1 of %2 frames.").arg(static_cast<int>(numFailedFrames)).arg(frames.size());
+        return false;
+    }
+
+    return true;
+}
+
+bool FrameExporter::exportRawStream(const std::vector<GameSnapshot> &states) {
+    QFile output;
+
+    if (!output.open(stdout, QIODevice::WriteOnly)) {
+        return false;
+    }
+
+    //Render in batches, so that frames are written in order without holding the whole game in memory.
+    const int numFrames = static_cast<int>(states.size());
+    const int batchSize = qMax(1, QThread::idealThreadCount()) * FRAMES_PER_THREAD;
+
+    for (int batchStart = 0; batchStart < numFrames; batchStart += batchSize) {
+        QList<int> frames;
+
+        for (int i = batchStart; i < qMin(numFrames, batchStart + batchSize); ++i) {
+            frames.append(i);
+        }
+
+        QList<QImage> images = QtConcurrent::blockingMapped<QList<QImage> >(frames, RenderFrame(&m_renderer, &states));
+
+        for (int i = 0; i < images.size(); ++i) {
+            const QImage& image = images[i];
+
+            if (output.write(reinterpret_cast<const char*>(image.constBits()), image.byteCount()) < 0) {
+                return false;
+            }
+        }
+    }
+
+    output.flush();
+    return true;
+}
+
+void FrameExporter::setGame(PlanetWarsGame *game) {
+    m_game = game;
+
+    QObject::connect(m_game, SIGNAL(wasReset()), this, SLOT(startGame()));
+    QObject::connect(m_game, SIGNAL(turnEnded()), this, SLOT(recordTurn()));
+}
+
+void FrameExporter::startGame() {
+    //Let the frames of the previous game finish before they can be overwritten.
+    this->finishGame();
+    QDir().mkpath(m_outputDirectory);
+
+    m_frameIndex = 0;
+    GameSnapshot state = m_game->takeSnapshot();
+    m_renderer.fitMap(state);
+    m_frameSlots.acquire();
+    m_threadPool.start(new FrameTask(m_renderer, state, FrameFileName(m_outputDirectory, m_frameIndex++),
+                                     &m_numFailedFrames, &m_frameSlots));
+}
+
+void FrameExporter::recordTurn() {
+    //Only the copy of the state is handed over; the game goes on while the frame is drawn.
+    //If the rendering falls behind, wait for a frame to be done rather than pile up turns.
+    m_frameSlots.acquire();
+    m_threadPool.start(new FrameTask(m_renderer, m_game->takeSnapshot(),
+                                     FrameFileName(m_outputDirectory, m_frameIndex++), &m_numFailedFrames,
+                                     &m_frameSlots));
+}
+
+void FrameExporter::finishGame() {
+    this->waitForDone();
+    this->reportFailedFrames();
+}
+
+void FrameExporter::reportFailedFrames() {
+    const int numFailedFrames = static_cast<int>(m_numFailedFrames);
+
+    if (0 != numFailedFrames) {
+        const QString message = QString("Unable to write %1 of %2 frames to %3.")
+                .arg(numFailedFrames).arg(m_frameIndex).arg(m_outputDirectory);
+        emit logError(message.toStdString(), this->objectName());
+        m_numFailedFrames = 0;
+    }
+}
+
+void FrameExporter::waitForDone() {
+    m_threadPool.waitForDone();
+}
@@ -0,0 +1,85 @@
+//Available under GPL v3 license.
+//Author: Iouri Khramtsov.
+
+//This file contains the offscreen renderer that turns games into image sequences.
+
+#ifndef EXPORTER_H
+#define EXPORTER_H
+
+#include <string>
+#include <vector>
+#include <QAtomicInt>
+#include <QObject>
+#include <QSemaphore>
+#include <QSize>
+#include <QString>
+#include <QThreadPool>
+#include "graphics.h"
+
+//Forward-declared classes.
+class PlanetWarsGame;
+
+//Renders game states into images on a thread pool, without any window.  Frames
+//are written as numbered PNG files (frame_00000.png, ...) to the output directory.
+//For replays, the output directory may also be "-", in which case the frames are
+//written to stdout as raw video: one width*height*4 byte frame per turn, in
+//32-bit BGRA order (e.g. ffmpeg -f rawvideo -pix_fmt bgra -s WxH -i -).
+class FrameExporter : public QObject {
+    Q_OBJECT
+
+public:
+    FrameExporter(QObject* parent);
+    ~FrameExporter();
+
+    void setOutputDirectory(const QString& directory)   { m_outputDirectory = directory;}
+    void setFrameSize(const QSize& frameSize)           { m_renderer.setFrameSize(frameSize);}
+    QString getOutputDirectory() const                  { return m_outputDirectory;}
+    FrameRenderer* getRenderer()                        { return &m_renderer;}
+
+    //Render every turn of a replay file.  Return false and describe the problem on failure.
+    bool exportReplay(const QString& replayFileName, QString* error);
+
+    //Render the turns of a live game as they are played.
+    void setGame(PlanetWarsGame* game);
+
+    //Frames of the current live game that couldn't be written, e.g. for lack of disk space.
+    int getNumFailedFrames() const                      { return static_cast<int>(m_numFailedFrames);}
+
+signals:
+    void logError(const std::string& message, const QString& sender);
+
+public slots:
+    //Start numbering the frames from the beginning for a new game.
+    void startGame();
+
+    //Render the turn that just ended.
+    void recordTurn();
+
+    //Let the frames of the game that ended be written, and report the ones that couldn't be.
+    void finishGame();
+
+    //Block until all queued frames have been written.
+    void waitForDone();
+
+private:
+    //How many frames are rendered ahead of the one being written to the raw stream, and
+    //how many turns of a live game may wait to be rendered before the game is held up.
+    static const int FRAMES_PER_THREAD = 4;
+
+    void reportFailedFrames();
+
+    bool exportPngSequence(const std::vector<GameSnapshot>& states, QString* error);
+    bool exportRawStream(const std::vector<GameSnapshot>& states);
+
+    GraphicsSettings* m_settings;
+    FrameRenderer m_renderer;
+    QString m_outputDirectory;
+    QThreadPool m_threadPool;
+
+    PlanetWarsGame* m_game;
+    int m_frameIndex;   //Index of the next live frame.
+    QAtomicInt m_numFailedFrames;
+    QSemaphore m_frameSlots;    //One for each live frame that may be in flight.
+};
+
+#endif // EXPORTER_H
@@ -15,43 +15,59 @@
 // Stores the game state.
 
 #include "game.h"
+#include <algorithm>
 #include <cmath>
+#include <cstdio>
+#include <cstring>
 #include <fstream>
 #include <sstream>
 
+#include "logmask.h"
+#include "mapcache.h"
 #include "utils.h"
 
+/*===================================================
+                Struct AdjudicationRules.
+====================================================*/
+AdjudicationRules::AdjudicationRules()
+    :shipRatio(0), productionRatio(0), numTurns(0), isStrandedOut(false) {
+}
+
 /*===================================================
                 Class PlanetWarsGame.
 ====================================================*/
 PlanetWarsGame::PlanetWarsGame(QObject* parent)
     :QObject(parent) {
 
-    //Set up the players
-    m_neutralPlayer = new Player(this);
-    m_firstPlayer = new Player(this);
-    m_secondPlayer = new Player(this);
-
-    m_neutralPlayer->setId(0);
-    m_firstPlayer->setId(1);
-    m_secondPlayer->setId(2);
+    //Set up the players; by default, two bots play.
+    Player* neutralPlayer = new Player(this);
+    neutralPlayer->setId(0);
+    m_players.push_back(neutralPlayer);
 
-    QObject::connect(m_firstPlayer, SIGNAL(receivedStdOut()), this, SLOT(checkPlayerResponses()));
-    QObject::connect(m_secondPlayer, SIGNAL(receivedStdOut()), this, SLOT(checkPlayerResponses()));
+    this->setNumPlayers(2);
 
     //Set object names.
     this->setObjectName("Game Engine");
-    m_firstPlayer->setObjectName("Player 1");
-    m_secondPlayer->setObjectName("Player 2");
 
     //Initialize game state.
     m_state = STOPPED;
     m_runningState = PAUSED;
     m_turn = 0;
+    m_winner = -1;
+    m_adjudication = NOT_ADJUDICATED;
+    m_dominantPlayer = 0;
+    m_numDominantTurns = 0;
+    m_isStateEncoded = false;
+    m_isDeltaEncoded = false;
+    m_isBoardCurrent = false;
+    m_stateHash = 0;
+    m_isCpuTimed = false;
+    m_numDeadlines = 0;
+    m_totalOvershootUs = 0;
+    m_maxOvershootUs = 0;
 
     //Initialize the timer.
-    m_timer = new QTimer(this);
-    m_timer->setSingleShot(true);
+    m_timer = new DeadlineTimer(this);
     QObject::connect(m_timer, SIGNAL(timeout()), this, SLOT(checkPlayerResponses()));
 
     //Initialize the run mode timer.
@@ -63,190 +79,416 @@ PlanetWarsGame::PlanetWarsGame(QObject* parent)
 void PlanetWarsGame::reset() {
     this->logMessage("Reloading the game... ");
 
-    //Attempt to read the map from file.
-    std::ifstream mapFile(m_mapFileName.c_str());
+    //Get the map; it's only read and parsed the first time any game in the process uses it.
+    std::string error;
+    const MapCache::MapPointer mapPointer = MapCache::getMap(m_mapFileName, &error);
 
-    if (mapFile.fail()) {
-        this->logError("Unable to open the map file.");
+    if (mapPointer.isNull()) {
+        this->logError(error);
         return;
     }
 
-    std::string mapString = std::string(std::istreambuf_iterator<char>(mapFile), std::istreambuf_iterator<char>());
+    const GameSnapshot& map = *mapPointer;
+
+    //Make sure that all owners are known players.
+    const int numPlanets = static_cast<int>(map.planets.size());
+    const int numFleets = static_cast<int>(map.fleets.size());
+
+    for (int i = 0; i < numPlanets; ++i) {
+        if (NULL == this->getPlayer(map.planets[i].owner)) {
+            std::stringstream message;
+            message << "Map file error: planet " << i << " is owned by an unknown player "
+                    << map.planets[i].owner << ".";
+            this->logError(message.str());
+            return;
+        }
+    }
+
+    for (int i = 0; i < numFleets; ++i) {
+        if (NULL == this->getPlayer(map.fleets[i].owner) || 0 == map.fleets[i].owner) {
+            std::stringstream message;
+            message << "Map file error: fleet " << i << " is owned by an invalid player "
+                    << map.fleets[i].owner << ".";
+            this->logError(message.str());
+            return;
+        }
+    }
+
+    //Parsed the map successfully. Reset the game.
+    //Stop any running processes.
+    this->stop();
+    this->stopPlayers();
+
+    //Replace the old planets and fleets with the new.
+    this->loadSnapshot(map);
+    m_newFleets.clear();
+    m_newFleets.insert(m_newFleets.end(), m_fleets.begin(), m_fleets.end());
 
-    //Attempt to parse the map.
-    bool failed = false;
-    std::vector<Planet*> planets;
-    std::list<Fleet*> fleets;
+    //Reset all flags and counters.
+    m_state = RESET;
+    m_turn = 0;
+    m_winner = -1;
+    m_adjudication = NOT_ADJUDICATED;
+    m_dominantPlayer = 0;
+    m_numDominantTurns = 0;
+    m_turnHashes.assign(1, this->getStateHash());
+    m_numDeadlines = 0;
+    m_totalOvershootUs = 0;
+    m_maxOvershootUs = 0;
+
+    //Start a new replay.
+    if (m_replayFile.is_open()) {
+        m_replayFile.close();
+    }
 
-    //Lines on which we find fleets.
-    std::vector<size_t> fleetLines;
+    if (!m_replayFileName.empty()) {
+        m_replayFile.open(m_replayFileName.c_str(), std::ios::out | std::ios::trunc);
 
-    //Process each line in the map file, reading the fleet and planet information from
-    //respective lines.
-    std::vector<std::string> lines = Tokenize(mapString, "\n");
+        if (m_replayFile.fail()) {
+            this->logError("Unable to open the replay file.");
 
-    for (size_t i = 0; i < lines.size(); ++i) {
-        std::string& line = lines[i];
+        } else {
+            this->recordReplayTurn();
+        }
+    }
 
-        //Remove comments.
-        size_t commentBegin = line.find('#');
+    //Notify everyone of the resetn
+    this->logMessage("================= Game reset. ==================");
+    emit wasReset();
 
-        if (commentBegin != std::string::npos)
-            line = line.substr(0, commentBegin);
+    if (this->receivers(SIGNAL(wasResetTo(GameSnapshot))) > 0) {
+        emit wasResetTo(this->takeSnapshot());
+    }
+}
 
-        if (TrimSpaces(line).size() == 0) continue;
+void PlanetWarsGame::loadSnapshot(const GameSnapshot &state) {
+    m_changedPlanets.clear();
+    m_landedFleets.clear();
+    m_changedProperties.clear();
+    m_isStateEncoded = false;
+    m_isDeltaEncoded = false;
+    m_isBoardCurrent = false;
 
-        //Split the line into individual elements.
-        std::vector<std::string> tokens = Tokenize(line, " ");
+    const int numOldPlanets = static_cast<int>(m_planets.size());
+    for (int i = 0; i < numOldPlanets; ++i) delete m_planets[i];
+    for (FleetList::iterator it = m_fleets.begin(); it != m_fleets.end(); ++it) delete (*it);
 
-        if (tokens.size() == 0) continue;
+    m_planets.clear();
+    m_fleets.clear();
+    m_stateHash = 0;
 
-        if (tokens[0] == "P") {
-            //Record a planet.
-            if (tokens.size() != 6) {
-                std::stringstream message;
-                message <<"Map file error [line " << i
-                        << "]: expected 6 tokens on a planet line, have " << tokens.size() <<".";
-                this->logError(message.str());
-                failed = true;
-                break;
-            }
+    const int numPlanets = static_cast<int>(state.planets.size());
 
-            Planet* planet = new Planet(this);
-            planet->setX(atof(tokens[1].c_str()));
-            planet->setY(atof(tokens[2].c_str()));
-            planet->setOwner(this->getPlayer(atoi(tokens[3].c_str())));
-            planet->setNumShips(atoi(tokens[4].c_str()));
-            planet->setGrowthRate(atoi(tokens[5].c_str()));
-            planet->setId(planets.size());
-            planet->setGame(this);
+    for (int i = 0; i < numPlanets; ++i) {
+        const PlanetState& planetState = state.planets[i];
 
-            planets.push_back(planet);
+        Planet* planet = new Planet(this);
+        planet->setX(planetState.x);
+        planet->setY(planetState.y);
+        planet->setOwner(this->getPlayer(planetState.owner));
+        planet->setNumShips(planetState.numShips);
+        planet->setGrowthRate(planetState.growthRate);
+        planet->setId(i);
 
-        } else if (tokens[0] == "F") {
-            //Record a fleet.
-            if (tokens.size() != 7) {
-                std::stringstream message;
-                message <<"Map file error [line " << i
-                        << "]: expected 7 tokens on a fleet line, have " << tokens.size() <<".";
-                this->logError(message.str());
-                failed = true;
-                break;
+        for (size_t j = 0; j < planetState.properties.size(); ++j) {
+            const int nameId = PropertyNames::intern(planetState.properties[j].first);
+
+            if (PropertyNames::NO_NAME != nameId) {
+                planet->setProperty(nameId, planetState.properties[j].second);
             }
+        }
 
-            Fleet* fleet = new Fleet(this);
-            fleet->setOwner(this->getPlayer(atoi(tokens[1].c_str())));
-            fleet->setNumShips(atoi(tokens[2].c_str()));
-            fleet->setSourceId(atoi(tokens[3].c_str()));
-            fleet->setDestinationId(atoi(tokens[4].c_str()));
-            fleet->setTotalTripLength(atoi(tokens[5].c_str()));
-            fleet->setTurnsRemaining(atoi(tokens[6].c_str()));
+        planet->setGame(this);
 
-            fleets.push_back(fleet);
-            fleetLines.push_back(i);
+        m_planets.push_back(planet);
+        m_stateHash += HashPlanetState(i, planetState.owner, planetState.numShips);
+    }
 
-        } else {
+    const int numFleets = static_cast<int>(state.fleets.size());
+
+    for (int i = 0; i < numFleets; ++i) {
+        const FleetState& fleetState = state.fleets[i];
+
+        Fleet* fleet = new Fleet(this);
+        fleet->setOwner(this->getPlayer(fleetState.owner));
+        fleet->setNumShips(fleetState.numShips);
+        fleet->setSourceId(fleetState.sourceId);
+        fleet->setDestinationId(fleetState.destinationId);
+        fleet->setSource(m_planets[fleetState.sourceId]);
+        fleet->setDestination(m_planets[fleetState.destinationId]);
+        fleet->setTotalTripLength(fleetState.totalTripLength);
+        fleet->setTurnsRemaining(fleetState.turnsRemaining);
+
+        this->addFleet(fleet, state.turn + fleetState.turnsRemaining);
+    }
+}
+
+GameSnapshot PlanetWarsGame::takeSnapshot() const {
+    GameSnapshot state;
+    state.turn = m_turn;
+
+    const int numPlanets = static_cast<int>(m_planets.size());
+    state.planets.resize(numPlanets);
+
+    for (int i = 0; i < numPlanets; ++i) {
+        const Planet* planet = m_planets[i];
+        PlanetState& planetState = state.planets[i];
+
+        planetState.x = planet->getX();
+        planetState.y = planet->getY();
+        planetState.owner = planet->getOwner()->getId();
+        planetState.numShips = planet->getNumShips();
+        planetState.growthRate = planet->getGrowthRate();
+
+        const PlanetProperties& properties = planet->getProperties();
+
+        for (int j = 0; j < properties.size(); ++j) {
+            planetState.properties.push_back(std::make_pair(PropertyNames::getName(properties.getNameId(j)),
+                                                            properties.getValue(j)));
+        }
+    }
+
+    state.fleets.reserve(m_fleets.size());
+
+    for (FleetList::const_iterator it = m_fleets.begin(); it != m_fleets.end(); ++it) {
+        state.fleets.push_back((*it)->getState());
+    }
+
+    return state;
+}
+
+GameDelta PlanetWarsGame::takeDelta() const {
+    GameDelta delta;
+    delta.turn = m_turn;
+
+    const int numChangedPlanets = static_cast<int>(m_changedPlanets.size());
+    delta.planets.resize(numChangedPlanets);
+
+    for (int i = 0; i < numChangedPlanets; ++i) {
+        const Planet* planet = m_changedPlanets[i];
+        PlanetChange& change = delta.planets[i];
+
+        change.planetId = planet->getId();
+        change.owner = planet->getOwner()->getId();
+        change.numShips = planet->getNumShips();
+    }
+
+    const int numNewFleets = static_cast<int>(m_newFleets.size());
+    delta.newFleets.reserve(numNewFleets);
+
+    for (int i = 0; i < numNewFleets; ++i) {
+        delta.newFleets.push_back(m_newFleets[i]->getState());
+    }
+
+    delta.landedFleets = m_landedFleets;
+    delta.properties = m_changedProperties;
+
+    return delta;
+}
+
+bool PlanetWarsGame::showSnapshot(const GameSnapshot &state) {
+    //Make sure there's a player for every owner in the game being shown.  The state may
+    //have come from another process, so the owners are checked like those of a map.
+    int maxOwner = 2;
+
+    for (size_t i = 0; i < state.planets.size(); ++i) {
+        const int owner = state.planets[i].owner;
+
+        if (owner < 0 || owner > MAX_PLAYERS) {
             std::stringstream message;
-            message << "Map file error [line " << i
-                    << "]: a non-empty line that does not contain a planet or a fleet.";
+            message << "Game state error: planet " << i << " is owned by an unknown player " << owner << ".";
             this->logError(message.str());
-            failed = true;
-            break;
+            return false;
         }
+
+        maxOwner = std::max(maxOwner, owner);
     }
 
-    const int numPlanets = static_cast<int>(planets.size());
+    for (size_t i = 0; i < state.fleets.size(); ++i) {
+        const int owner = state.fleets[i].owner;
 
-    //Resolve planet references inside fleets.
-    int fleetIndex = 0;
+        if (owner < 1 || owner > MAX_PLAYERS) {
+            std::stringstream message;
+            message << "Game state error: fleet " << i << " is owned by an invalid player " << owner << ".";
+            this->logError(message.str());
+            return false;
+        }
 
-    if (!failed) {
-        for (FleetList::iterator it = fleets.begin(); it != fleets.end(); ++it) {
-            Fleet* fleet = *it;
+        maxOwner = std::max(maxOwner, owner);
+    }
 
-            //Attempt to resolve the source planet.
-            const int sourceId = fleet->getSourceId();
+    this->stop();
 
-            if (sourceId < 0 || sourceId >= numPlanets) {
-                std::stringstream message;
-                message << "Map file error [line " << fleetLines[fleetIndex]
-                        << "]: fleet refers to an invalid planet with id=" << sourceId << ".";
-                this->logError(message.str());
-                failed = true;
-                break;
-
-            } else {
-                fleet->setSource(planets[sourceId]);
-            }
+    this->setNumPlayers(maxOwner);
+    this->loadSnapshot(state);
+    m_newFleets.clear();
+    m_turn = state.turn;
 
-            //Attempt to resolve the destination planet.
-            const int destinationId = fleet->getDestinationId();
+    emit wasReset();
+    return true;
+}
 
-            if (destinationId < 0 || destinationId >= numPlanets) {
-                std::stringstream message;
-                message << "Map file error [line " << fleetLines[fleetIndex]
-                        << "]: fleet refers to an invalid planet with id=" << destinationId << ".";
-                this->logError(message.str());
-                failed = true;
-                break;
-
-            } else {
-                fleet->setDestination(planets[destinationId]);
-            }
+void PlanetWarsGame::showDelta(const GameDelta &delta) {
+    if (RESET != m_state && STOPPED != m_state) {
+        //Don't mess with a game that is being played here.
+        return;
+    }
+
+    this->clearChangedPlanets();
+    m_newFleets.clear();
+    m_landedFleets.clear();
+    m_isStateEncoded = false;
+    m_isDeltaEncoded = false;
+    m_isBoardCurrent = false;
+
+    //Move the fleets along, landing the ones that have arrived.
+    FleetList::iterator itFleet = m_fleets.begin();
 
-            //This will force recalculation of the current position.
-            fleet->setTurnsRemaining(fleet->getTurnsRemaining());
+    while (itFleet != m_fleets.end()) {
+        FleetList::iterator itCurrent = itFleet;
+        ++itFleet;
+
+        Fleet* fleet = (*itCurrent);
+        fleet->setTurnsRemaining(fleet->getTurnsRemaining() - 1);
 
-            ++fleetIndex;
+        if (fleet->getTurnsRemaining() <= 0) {
+            m_landedFleets.push_back(fleet->getState());
+            this->removeFleet(itCurrent);
         }
     }
 
-    if (failed) {
-        //Clean up.
-        for (int i = 0; i < numPlanets; ++i) delete planets[i];
-        for (FleetList::iterator it = fleets.begin(); it != fleets.end(); ++it) delete *it;
+    const int numPlanets = static_cast<int>(m_planets.size());
+    const int numNewFleets = static_cast<int>(delta.newFleets.size());
 
-        return;
+    for (int i = 0; i < numNewFleets; ++i) {
+        const FleetState& fleetState = delta.newFleets[i];
+
+        if (fleetState.sourceId < 0 || fleetState.sourceId >= numPlanets
+            || fleetState.destinationId < 0 || fleetState.destinationId >= numPlanets
+            || NULL == this->getPlayer(fleetState.owner) || 0 == fleetState.owner) {
+            continue;
+        }
+
+        Fleet* fleet = new Fleet(this);
+        fleet->setOwner(this->getPlayer(fleetState.owner));
+        fleet->setNumShips(fleetState.numShips);
+        fleet->setSourceId(fleetState.sourceId);
+        fleet->setDestinationId(fleetState.destinationId);
+        fleet->setSource(m_planets[fleetState.sourceId]);
+        fleet->setDestination(m_planets[fleetState.destinationId]);
+        fleet->setTotalTripLength(fleetState.totalTripLength);
+        fleet->setTurnsRemaining(fleetState.turnsRemaining);
+
+        this->addFleet(fleet, delta.turn + fleetState.turnsRemaining);
+        m_newFleets.push_back(fleet);
     }
 
-    //Parsed the map successfully. Reset the game.
-    //Stop any running processes.
-    this->stop();
-    this->stopPlayers();
+    //Update the planets.
+    const int numChangedPlanets = static_cast<int>(delta.planets.size());
 
-    //If didn't fail, replace the old planets and fleets with the new.
-    const int numOldPlanets = static_cast<int>(m_planets.size());
-    for (int i = 0; i < numOldPlanets; ++i) delete m_planets[i];
-    for (FleetList::iterator it = m_fleets.begin(); it != m_fleets.end(); ++it) delete (*it);
+    for (int i = 0; i < numChangedPlanets; ++i) {
+        const PlanetChange& change = delta.planets[i];
 
-    m_planets = planets;
-    m_fleets = fleets;
-    m_newFleets.insert(m_newFleets.end(), fleets.begin(), fleets.end());
+        if (change.planetId < 0 || change.planetId >= numPlanets || NULL == this->getPlayer(change.owner)) {
+            continue;
+        }
 
-    //Reset all flags and counters.
-    m_state = RESET;
-    m_turn = 0;
+        Planet* planet = m_planets[change.planetId];
+        planet->setOwner(this->getPlayer(change.owner));
+        planet->setNumShips(change.numShips);
+    }
 
-    //Notify everyone of the resetn
-    this->logMessage("================= Game reset. ==================");
-    emit wasReset();
+    for (size_t i = 0; i < delta.properties.size(); ++i) {
+        const PropertyChange& property = delta.properties[i];
+
+        //Pass the changes on, so that spectators of this copy see them too.
+        if (property.planetId >= 0 && property.planetId < numPlanets
+            && m_planets[property.planetId]->setProperty(property.nameId, property.value)) {
+            m_changedProperties.push_back(property);
+        }
+    }
+
+    m_turn = delta.turn;
+    emit turnEnded();
 }
 
-Player* PlanetWarsGame::getPlayer(int playerId) const {
-    switch (playerId) {
-    case 0:
-        return m_neutralPlayer;
+void PlanetWarsGame::addFleet(Fleet *fleet, int arrivalTurn) {
+    fleet->setStateHash(HashFleetState(fleet, arrivalTurn));
+    m_stateHash += fleet->getStateHash();
+    m_fleets.push_back(fleet);
+}
+
+void PlanetWarsGame::removeFleet(FleetList::iterator it) {
+    Fleet* fleet = *it;
+    m_stateHash -= fleet->getStateHash();
+    m_fleets.erase(it);
+    delete fleet;
+}
 
-    case 1:
-        return m_firstPlayer;
+void PlanetWarsGame::planetChanged(Planet *planet) {
+    m_changedPlanets.push_back(planet);
+}
+
+void PlanetWarsGame::clearChangedPlanets() {
+    const int numChangedPlanets = static_cast<int>(m_changedPlanets.size());
+
+    for (int i = 0; i < numChangedPlanets; ++i) {
+        m_changedPlanets[i]->clearChanged();
+    }
+
+    m_changedPlanets.clear();
+    m_changedProperties.clear();
+}
+
+void PlanetWarsGame::setReplayFileName(QString replayFileName) {
+    m_replayFileName = replayFileName.toStdString();
+}
+
+void PlanetWarsGame::recordReplayTurn() {
+    if (!m_replayFile.is_open()) {
+        return;
+    }
 
-    case 2:
-        return m_secondPlayer;
+    //The hash lets replays be compared without parsing them (see FindReplayDivergence()).
+    char hash[17];
+    sprintf(hash, "%016llx", static_cast<unsigned long long>(this->getStateHash()));
 
-    default:
+    m_replayFile << "# turn " << m_turn << " hash " << hash << std::endl << this->encodeState().getText();
+    m_replayFile.flush();
+}
+
+Player* PlanetWarsGame::getPlayer(int playerId) const {
+    if (playerId < 0 || playerId >= static_cast<int>(m_players.size())) {
         //The program has screwed up.
         return NULL;
     }
+
+    return m_players[playerId];
+}
+
+void PlanetWarsGame::setNumPlayers(int numPlayers) {
+    numPlayers = std::max(2, std::min(numPlayers, static_cast<int>(MAX_PLAYERS)));
+
+    //Drop the bots that are no longer needed.
+    while (this->getNumPlayers() > numPlayers) {
+        Player* player = m_players.back();
+        m_players.pop_back();
+        delete player;
+    }
+
+    //Add new ones.
+    while (this->getNumPlayers() < numPlayers) {
+        const int id = static_cast<int>(m_players.size());
+
+        Player* player = new Player(this);
+        player->setId(id);
+        player->setGame(this);
+        player->setObjectName(QString("Player %1").arg(id));
+        QObject::connect(player, SIGNAL(receivedStdOut()), this, SLOT(checkPlayerResponses()));
+        QObject::connect(player, SIGNAL(processFinished()), this, SLOT(checkPlayerResponses()));
+
+        m_players.push_back(player);
+    }
 }
 
 void PlanetWarsGame::step() {
@@ -256,32 +498,49 @@ void PlanetWarsGame::step() {
 
     this->incrementTurn();
 
+    const int numPlayers = this->getNumPlayers();
+
     //On the first turn, launch the player bots.
     if (RESET == m_state) {
-        m_firstPlayer->start();
-        m_secondPlayer->start();
+        for (int i = 1; i <= numPlayers; ++i) {
+            m_players[i]->start();
+        }
 
         m_state = READY;
     }
 
     //Check whether the players are still running.  If they aren't, stop the game.
-    if (!m_firstPlayer->isRunning() || !m_secondPlayer->isRunning()) {
-        this->stop();
-        return;
+    for (int i = 1; i <= numPlayers; ++i) {
+        if (!m_players[i]->isRunning()) {
+            m_players[i]->setFailure(Player::CRASHED);
+            this->stop();
+            return;
+        }
     }
 
-    //Send the current game state to the bots.
-    std::string messageToFirstPlayer = this->toString(m_firstPlayer);
-    std::string messageToSecondPlayer = this->toString(m_secondPlayer);
+    //Send the current game state to the bots; the ones that asked for it get only the changes.
+    const int numPlanets = static_cast<int>(m_planets.size());
+    std::string playerMessage;
+
+    for (int i = 1; i <= numPlayers; ++i) {
+        Player* player = m_players[i];
+        player->beginTurn(numPlanets);
 
-    m_firstPlayer->sendGameState(messageToFirstPlayer);
-    m_secondPlayer->sendGameState(messageToSecondPlayer);
+        const GameStateMessage& message = player->isUsingDeltas() ? this->encodeDelta() : this->encodeState();
+
+        message.writePov(numPlayers, i, &playerMessage);
+        player->sendGameState(playerMessage);
+    }
 
     m_state = STEPPING;
+    m_turnClock.start();
 
     if (m_isTimerIgnored) {
-        //Check every once in a while whether the players are done.
-        m_timer->start(100);
+        //Nothing to time: the bots' output, or their exit, is what ends the turn.
+
+    } else if (m_isCpuTimed) {
+        //Keep an eye on how much CPU time the bots are using.
+        m_timer->start(CPU_POLL_INTERVAL);
 
     } else {
         //Set the timer; once the turn is over, checkPlayerResponses() will be called.
@@ -299,29 +558,45 @@ void PlanetWarsGame::checkPlayerResponses() {
         return;
     }
 
-    //Check whether the players are ready to have their orders processed.
-    const bool arePlayersDone = (m_firstPlayer->isDoneTurn() && m_secondPlayer->isDoneTurn());
+    //Check whether the players are ready to have their orders processed.  There's no point
+    //waiting for the others once someone has sent illegal orders or exited.
+    const int numPlayers = this->getNumPlayers();
+    bool arePlayersDone = true;
+    bool hasFailedPlayer = false;
+
+    for (int i = 1; i <= numPlayers; ++i) {
+        Player* player = m_players[i];
+        arePlayersDone = arePlayersDone && player->isDoneTurn();
+        hasFailedPlayer = hasFailedPlayer || player->hasInvalidOrders()
+                          || (!player->isDoneTurn() && !player->isRunning());
+    }
 
-    if (arePlayersDone) {
+    if (arePlayersDone || hasFailedPlayer) {
         m_timer->stop();
         this->completeStep();
 
-    } else {
-        if (m_isTimerIgnored) {
-            //Keep waiting until the players are done.
-            m_timer->stop();
-            m_timer->start(100);
+    } else if (m_isTimerIgnored) {
+        //Keep waiting until the players are done.
+        return;
 
-        } else {
-            if (m_timer->isActive()) {
-                //Wait for the turn to complete.
-                return;
+    } else if (m_isCpuTimed) {
+        if (this->isCpuBudgetSpent()) {
+            //Complete the step whether the players are ready or not.
+            m_timer->stop();
+            this->completeStep();
 
-            } else {
-                //Complete the step whether the players are ready or not.
-                this->completeStep();
-            }
+        } else if (!m_timer->isActive()) {
+            m_timer->start(CPU_POLL_INTERVAL);
         }
+
+    } else if (!m_timer->isActive()) {
+        //The deadline has passed; complete the step whether the players are ready or not.
+        const qint64 overshootUs = m_timer->getOvershootUs();
+        ++m_numDeadlines;
+        m_totalOvershootUs += overshootUs;
+        m_maxOvershootUs = std::max(m_maxOvershootUs, overshootUs);
+
+        this->completeStep();
     }
 }
 
@@ -332,257 +607,470 @@ void PlanetWarsGame::completeStep() {
     }
 
     m_state = PROCESSING;
+    m_isStateEncoded = false;
+    m_isDeltaEncoded = false;
 
-    //Clear the old new fleets.
+    //Clear the old new fleets and changes.
     m_newFleets.clear();
+    m_landedFleets.clear();
+    this->clearChangedPlanets();
 
-    //Read and process the the responses from each of the players.
-    std::string firstPlayerOutput(m_firstPlayer->readCommands());
-    std::string secondPlayerOutput(m_secondPlayer->readCommands());
+    //Check that the players finished the turn, and take the planet properties they set.
+    const int numPlayers = this->getNumPlayers();
+    bool arePlayersRunning = true;
 
-    bool isFirstPlayerRunning = this->processOrders(firstPlayerOutput, m_firstPlayer);
-    bool isSecondPlayerRunning = this->processOrders(secondPlayerOutput, m_secondPlayer);
+    for (int i = 1; i <= numPlayers; ++i) {
+        m_players[i]->endTurn();
+
+        if (!this->commitOrders(m_players[i])) {
+            arePlayersRunning = false;
+        }
+    }
 
     //Check whether the players are still alive.
-    if (!isFirstPlayerRunning || !isSecondPlayerRunning) {
+    if (!arePlayersRunning) {
         this->stop();
         return;
     }
 
     this->advanceGame();
+    m_turnHashes.push_back(this->getStateHash());
+    this->recordReplayTurn();
 
-    //Check each player's position.
-    int firstPlayerShips = 0;
-    int secondPlayerShips = 0;
+    emit turnEnded();
 
-    const int numPlanets = static_cast<int>(m_planets.size());
+    if (this->receivers(SIGNAL(turnEndedWith(GameDelta))) > 0) {
+        emit turnEndedWith(this->takeDelta());
+    }
 
-    for (int i = 0; i < numPlanets; ++i) {
-        Planet* planet = m_planets[i];
-        const int ownerId = planet->getOwner()->getId();
+    //Check for game end conditions.
+    if (this->checkGameOver()) {
+        this->stop();
+        return;
+    }
+
+    //Game is not over.
+    m_state = READY;
+    this->continueRunning();
+}
 
-        if (1 == ownerId) {
-            firstPlayerShips += planet->getNumShips();
+bool PlanetWarsGame::stageOrder(Player *player, const std::string &line, int lineNumber) {
+    if (line[0] == '#') {
+        //Check whether this is a special directive to the visualizer to display
+        //a planet property.  If so, save that property with the planet object.
+        if (line.size() < 2 || line[1] != '-')
+            return true;
+
+        std::vector<std::string> tokens = Tokenize(line, " ");
+        tokens.erase(tokens.begin());
+        if (tokens.size() == 4 && tokens[0] == "planet") {
+            PropertyChange property;
+            property.planetId = atoi(tokens[1].c_str());
+            property.nameId = PropertyNames::intern(tokens[2]);
+            property.value = tokens[3];
+
+            if (PropertyNames::NO_NAME == property.nameId) {
+                std::stringstream message;
+                message << "Error on line " << lineNumber << " of stdout output.  Property name is longer than "
+                        << PropertyNames::MAX_NAME_LENGTH << " characters, or too many names (over "
+                        << PropertyNames::MAX_NAMES << ") have been used; the property is ignored.";
+                player->logError(message.str());
+
+            } else if (property.planetId >= 0 && property.planetId < static_cast<int>(m_planets.size())) {
+                player->stageProperty(property);
+            }
 
-        } else if (2 == ownerId) {
-            secondPlayerShips += planet->getNumShips();
+        } else if (tokens.size() == 2 && tokens[0] == "protocol" && tokens[1] == "delta") {
+            //From the next turn on, send only the changes to this bot.
+            player->setUsingDeltas(true);
         }
+
+        return true;
     }
 
-    for (FleetList::iterator it = m_fleets.begin(); it != m_fleets.end(); ++it) {
-        Fleet* fleet = *it;
+    //Check whether the player has made any illegal moves.
+    StagedOrder order;
+    std::string error;
+    bool isLegal = ParseOrder(line, &order, &error)
+            && CheckOrderRoute(order, static_cast<int>(m_planets.size()), &error);
+
+    if (isLegal) {
+        //Earlier orders this turn may have already taken some of the ships.
+        Planet* sourcePlanet = m_planets[order.sourceId];
+        const int availableShips = sourcePlanet->getNumShips() - player->getReservedShips(order.sourceId);
+        isLegal = CheckOrderShips(order, player->getId(), sourcePlanet->getOwner()->getId(),
+                                  availableShips, &error);
+    }
 
-        if (1 == fleet->getOwner()->getId()) {
-            firstPlayerShips += fleet->getNumShips();
+    if (!isLegal) {
+        std::stringstream message;
+        message << "Error on line " << lineNumber << " of stdout output.  " << error;
+        player->logError(message.str());
+        return false;
+    }
 
-        } else {
-            secondPlayerShips += fleet->getNumShips();
+    player->stageOrder(order);
+
+    return true;
+}
+
+bool PlanetWarsGame::commitOrders(Player *player) {
+    if (player->hasInvalidOrders()) {
+        //The problem has already been reported.
+        player->setFailure(Player::ILLEGAL_ORDERS);
+        return false;
+    }
+
+    if (!player->isDoneTurn()) {
+        player->setFailure(player->isRunning() ? Player::TIMED_OUT : Player::CRASHED);
+
+        std::stringstream message;
+        message << "Error: player did not send \"go\" within allotted time.";
+        player->logError(message.str());
+        return false;
+    }
+
+    //Everything has been checked as it came in; only the changes are left to make.
+    //Properties set to the values they already have are left out of the turn's changes.
+    //The move orders are carried out with the rest of the turn (see advanceGame()).
+    const std::vector<PropertyChange>& properties = player->getStagedProperties();
+
+    for (size_t i = 0; i < properties.size(); ++i) {
+        const PropertyChange& property = properties[i];
+
+        if (m_planets[property.planetId]->setProperty(property.nameId, property.value)) {
+            m_changedProperties.push_back(property);
         }
     }
 
-    emit turnEnded();
+    return true;
+}
 
-    //Check for game end conditions.
-    bool isGameOver = false;
+bool PlanetWarsGame::isCpuBudgetSpent() const {
+    const qint64 turnLength = (1 == m_turn) ? m_firstTurnLength : m_turnLength;
 
-    if (firstPlayerShips == 0 && secondPlayerShips == 0) {
-        this->logMessage("Draw.");
-        isGameOver = true;
+    if (m_turnClock.elapsed() > turnLength * CPU_WALL_FACTOR) {
+        return true;
+    }
 
-    } else if (firstPlayerShips == 0) {
-        this->logMessage("Player 2 wins.");
-        isGameOver = true;
+    const int numPlayers = this->getNumPlayers();
 
-    } else if (secondPlayerShips == 0) {
-        this->logMessage("Player 1 wins.");
-        isGameOver = true;
+    for (int i = 1; i <= numPlayers; ++i) {
+        Player* player = m_players[i];
 
-    } else if (m_turn >= m_maxTurns) {
-        if (firstPlayerShips > secondPlayerShips) {
-            this->logMessage("Player 1 wins.");
-            isGameOver = true;
+        if (player->isDoneTurn()) {
+            continue;
+        }
 
-        } else if (firstPlayerShips < secondPlayerShips) {
-            this->logMessage("Player 2 wins.");
-            isGameOver = true;
+        //Fall back on wall time for bots whose CPU time can't be measured.
+        const qint64 cpuMs = player->getTurnCpuMs();
+        const qint64 usedMs = (cpuMs >= 0) ? cpuMs : m_turnClock.elapsed();
 
-        } else {
-            this->logMessage("Draw.");
-            isGameOver = true;
+        if (usedMs > turnLength) {
+            return true;
         }
     }
 
-    if (isGameOver) {
-        this->stop();
+    return false;
+}
+
+void PlanetWarsGame::reportPlayerStats() {
+    if (!LogMask::isEnabled(0, LogMask::MESSAGE)) {
         return;
     }
 
-    //Game is not over.
-    m_state = READY;
-    this->continueRunning();
+    const int numPlayers = this->getNumPlayers();
+
+    for (int i = 1; i <= numPlayers; ++i) {
+        const PlayerStats& stats = m_players[i]->getStats();
+
+        if (0 == stats.numTurns) {
+            continue;
+        }
+
+        std::stringstream message;
+        message << "Player " << i << " used " << stats.totalWallMs << " ms of wall time (at most "
+                << stats.maxTurnWallMs << " ms per turn)";
+
+        if (stats.totalCpuMs >= 0) {
+            message << ", " << stats.totalCpuMs << " ms of CPU time (at most "
+                    << stats.maxTurnCpuMs << " ms per turn)";
+        }
+
+        if (stats.peakRssKb >= 0) {
+            message << ", peak RSS " << stats.peakRssKb << " kB";
+        }
+
+        message << " over " << stats.numTurns << " turns.";
+        this->logMessage(message.str());
+    }
+
+    if (m_numDeadlines > 0) {
+        std::stringstream message;
+        message << "Turn deadlines fired " << m_totalOvershootUs / m_numDeadlines << " us late on average, "
+                << m_maxOvershootUs << " us at most, over " << m_numDeadlines << " turns.";
+        this->logMessage(message.str());
+    }
 }
 
-bool PlanetWarsGame::processOrders(const std::string &allOrders, Player *player) {
-    std::vector<std::string> lines = Tokenize(allOrders, "\r\n");
-    const int numLines = static_cast<int>(lines.size());
+std::vector<int> PlanetWarsGame::getShipCounts() const {
+    std::vector<int> playerShips(this->getNumPlayers() + 1, 0);
+
+    const int numPlanets = static_cast<int>(m_planets.size());
+
+    for (int i = 0; i < numPlanets; ++i) {
+        Planet* planet = m_planets[i];
+        playerShips[planet->getOwner()->getId()] += planet->getNumShips();
+    }
 
-    //Indicator whether "go" message was encountered.
-    bool foundGo = false;
+    for (FleetList::const_iterator it = m_fleets.begin(); it != m_fleets.end(); ++it) {
+        Fleet* fleet = *it;
+        playerShips[fleet->getOwner()->getId()] += fleet->getNumShips();
+    }
 
+    return playerShips;
+}
 
-    for (int i = 0; i < numLines; ++i) {
-        std::string& line = lines[i];
+bool PlanetWarsGame::checkGameOver() {
+    //Check each player's position.
+    const int numPlayers = this->getNumPlayers();
+    std::vector<int> playerShips = this->getShipCounts();
 
-        if (line.size() == 0) {
-            //Skip empty lines.
-            continue;
+    //Players that can't land anywhere any more are as good as out.
+    bool hasStranded = false;
 
-        } else if (line.compare("go") == 0) {
-            foundGo = true;
-            break;
-
-        } else if (line[0] == '#') {
-            //Check whether this is a special directive to the visualizer to display
-            //a planet property.  If so, save that property with the planet object.
-            if (line.size() < 2 || line[1] != '-')
-                continue;
-
-            std::vector<std::string> tokens = Tokenize(line, " ");
-            tokens.erase(tokens.begin());
-            if (tokens.size() == 4 && tokens[0] == "planet") {
-                int planetId = atoi(tokens[1].c_str());
-                const std::string& name = tokens[2];
-                const std::string& value = tokens[3];
-
-                Planet* planet = m_planets[planetId];
-                planet->setProperty(name, value);
+    if (m_adjudicationRules.isStrandedOut) {
+        for (int i = 1; i <= numPlayers; ++i) {
+            if (playerShips[i] > 0 && this->isStranded(i)) {
+                playerShips[i] = 0;
+                hasStranded = true;
             }
+        }
+    }
 
-            continue;
+    //The game goes on while at least two players have ships left.
+    int numAlive = 0;
+    int lastAlive = 0;
+
+    for (int i = 1; i <= numPlayers; ++i) {
+        if (playerShips[i] > 0) {
+            ++numAlive;
+            lastAlive = i;
         }
+    }
 
+    const int dominantPlayer = (numAlive > 1) ? this->findDominantPlayer(playerShips) : 0;
 
-        std::vector<std::string> tokens = Tokenize(line, " ");
+    if (numAlive > 1 && m_turn < m_maxTurns && 0 == dominantPlayer) {
+        return false;
+    }
 
-        //Check whether the player bot output a bad thing.
-        if (3 != tokens.size()) {
-            std::stringstream message;
-            message << "Error on line " << i << " of stdout output; expected 3 tokens on a move order line, have "
-                    << tokens.size() << ".";
-            player->logError(message.str());
-            return false;
+    if (numAlive <= 1) {
+        m_winner = lastAlive;
+
+        if (hasStranded) {
+            m_adjudication = ADJUDICATED_STRANDED;
         }
 
-        const int sourcePlanetId = atoi(tokens[0].c_str());
-        const int destinationPlanetId = atoi(tokens[1].c_str());
-        const int numShips = atoi(tokens[2].c_str());
+    } else if (0 != dominantPlayer) {
+        m_winner = dominantPlayer;
+        m_adjudication = ADJUDICATED_BY_RATIO;
 
-        //Check whether the player has made any illegal moves.
-        const int numPlanets = static_cast<int>(m_planets.size());
+    } else {
+        //Out of turns; the player with the most ships wins.
+        m_winner = 1;
+        bool isTied = false;
 
-        if (sourcePlanetId < 0 || sourcePlanetId >= numPlanets) {
-            std::stringstream message;
-            message << "Error on line " << i << " of stdout output.  Source planet "
-                    << sourcePlanetId << " does not exist.";
-            player->logError(message.str());
-            return false;
-        }
+        for (int i = 2; i <= numPlayers; ++i) {
+            if (playerShips[i] > playerShips[m_winner]) {
+                m_winner = i;
+                isTied = false;
 
-        if (destinationPlanetId < 0 || destinationPlanetId >= numPlanets) {
-            std::stringstream message;
-            message << "Error on line " << i << " of stdout output.  Destination planet "
-                    << destinationPlanetId << " does not exist.";
-            player->logError(message.str());
-            return false;
+            } else if (playerShips[i] == playerShips[m_winner]) {
+                isTied = true;
+            }
         }
 
-        if (sourcePlanetId == destinationPlanetId) {
-            std::stringstream message;
-            message << "Error on line " << i
-                    << " of stdout output.  Source planet and destination planet are the same. ";
-            player->logError(message.str());
-            return false;
+        if (isTied) {
+            m_winner = 0;
         }
+    }
 
-        Planet* sourcePlanet = m_planets[sourcePlanetId];
-        Planet* destinationPlanet = m_planets[destinationPlanetId];
+    std::stringstream message;
 
-        if (sourcePlanet->getOwner()->getId() != player->getId()) {
-            std::stringstream message;
-            message << "Error on line " << i << " of stdout output.  Source planet "
-                    << destinationPlanetId << " does not belong to this player.";
-            player->logError(message.str());
-            return false;
+    if (0 == m_winner) {
+        message << "Draw.";
+    } else {
+        message << "Player " << m_winner << " wins.";
+    }
+
+    if (ADJUDICATED_BY_RATIO == m_adjudication) {
+        message << "  Adjudicated: the winner has led by the ship and production ratios for "
+                << m_numDominantTurns << " turns.";
+
+    } else if (ADJUDICATED_STRANDED == m_adjudication) {
+        message << "  Adjudicated: the other players have no planets and can't take any.";
+    }
+
+    this->logMessage(message.str());
+    return true;
+}
+
+int PlanetWarsGame::findDominantPlayer(const std::vector<int>& playerShips) {
+    if (m_adjudicationRules.shipRatio <= 0 || m_adjudicationRules.numTurns <= 0) {
+        return 0;
+    }
+
+    const int numPlayers = this->getNumPlayers();
+    std::vector<int> production(numPlayers + 1, 0);
+
+    for (size_t i = 0; i < m_planets.size(); ++i) {
+        production[m_planets[i]->getOwner()->getId()] += m_planets[i]->getGrowthRate();
+    }
+
+    int leader = 1;
+
+    for (int i = 2; i <= numPlayers; ++i) {
+        if (playerShips[i] > playerShips[leader]) {
+            leader = i;
         }
+    }
 
-        if (numShips > sourcePlanet->getNumShips() || numShips < 0) {
-            std::stringstream message;
-            message << "Error on line " << i << " of stdout output.  Cannot send " << numShips
-                    << " ships from planet " << sourcePlanetId
-                    << ".  Planet has " << sourcePlanet->getNumShips() << " ships.";
-            player->logError(message.str());
-            return false;
+    bool isDominant = (playerShips[leader] > 0);
+
+    for (int i = 1; i <= numPlayers && isDominant; ++i) {
+        if (i == leader || (0 == playerShips[i] && 0 == production[i])) {
+            continue;
         }
 
-        sourcePlanet->setNumShips(sourcePlanet->getNumShips() - numShips);
+        isDominant = (playerShips[leader] >= m_adjudicationRules.shipRatio * playerShips[i])
+                     && (production[leader] >= m_adjudicationRules.productionRatio * production[i]);
+    }
 
-        //Create a new fleet.
-        Fleet* fleet = new Fleet(this);
-        fleet->setOwner(player);
-        fleet->setSource(sourcePlanet);
-        fleet->setDestination(destinationPlanet);
-        fleet->setNumShips(numShips);
-        const int distance = sourcePlanet->getDistanceTo(destinationPlanet);
-        fleet->setTotalTripLength(distance);
-        fleet->setTurnsRemaining(distance);
+    if (!isDominant) {
+        m_dominantPlayer = 0;
+        m_numDominantTurns = 0;
+        return 0;
+    }
 
-        m_newFleets.push_back(fleet);
-        m_fleets.push_back(fleet);
+    if (leader != m_dominantPlayer) {
+        m_dominantPlayer = leader;
+        m_numDominantTurns = 0;
     }
 
-    if (!foundGo) {
-        std::stringstream message;
-        message << "Error: player did not send \"go\" within allotted time.";
-        player->logError(message.str());
-        return false;
+    ++m_numDominantTurns;
+    return (m_numDominantTurns >= m_adjudicationRules.numTurns) ? leader : 0;
+}
+
+bool PlanetWarsGame::isStranded(int playerId) {
+    if (!m_isBoardCurrent) {
+        this->rebuildBoard();
     }
 
-    return true;
+    return IsStranded(m_board, playerId);
 }
 
 void PlanetWarsGame::advanceGame() {
-    //Make planets grow ships.
+    //The turn is played out by the rules on a plain copy of the board (see AdvanceGameState()),
+    //and the planets and fleets are then brought in line with it.  Going through their setters
+    //keeps the turn's changes and the state hash up to date.  The copy is kept from turn to
+    //turn; it only has to be made again when the game objects were changed some other way.
     const int numPlanets = static_cast<int>(m_planets.size());
+    const int numOldFleets = static_cast<int>(m_fleets.size());
+    const int numPlayers = this->getNumPlayers();
 
-    for (int i = 0; i < numPlanets; ++i) {
-        m_planets[i]->growFleets();
+    if (!m_isBoardCurrent) {
+        this->rebuildBoard();
+    }
+
+    m_turnOrders.resize(numPlayers);
+
+    for (int i = 1; i <= numPlayers; ++i) {
+        m_players[i]->takeStagedOrders(&m_turnOrders[i - 1]);
     }
 
-    //Advance fleets.
+    AdvanceGameState(m_turnOrders, &m_board, &m_turnEvents);
+
+    //Make the launched fleets, lining up all fleets the way the events refer to them.
+    const std::vector<FleetState>& launchedFleets = m_turnEvents.launchedFleets;
+    m_fleetSlots.clear();
+
     for (FleetList::iterator it = m_fleets.begin(); it != m_fleets.end(); ++it) {
-        (*it)->advance();
+        m_fleetSlots.push_back(it);
     }
 
-    //Welcome (or fight) the arrived fleets.
-    for (int i = 0; i < numPlanets; ++i) {
-        m_planets[i]->welcomeArrivedFleets();
+    for (size_t i = 0; i < launchedFleets.size(); ++i) {
+        const FleetState& fleetState = launchedFleets[i];
+
+        Fleet* fleet = new Fleet(this);
+        fleet->setOwner(m_players[fleetState.owner]);
+        fleet->setNumShips(fleetState.numShips);
+        fleet->setSourceId(fleetState.sourceId);
+        fleet->setDestinationId(fleetState.destinationId);
+        fleet->setSource(m_planets[fleetState.sourceId]);
+        fleet->setDestination(m_planets[fleetState.destinationId]);
+        fleet->setTotalTripLength(fleetState.totalTripLength);
+        fleet->setTurnsRemaining(fleetState.turnsRemaining);
+
+        //The turn ends with the fleet one step along.
+        m_newFleets.push_back(fleet);
+        this->addFleet(fleet, m_turn + fleetState.totalTripLength - 1);
+        m_fleetSlots.push_back(--m_fleets.end());
     }
 
     //Clean up arrived fleets.
-    FleetList::iterator itFleet = m_fleets.begin();
+    const std::vector<std::pair<int, FleetState> >& landedFleets = m_turnEvents.landedFleets;
+
+    for (size_t i = 0; i < landedFleets.size(); ++i) {
+        const int fleetIndex = landedFleets[i].first;
+        Fleet* fleet = *m_fleetSlots[fleetIndex];
+
+        //A fleet may land on the turn it was sent out.
+        if (fleetIndex >= numOldFleets) {
+            m_newFleets.erase(std::remove(m_newFleets.begin(), m_newFleets.end(), fleet), m_newFleets.end());
+        }
+
+        m_landedFleets.push_back(landedFleets[i].second);
+        this->removeFleet(m_fleetSlots[fleetIndex]);
+    }
+
+    //The fleets left are the ones still in flight on the board, in the same order.
+    int fleetIndex = 0;
+
+    for (FleetList::iterator it = m_fleets.begin(); it != m_fleets.end(); ++it, ++fleetIndex) {
+        (*it)->setTurnsRemaining(m_board.fleets[fleetIndex].turnsRemaining);
+    }
+
+    //Growth and battles.
+    for (int i = 0; i < numPlanets; ++i) {
+        const PlanetState& planetState = m_board.planets[i];
+        m_planets[i]->setOwner(m_players[planetState.owner]);
+        m_planets[i]->setNumShips(planetState.numShips);
+    }
+}
 
-    while (itFleet != m_fleets.end()) {
-        FleetList::iterator itCurrent = itFleet;
-        ++itFleet;
+void PlanetWarsGame::rebuildBoard() {
+    const int numPlanets = static_cast<int>(m_planets.size());
 
-        Fleet* fleet = (*itCurrent);
+    m_board.turn = m_turn - 1;
+    m_board.planets.resize(numPlanets);
+    m_board.fleets.clear();
 
-        if (fleet->getTurnsRemaining() <= 0) {
-            delete fleet;
-            m_fleets.erase(itCurrent);
+    for (int i = 0; i < numPlanets; ++i) {
+        const Planet* planet = m_planets[i];
+        PlanetState& planetState = m_board.planets[i];
+        planetState.x = planet->getX();
+        planetState.y = planet->getY();
+        planetState.owner = planet->getOwner()->getId();
+        planetState.numShips = planet->getNumShips();
+        planetState.growthRate = planet->getGrowthRate();
+    }
 
-        }
+    for (FleetList::const_iterator it = m_fleets.begin(); it != m_fleets.end(); ++it) {
+        m_board.fleets.push_back((*it)->getState());
     }
+
+    m_isBoardCurrent = true;
 }
 
 void PlanetWarsGame::run() {
@@ -595,9 +1083,15 @@ void PlanetWarsGame::pause() {
 }
 
 void PlanetWarsGame::stop() {
+    if (STOPPED != m_state && m_turn > 0) {
+        this->reportPlayerStats();
+    }
+
     m_state = STOPPED;
     m_runningState = PAUSED;
     this->logMessage("Game ended");
+
+    emit stopped();
 }
 
 void PlanetWarsGame::setMapFileName(QString mapFileName) {
@@ -635,188 +1129,404 @@ void PlanetWarsGame::continueRunning() {
 }
 
 std::string PlanetWarsGame::toString(Player* pov) const {
-    std::stringstream gameState;
-    const int numPlanets = static_cast<int>(m_planets.size());
+    GameStateMessage stateMessage;
+    stateMessage.encode(m_planets, m_fleets);
 
-    //Write the planets.
-    for (int i = 0; i < numPlanets; ++i) {
-        Planet* planet = m_planets[i];
-        gameState << "P " << planet->getX()
-                << " " << planet->getY()
-                << " " << pov->povId(planet->getOwner())
-                << " " << planet->getNumShips()
-                << " " << planet->getGrowthRate()
-                << std::endl;
+    if (NULL == pov) {
+        return stateMessage.getText();
     }
 
-    //Write the fleets.
-    for (FleetList::const_iterator it = m_fleets.begin(); it != m_fleets.end(); ++it) {
-        Fleet* fleet = (*it);
-        gameState << "F " << pov->povId(fleet->getOwner())
-                << " " << fleet->getNumShips()
-                << " " << fleet->getSource()->getId()
-                << " " << fleet->getDestination()->getId()
-                << " " << fleet->getTotalTripLength()
-                << " " << fleet->getTurnsRemaining()
-                << std::endl;
+    std::string message;
+    stateMessage.writePov(this->getNumPlayers(), pov->getId(), &message);
+    return message;
+}
+
+const GameStateMessage& PlanetWarsGame::encodeState() {
+    if (!m_isStateEncoded) {
+        m_stateMessage.encode(m_planets, m_fleets);
+        m_isStateEncoded = true;
     }
 
-    gameState << "go" << std::endl;
+    return m_stateMessage;
+}
 
-    return gameState.str();
+const GameStateMessage& PlanetWarsGame::encodeDelta() {
+    if (!m_isDeltaEncoded) {
+        m_deltaMessage.encodeDelta(this->takeDelta());
+        m_isDeltaEncoded = true;
+    }
 
+    return m_deltaMessage;
 }
 
 void PlanetWarsGame::stopPlayers() {
-    m_firstPlayer->stop();
-    m_secondPlayer->stop();
+    const int numPlayers = this->getNumPlayers();
+
+    for (int i = 1; i <= numPlayers; ++i) {
+        m_players[i]->stop();
+    }
 }
 
 void PlanetWarsGame::logMessage(const std::string &message) {
-    emit logMessage(message, this);
+    if (LogMask::isEnabled(0, LogMask::MESSAGE)) {
+        emit logMessage(message, this->objectName());
+    }
 }
 
 void PlanetWarsGame::logError(const std::string &message) {
-    emit logError(message, this);
+    if (LogMask::isEnabled(0, LogMask::ERROR)) {
+        emit logError(message, this->objectName());
+    }
 }
 
 void PlanetWarsGame::incrementTurn() {
     ++m_turn;
-    std::stringstream message;
-    message << "Turn " << m_turn;
-    this->logMessage(message.str());
+
+    if (LogMask::isEnabled(0, LogMask::MESSAGE)) {
+        std::stringstream message;
+        message << "Turn " << m_turn;
+        this->logMessage(message.str());
+    }
 }
 
 /*===================================================
-                Class Planet.
+                State hashing.
 ====================================================*/
-Planet::Planet(QObject *parent)
-    :QObject(parent) {
+namespace {
+
+//Scramble the bits of a number (the finalizer of splitmix64).
+quint64 MixHash(quint64 value) {
+    value ^= value >> 30;
+    value *= Q_UINT64_C(0xbf58476d1ce4e5b9);
+    value ^= value >> 27;
+    value *= Q_UINT64_C(0x94d049bb133111eb);
+    value ^= value >> 31;
+    return value;
 }
 
-void Planet::setOwner(Player *player) {
-    m_owner = player;
-    emit ownerSet(player);
+//Hash a list of values of some kind of object.
+quint64 HashValues(quint64 kind, const int* values, int numValues) {
+    quint64 hash = MixHash(kind);
+
+    for (int i = 0; i < numValues; ++i) {
+        hash = MixHash(hash ^ static_cast<quint32>(values[i]));
+    }
+
+    return hash;
 }
 
-void Planet::setNumShips(int numShips) {
-    m_numShips = numShips;
-    emit numShipsSet(m_numShips);
 }
 
-int Planet::getDistanceTo(Planet *planet) const {
-    const double dx = planet->m_x - this->m_x;
-    const double dy = planet->m_y - this->m_y;
-    const int distance = static_cast<int>(ceil(sqrt(dx*dx + dy*dy)));
-    return distance;
+quint64 HashPlanetState(int planetId, int ownerId, int numShips) {
+    const int values[] = {planetId, ownerId, numShips};
+    return HashValues(1, values, 3);
+}
+
+quint64 HashFleetState(const Fleet* fleet, int arrivalTurn) {
+    const int values[] = {fleet->getOwner()->getId(), fleet->getNumShips(), fleet->getSource()->getId(),
+                          fleet->getDestination()->getId(), fleet->getTotalTripLength(), arrivalTurn};
+    return HashValues(2, values, 6);
+}
+
+quint64 HashTurn(int turn) {
+    return HashValues(3, &turn, 1);
 }
 
-void Planet::growFleets() {
-    //Grow fleets only on non-neutral planets.
-    if (m_owner->getId() != 0) {
-        m_numShips += m_growthRate;
-        emit numShipsSet(m_numShips);
+/*===================================================
+                Game state parsing.
+====================================================*/
+void ApplyGameDelta(const GameDelta &delta, GameSnapshot *state) {
+    //Move the fleets along, dropping the ones that have arrived.
+    std::vector<FleetState>& fleets = state->fleets;
+    size_t numRemaining = 0;
+
+    for (size_t i = 0; i < fleets.size(); ++i) {
+        if (--fleets[i].turnsRemaining > 0) {
+            fleets[numRemaining++] = fleets[i];
+        }
+    }
+
+    fleets.resize(numRemaining);
+    fleets.insert(fleets.end(), delta.newFleets.begin(), delta.newFleets.end());
+
+    //Update the planet properties.
+    const int numPlanets = static_cast<int>(state->planets.size());
+
+    for (size_t i = 0; i < delta.properties.size(); ++i) {
+        const PropertyChange& change = delta.properties[i];
+
+        if (change.planetId < 0 || change.planetId >= numPlanets) {
+            continue;
+        }
+
+        std::vector<std::pair<std::string, std::string> >& properties = state->planets[change.planetId].properties;
+        const std::string& name = PropertyNames::getName(change.nameId);
+        size_t j = 0;
+
+        while (j < properties.size() && properties[j].first != name) {
+            ++j;
+        }
+
+        if (j < properties.size()) {
+            properties[j].second = change.value;
+
+        } else {
+            properties.push_back(std::make_pair(name, change.value));
+        }
+    }
+
+    //Update the planets.
+    for (size_t i = 0; i < delta.planets.size(); ++i) {
+        const PlanetChange& change = delta.planets[i];
+
+        if (change.planetId >= 0 && change.planetId < numPlanets) {
+            state->planets[change.planetId].owner = change.owner;
+            state->planets[change.planetId].numShips = change.numShips;
+        }
     }
+
+    state->turn = delta.turn;
 }
 
-void Planet::welcomeArrivedFleets() {
-    const int ownerId = m_owner->getId();
+bool ReadReplayHashes(const std::string &text, std::vector<quint64> *hashes, std::string *error) {
+    hashes->clear();
 
-    //Tally up the ships for each force.
-    const int numArrivedFleets = static_cast<int>(m_landedFleets.size());
+    //Each turn starts with a "# turn <n> hash <hash>" line.
+    const std::string marker = "# turn ";
+    size_t position = (0 == text.compare(0, marker.size(), marker)) ? 0 : text.find("\n" + marker);
 
-    if (numArrivedFleets == 0) {
-        return;
+    while (std::string::npos != position) {
+        if ('\n' == text[position]) {
+            ++position;
+        }
+
+        const size_t lineEnd = text.find('\n', position);
+        const std::string line = text.substr(position, lineEnd - position);
+
+        int turn = 0;
+        unsigned long long hash = 0;
+
+        if (2 != sscanf(line.c_str(), "# turn %d hash %llx", &turn, &hash)) {
+            std::stringstream message;
+            message << "Replay turn " << hashes->size() << " has no state hash.";
+            *error = message.str();
+            return false;
+        }
+
+        hashes->push_back(hash);
+        position = (std::string::npos == lineEnd) ? lineEnd : text.find("\n" + marker, lineEnd);
     }
 
-    int playerShips[3];
-    playerShips[0] = (ownerId == 0) ? m_numShips : 0;
-    playerShips[1] = (ownerId == 1) ? m_numShips : 0;
-    playerShips[2] = (ownerId == 2) ? m_numShips : 0;
+    return true;
+}
 
-    for (int i = 0; i < numArrivedFleets; ++i) {
-        Fleet* fleet = m_landedFleets[i];
-        playerShips[fleet->getOwner()->getId()] += fleet->getNumShips();
+int FindReplayDivergence(const std::vector<quint64> &first, const std::vector<quint64> &second) {
+    const int numCommonTurns = static_cast<int>(std::min(first.size(), second.size()));
+
+    //Find the first turn with different hashes, or the end of the shorter run.
+    int agreed = 0;
+    int differs = numCommonTurns;
+
+    while (agreed < differs) {
+        const int middle = agreed + (differs - agreed) / 2;
+
+        if (first[middle] == second[middle]) {
+            agreed = middle + 1;
+        } else {
+            differs = middle;
+        }
     }
 
-    m_landedFleets.clear();
+    if (differs == numCommonTurns && first.size() == second.size()) {
+        return -1;
+    }
 
-    //Check who won.
-    //Check whether the owner stays the same.
-    if (playerShips[ownerId] >= std::max(playerShips[(ownerId+1)%3], playerShips[(ownerId+2)%3])) {
-        this->setNumShips(playerShips[ownerId]
-                          - std::max(playerShips[(ownerId+1)%3], playerShips[(ownerId+2)%3]));
-        return;
+    return differs;
+}
+
+/*===================================================
+                Class GameStateMessage.
+====================================================*/
+void GameStateMessage::encode(const std::vector<Planet*>& planets, const FleetList& fleets) {
+    std::stringstream gameState;
+    m_ownerOffsets.clear();
+
+    //The owner ids are written as single digits, so they can be rewritten in place.
+    const int numPlanets = static_cast<int>(planets.size());
+
+    //Write the planets.
+    for (int i = 0; i < numPlanets; ++i) {
+        Planet* planet = planets[i];
+        gameState << "P " << planet->getX()
+                << " " << planet->getY()
+                << " ";
+        m_ownerOffsets.push_back(static_cast<size_t>(gameState.tellp()));
+        gameState << planet->getOwner()->getId()
+                << " " << planet->getNumShips()
+                << " " << planet->getGrowthRate()
+                << std::endl;
+    }
+
+    //Write the fleets.
+    for (FleetList::const_iterator it = fleets.begin(); it != fleets.end(); ++it) {
+        Fleet* fleet = (*it);
+        gameState << "F ";
+        m_ownerOffsets.push_back(static_cast<size_t>(gameState.tellp()));
+        gameState << fleet->getOwner()->getId()
+                << " " << fleet->getNumShips()
+                << " " << fleet->getSource()->getId()
+                << " " << fleet->getDestination()->getId()
+                << " " << fleet->getTotalTripLength()
+                << " " << fleet->getTurnsRemaining()
+                << std::endl;
+    }
+
+    gameState << "go" << std::endl;
+
+    m_text = gameState.str();
+}
+
+void GameStateMessage::encodeDelta(const GameDelta& delta) {
+    std::stringstream changes;
+    m_ownerOffsets.clear();
+
+    for (size_t i = 0; i < delta.planets.size(); ++i) {
+        const PlanetChange& change = delta.planets[i];
+        changes << "C " << change.planetId << " ";
+        m_ownerOffsets.push_back(static_cast<size_t>(changes.tellp()));
+        changes << change.owner
+                << " " << change.numShips
+                << std::endl;
     }
 
-    //Otherwise, find the new owner.
-    if (playerShips[1] > playerShips[2]) {
-        this->setOwner(m_game->getFirstPlayer());
-        const int remainingShips = playerShips[1] - std::max(playerShips[2], playerShips[0]);
-        this->setNumShips(remainingShips);
+    for (size_t i = 0; i < delta.newFleets.size(); ++i) {
+        const FleetState& fleet = delta.newFleets[i];
+        changes << "F ";
+        m_ownerOffsets.push_back(static_cast<size_t>(changes.tellp()));
+        changes << fleet.owner
+                << " " << fleet.numShips
+                << " " << fleet.sourceId
+                << " " << fleet.destinationId
+                << " " << fleet.totalTripLength
+                << " " << fleet.turnsRemaining
+                << std::endl;
+    }
+
+    changes << "go" << std::endl;
+
+    m_text = changes.str();
+}
 
-    } else if (playerShips[2] > playerShips[1]) {
-        this->setOwner(m_game->getSecondPlayer());
-        const int remainingShips = playerShips[2] - std::max(playerShips[1], playerShips[0]);
-        this->setNumShips(remainingShips);
+void GameStateMessage::writePov(int numPlayers, int povPlayerId, std::string* message) const {
+    message->assign(m_text);
 
-    } else if (ownerId == 0 && playerShips[2] == playerShips[1]) {
-        //The invading fleets are larger than the neutral planet, but equal in size.
-        //Planet stays neutral.
-        this->setNumShips(0);
+    if (1 == povPlayerId) {
+        //Player 1 sees the actual owner ids.
+        return;
     }
 
-    //There should be no other cases.
+    //Pick the version of the code made for this number of players.
+    switch (numPlayers) {
+    case 2: this->patchOwners<2>(povPlayerId, message); break;
+    case 3: this->patchOwners<3>(povPlayerId, message); break;
+    case 4: this->patchOwners<4>(povPlayerId, message); break;
+    case 5: this->patchOwners<5>(povPlayerId, message); break;
+    case 6: this->patchOwners<6>(povPlayerId, message); break;
+    case 7: this->patchOwners<7>(povPlayerId, message); break;
+    default: this->patchOwners<PlanetWarsGame::MAX_PLAYERS>(povPlayerId, message); break;
+    }
 }
 
-void Planet::landFleet(Fleet *fleet) {
-    m_landedFleets.push_back(fleet);
+template <int NUM_PLAYERS>
+void GameStateMessage::patchOwners(int povPlayerId, std::string* message) const {
+    const size_t numOwners = m_ownerOffsets.size();
+
+    for (size_t i = 0; i < numOwners; ++i) {
+        char& owner = (*message)[m_ownerOffsets[i]];
+        owner = static_cast<char>('0' + PovId<NUM_PLAYERS>(povPlayerId, owner - '0'));
+    }
 }
 
 /*===================================================
-                Class Fleet.
+                Class Planet.
 ====================================================*/
-Fleet::Fleet(QObject *parent)
-    :QObject(parent), m_source(NULL), m_destination(NULL) {
+Planet::Planet(QObject *parent)
+    :QObject(parent), m_owner(NULL), m_numShips(0), m_game(NULL), m_propsVersion(0), m_isChanged(false) {
 }
 
-void Fleet::setTurnsRemaining(int turnsRemaining) {
-    m_turnsRemaining = turnsRemaining;
+void Planet::setOwner(Player *player) {
+    if (player != m_owner) {
+        this->markChanged();
+        this->updateHash(player, m_numShips);
+    }
 
-    //Update the position change.
-    if (NULL != m_source && NULL != m_destination) {
-        const double sourceX = m_source->getX();
-        const double sourceY = m_source->getY();
-        const double destinationX = m_destination->getX();
-        const double destinationY = m_destination->getY();
-        const double tripLength = static_cast<double>(m_totalTripLength);
-        const double travelled = static_cast<double>(m_totalTripLength - turnsRemaining);
+    m_owner = player;
+}
 
-        const double tripDx = destinationX - sourceX;
-        const double tripDy = destinationY - sourceY;
+void Planet::setNumShips(int numShips) {
+    if (numShips != m_numShips) {
+        this->markChanged();
+        this->updateHash(m_owner, numShips);
+    }
 
-        const double x = sourceX + tripDx * travelled / tripLength;
-        const double y = sourceY + tripDy * travelled / tripLength;
+    m_numShips = numShips;
+}
 
-        m_x = x;
-        m_y = y;
+void Planet::markChanged() {
+    if (!m_isChanged && NULL != m_game) {
+        m_isChanged = true;
+        m_game->planetChanged(this);
     }
 }
 
-void Fleet::advance() {
-    this->setTurnsRemaining(--m_turnsRemaining);
+void Planet::updateHash(Player *owner, int numShips) {
+    if (NULL != m_game && NULL != m_owner && NULL != owner) {
+        m_game->updatePlanetHash(HashPlanetState(m_id, m_owner->getId(), m_numShips),
+                                 HashPlanetState(m_id, owner->getId(), numShips));
+    }
+}
 
-    if (m_turnsRemaining <= 0) {
-        //Arrived.
-        m_destination->landFleet(this);
+bool Planet::setProperty(int nameId, const std::string &value) {
+    if (!m_properties.set(nameId, value)) {
+        return false;
     }
+
+    ++m_propsVersion;
+    this->markChanged();
+    return true;
+}
+
+int Planet::getDistanceTo(Planet *planet) const {
+    return GetTripLength(m_x, m_y, planet->m_x, planet->m_y);
+}
+
+/*===================================================
+                Class Fleet.
+====================================================*/
+Fleet::Fleet(QObject *parent)
+    :QObject(parent), m_source(NULL), m_destination(NULL), m_stateHash(0) {
+}
+
+FleetState Fleet::getState() const {
+    FleetState state;
+    state.owner = m_owner->getId();
+    state.numShips = m_numShips;
+    state.sourceId = m_source->getId();
+    state.destinationId = m_destination->getId();
+    state.totalTripLength = m_totalTripLength;
+    state.turnsRemaining = m_turnsRemaining;
+    return state;
 }
 
 /*===================================================
                 Class Player.
 ====================================================*/
 Player::Player(QObject *parent)
-    :QObject(parent), m_is_started(false), m_is_alive(false), m_process(NULL) {
+    :QObject(parent), m_is_started(false), m_is_alive(false), m_process(NULL), m_game(NULL),
+      m_isDoneTurn(false), m_isUsingDeltas(false), m_failure(NO_FAILURE), m_isInTurn(false), m_hasInvalidOrders(false),
+      m_numTurnLines(0), m_numTurnBytes(0), m_turnStartCpuMs(-1), m_isTurnMeasured(true) {
+    memset(&m_stats, 0, sizeof(m_stats));
+
     //Set up the QProcess deletion timer.
     m_processDeletionTimer = new QTimer(this);
     m_processDeletionTimer->setSingleShot(true);
@@ -834,8 +1544,26 @@ void Player::start() {
         return;
     }
 
+    //A new bot gets the full state until it asks otherwise.
+    m_isUsingDeltas = false;
+    m_failure = NO_FAILURE;
+    memset(&m_stats, 0, sizeof(m_stats));
+    m_stats.peakRssKb = -1;
+
     //Launch a new bot process.
-    m_process = new QProcess(this);
+    BotProcess* process = new BotProcess(this);
+
+    if (NULL != m_game) {
+        std::stringstream name;
+        name << "player-" << m_id;
+        std::string error;
+
+        if (!process->setLimits(m_game->getBotLimits(), name.str(), &error)) {
+            this->logError(error + "  Limiting the bot with rlimits instead.");
+        }
+    }
+
+    m_process = process;
     QString launchCommand(m_launchCommand.c_str());
     m_process->start(launchCommand);
 
@@ -886,11 +1614,80 @@ void Player::deleteProcess() {
     m_process = NULL;
 }
 
-std::string Player::readCommands() {
-    //Return everything accumulated in the stdout buffer.
-    std::string commands(m_stdoutBuffer);
+void Player::takeStagedOrders(std::vector<StagedOrder>* orders) {
+    orders->swap(m_stagedOrders);
+    m_stagedOrders.clear();
+}
+
+void Player::beginTurn(int numPlanets) {
+    m_stagedOrders.clear();
+    m_stagedProperties.clear();
+    m_reservedShips.assign(numPlanets, 0);
     m_stdoutBuffer.clear();
-    return commands;
+    m_numTurnLines = 0;
+    m_numTurnBytes = 0;
+    m_isDoneTurn = false;
+    m_hasInvalidOrders = false;
+    m_isInTurn = true;
+
+    //Start the turn clocks.
+    m_turnClock.start();
+    m_turnStartCpuMs = -1;
+    m_isTurnMeasured = false;
+
+    ProcessUsage usage;
+
+    if (NULL != m_process && ReadProcessUsage(m_process->pid(), &usage)) {
+        m_turnStartCpuMs = usage.cpuMs;
+    }
+}
+
+void Player::endTurn() {
+    if (m_isTurnMeasured) {
+        return;
+    }
+
+    m_isTurnMeasured = true;
+
+    const qint64 wallMs = m_turnClock.elapsed();
+    m_stats.totalWallMs += wallMs;
+    m_stats.maxTurnWallMs = std::max(m_stats.maxTurnWallMs, wallMs);
+    ++m_stats.numTurns;
+
+    ProcessUsage usage;
+
+    if (m_turnStartCpuMs >= 0 && NULL != m_process && ReadProcessUsage(m_process->pid(), &usage)) {
+        const qint64 cpuMs = usage.cpuMs - m_turnStartCpuMs;
+
+        if (m_stats.totalCpuMs >= 0) {
+            m_stats.totalCpuMs += cpuMs;
+        }
+
+        m_stats.maxTurnCpuMs = std::max(m_stats.maxTurnCpuMs, cpuMs);
+        m_stats.peakRssKb = std::max(m_stats.peakRssKb, usage.peakRssKb);
+
+    } else {
+        m_stats.totalCpuMs = -1;
+    }
+}
+
+qint64 Player::getTurnCpuMs() const {
+    ProcessUsage usage;
+
+    if (m_turnStartCpuMs < 0 || NULL == m_process || !ReadProcessUsage(m_process->pid(), &usage)) {
+        return -1;
+    }
+
+    return usage.cpuMs - m_turnStartCpuMs;
+}
+
+void Player::stageOrder(const StagedOrder &order) {
+    m_stagedOrders.push_back(order);
+    m_reservedShips[order.sourceId] += order.numShips;
+}
+
+void Player::stageProperty(const PropertyChange &property) {
+    m_stagedProperties.push_back(property);
 }
 
 bool Player::isRunning() const {
@@ -904,27 +1701,13 @@ bool Player::isRunning() const {
 void Player::sendGameState(const std::string& gameState) {
     if (this->isRunning()) {
         m_process->write(gameState.c_str());
-        this->logStdIn(gameState);
-    }
-}
-
-int Player::povId(Player *player) const {
-    const int playerId = player->getId();
 
-    if (0 == playerId) {
-        return 0;
-    } else if (playerId != m_id) {
-        return 2;
-    } else {
-        return 1;
+        if (this->isLogging(LogMask::STDIN)) {
+            this->logStdIn(gameState);
+        }
     }
 }
 
-bool Player::isDoneTurn() {
-    bool isDone = (m_stdoutBuffer.find("go") != std::string::npos);
-    return isDone;
-}
-
 void Player::setLaunchCommand(QString launchCommand) {
     this->setLaunchCommand(launchCommand.toStdString());
 }
@@ -938,40 +1721,120 @@ void Player::readStdOut() {
     QString qContents(m_process->readAllStandardOutput());
     std::string contents(qContents.toStdString());
 
-    m_stdoutBuffer.append(contents);
-    this->logStdOut(contents);
+    if (this->isLogging(LogMask::STDOUT)) {
+        this->logStdOut(contents);
+    }
+
+    //Check the orders as the lines come in, so that only carrying them out is left for the end of the turn.
+    if (m_isInTurn) {
+        m_numTurnBytes += static_cast<int>(contents.size());
+
+        if (m_numTurnBytes > MAX_TURN_OUTPUT) {
+            std::stringstream message;
+            message << "Error: more than " << MAX_TURN_OUTPUT << " bytes of stdout output in one turn.";
+            this->rejectOrders(message.str());
+
+        } else {
+            m_stdoutBuffer.append(contents);
+            size_t lineBegin = 0;
+            size_t lineEnd = m_stdoutBuffer.find('\n');
+
+            while (std::string::npos != lineEnd && m_isInTurn) {
+                this->processLine(m_stdoutBuffer.substr(lineBegin, lineEnd - lineBegin));
+                lineBegin = lineEnd + 1;
+                lineEnd = m_stdoutBuffer.find('\n', lineBegin);
+            }
+
+            m_stdoutBuffer.erase(0, lineBegin);
+        }
+    }
 
     emit receivedStdOut();
 }
 
+void Player::processLine(const std::string &rawLine) {
+    const std::string line = (!rawLine.empty() && '\r' == rawLine[rawLine.size() - 1])
+            ? rawLine.substr(0, rawLine.size() - 1) : rawLine;
+    const int lineNumber = m_numTurnLines++;
+
+    if (line.size() == 0) {
+        //Skip empty lines.
+        return;
+
+    } else if (line.compare("go") == 0) {
+        this->endTurn();
+        m_isDoneTurn = true;
+        m_isInTurn = false;
+        return;
+    }
+
+    if (static_cast<int>(m_stagedOrders.size()) >= MAX_TURN_ORDERS) {
+        std::stringstream message;
+        message << "Error: more than " << MAX_TURN_ORDERS << " orders in one turn.";
+        this->rejectOrders(message.str());
+        return;
+    }
+
+    if (!m_game->stageOrder(this, line, lineNumber)) {
+        //The game has already said what's wrong.
+        this->rejectOrders(std::string());
+    }
+}
+
+void Player::rejectOrders(const std::string &message) {
+    if (!message.empty()) {
+        this->logError(message);
+    }
+
+    m_hasInvalidOrders = true;
+    m_isDoneTurn = true;
+    m_isInTurn = false;
+    m_stdoutBuffer.clear();
+}
+
 void Player::readStdErr() {
     if (NULL != m_process) {
-        QString qOutput(m_process->readAllStandardError());
-        this->logStdErr(qOutput.toStdString());
+        //Drain the pipe even if nobody wants to see the output.
+        QByteArray output(m_process->readAllStandardError());
+
+        if (this->isLogging(LogMask::STDERR)) {
+            this->logStdErr(QString(output).toStdString());
+        }
     }
 }
 
 void Player::onProcessFinished(int exitCode, QProcess::ExitStatus exitStatus) {
     this->logMessage("Bot process exited.");
+    emit processFinished();
 }
 
 void Player::logMessage(const std::string &message) {
-    emit logMessage(message, this);
+    if (this->isLogging(LogMask::MESSAGE)) {
+        emit logMessage(message, this->objectName());
+    }
 }
 
 void Player::logError(const std::string &message) {
-    emit logError(message, this);
+    if (this->isLogging(LogMask::ERROR)) {
+        emit logError(message, this->objectName());
+    }
 }
 
 void Player::logStdErr(const std::string &message) {
-    emit logStdErr(message, this);
+    if (this->isLogging(LogMask::STDERR)) {
+        emit logStdErr(message, this->objectName());
+    }
 }
 
 void Player::logStdIn(const std::string &message) {
-    emit logStdIn(message, this);
+    if (this->isLogging(LogMask::STDIN)) {
+        emit logStdIn(message, this->objectName());
+    }
 }
 
 void Player::logStdOut(const std::string &message) {
-    emit logStdOut(message, this);
+    if (this->isLogging(LogMask::STDOUT)) {
+        emit logStdOut(message, this->objectName());
+    }
 }
 
@@ -17,14 +17,22 @@
 #ifndef GAME_H
 #define GAME_H
 
+#include <fstream>
 #include <list>
 #include <string>
+#include <utility>
 #include <vector>
 #include <QtCore>
+#include <QElapsedTimer>
 #include <QObject>
 #include <QProcess>
 #include <QString>
 #include <QTimer>
+#include "botprocess.h"
+#include "deadlinetimer.h"
+#include "logmask.h"
+#include "properties.h"
+#include "rules.h"
 
 //Predeclared classes.
 class PlanetWarsGame;
@@ -34,6 +42,112 @@ class Player;
 
 typedef std::list<Fleet*> FleetList;
 
+//A change to a planet's owner or ship count.
+struct PlanetChange {
+    int planetId;
+    int owner;
+    int numShips;
+};
+
+//A planet property set by a bot.
+struct PropertyChange {
+    int planetId;
+    int nameId;         //See PropertyNames.
+    std::string value;
+};
+
+//The changes made to the game state during one turn, published once at the end of the turn.
+//Applying it doesn't need the fleets that landed: every fleet gets one turn closer to its
+//destination each turn, and the ones that reach it are gone.  They are listed for the
+//consumers that want them (with no turns remaining).  New fleets that are still in flight
+//at the end of the turn are appended after the remaining old ones.
+struct GameDelta {
+    int turn;
+    std::vector<PlanetChange> planets;
+    std::vector<FleetState> newFleets;
+    std::vector<FleetState> landedFleets;
+    std::vector<PropertyChange> properties;
+};
+
+//Let the states be passed between threads.
+Q_DECLARE_METATYPE(GameSnapshot)
+Q_DECLARE_METATYPE(GameDelta)
+
+//Bring a copy of the game state forward by one turn.
+void ApplyGameDelta(const GameDelta& delta, GameSnapshot* state);
+
+//Read the state hashes a replay was written with, by turn, without parsing the states.
+//Return false if a turn has no hash, e.g. in replays written before the hashes were added.
+bool ReadReplayHashes(const std::string& text, std::vector<quint64>* hashes, std::string* error);
+
+//Find the first turn on which two runs of a game differ, going by their state hashes; -1 if
+//they don't.  Runs that part ways stay apart, so the turn is found by binary search.
+int FindReplayDivergence(const std::vector<quint64>& first, const std::vector<quint64>& second);
+
+//A game state message, encoded once per turn with the actual owner ids.  Every player's
+//point of view is made from it by rewriting the owner fields in place, so the cost of
+//writing out the numbers doesn't grow with the number of players.
+//
+//Bots that print "#- protocol delta" get the full state only until then; after that,
+//each turn they get just the changes since the previous message:
+//  C <planet id> <owner> <num ships>                                   for each changed planet,
+//  F <owner> <num ships> <source> <destination> <trip length> <turns remaining>
+//                                                                      for each new fleet,
+//followed by "go".  Every fleet already in flight gets one turn closer to its
+//destination, and lands once it has no turns remaining; new fleets go after the others.
+class GameStateMessage {
+public:
+    //Write out the planets and fleets.
+    void encode(const std::vector<Planet*>& planets, const FleetList& fleets);
+
+    //Write out the changes made during a turn.
+    void encodeDelta(const GameDelta& delta);
+
+    //Get the message with the actual owner ids.
+    const std::string& getText() const      {return m_text;}
+
+    //Get the message as seen by one of the players.
+    void writePov(int numPlayers, int povPlayerId, std::string* message) const;
+
+private:
+    template <int NUM_PLAYERS>
+    void patchOwners(int povPlayerId, std::string* message) const;
+
+    std::string m_text;
+    std::vector<size_t> m_ownerOffsets;     //Positions of the owner ids, which are all single digits.
+};
+
+//Parts of the state hash (see PlanetWarsGame::getStateHash()).  Fleets are hashed with the
+//turn they land on instead of the turns they have left, so that their part doesn't change
+//while they fly.
+quint64 HashPlanetState(int planetId, int ownerId, int numShips);
+quint64 HashFleetState(const Fleet* fleet, int arrivalTurn);
+quint64 HashTurn(int turn);
+
+//Resources used by a bot over a game.
+struct PlayerStats {
+    int numTurns;
+    qint64 totalCpuMs;      //-1 if the CPU time can't be measured.
+    qint64 maxTurnCpuMs;
+    qint64 totalWallMs;
+    qint64 maxTurnWallMs;
+    qint64 peakRssKb;       //-1 if unknown.
+};
+
+//Rules for ending games whose outcome is no longer in doubt.  Zeros turn a rule off.
+struct AdjudicationRules {
+    AdjudicationRules();
+
+    //The leader wins once it has shipRatio times the ships and productionRatio times the
+    //production of every other player for numTurns turns in a row.
+    double shipRatio;
+    double productionRatio;
+    int numTurns;
+
+    //A player without planets is out once none of its fleets can take the planet it's headed for.
+    bool isStrandedOut;
+};
+
 //A class responsible for keeping track of the game state.
 class PlanetWarsGame : public QObject {
     Q_OBJECT
@@ -54,48 +168,132 @@ public:
         PAUSED,
     };
 
+    //How the game was decided before its natural end, if it was.
+    enum Adjudication {
+        NOT_ADJUDICATED,
+        ADJUDICATED_BY_RATIO,
+        ADJUDICATED_STRANDED
+    };
+
+    //Most bots that can take part in one game.  Owner ids must stay single digits
+    //(see GameStateMessage).
+    static const int MAX_PLAYERS = MAX_NUM_PLAYERS;
+
     PlanetWarsGame(QObject* parent);
 
     //Game information.
-    std::vector<Planet*> getPlanets() const     {return m_planets;}
-    FleetList getFleets() const                 {return m_fleets;}
+    const std::vector<Planet*>& getPlanets() const  {return m_planets;}
+    const FleetList& getFleets() const          {return m_fleets;}
     int getWinner() const                       {return m_winner;}
+    int getTurn() const                         {return m_turn;}
+    Adjudication getAdjudication() const        {return m_adjudication;}
     std::string getMapFileName() const          {return m_mapFileName;}
+    std::string getReplayFileName() const       {return m_replayFileName;}
     int getFirstTurnLength() const              {return m_firstTurnLength;}
     int getTurnLength() const                   {return m_turnLength;}
     int isTimerIgnored() const                  {return m_isTimerIgnored;}
+    bool isCpuTimed() const                     {return m_isCpuTimed;}
     int getMaxTurns() const                     {return m_maxTurns;}
+    GameState getState() const                  {return m_state;}
+
+    //Count the ships on the planets and in the fleets of every owner, indexed by player id.
+    std::vector<int> getShipCounts() const;
 
     //Get the fleets that have appeared on the most recent turn.
     std::vector<Fleet*> getNewFleets() const    {return m_newFleets;}
 
+    //Get the fleets that landed on the most recent turn.
+    const std::vector<FleetState>& getLandedFleets() const {return m_landedFleets;}
+
+    //A 64-bit hash of the turn, the owners and ship counts of the planets, and the fleets in
+    //flight.  It's the sum of a hash of each of them, kept up to date in constant time as they
+    //change; a sum rather than an XOR so that two identical fleets don't cancel out.
+    quint64 getStateHash() const                {return m_stateHash + HashTurn(m_turn);}
+
+    //The state hash at the end of each turn of the current game, starting with the map.
+    const std::vector<quint64>& getTurnHashes() const {return m_turnHashes;}
+
+    //Replace a planet's part of the state hash; called by the planets themselves.
+    void updatePlanetHash(quint64 oldHash, quint64 newHash) {m_stateHash += newHash - oldHash;}
+
+    //Get the planets whose owner, ship count or properties changed on the most recent turn.
+    const std::vector<Planet*>& getChangedPlanets() const {return m_changedPlanets;}
+
+    //Record a change to a planet; called by the planets themselves.
+    void planetChanged(Planet* planet);
+
+    //Check one line of a player's output and stage the order in it; called by the players
+    //as soon as each line comes in.  Return false if the line is illegal.
+    bool stageOrder(Player* player, const std::string& line, int lineNumber);
+
     //Access to players.
-    Player* getFirstPlayer() const      { return m_firstPlayer;}
-    Player* getSecondPlayer() const     { return m_secondPlayer;}
-    Player* getNeutralPlayer() const    { return m_neutralPlayer;}
+    Player* getFirstPlayer() const      { return m_players[1];}
+    Player* getSecondPlayer() const     { return m_players[2];}
+    Player* getNeutralPlayer() const    { return m_players[0];}
     Player* getPlayer(int playerId) const;
+    int getNumPlayers() const           { return static_cast<int>(m_players.size()) - 1;}
 
     //Create a string representation of the game state given a player whose
-    //point of view should be used.
+    //point of view should be used.  With no player, the actual owner ids are used.
     std::string toString(Player* pov) const;
 
+    //Get the current game state, encoded once for the bots and any recorders until the state changes.
+    const GameStateMessage& encodeState();
+
+    //Get the changes made during the most recent turn, encoded the same way.
+    const GameStateMessage& encodeDelta();
+
+    //Copy the current game state.
+    GameSnapshot takeSnapshot() const;
+
+    //Get the changes made during the most recent turn.
+    GameDelta takeDelta() const;
+
+    //Where the bots may run and how much they may use; applied when the bots are started.
+    void setBotLimits(const BotLimits& limits)  {m_botLimits = limits;}
+    const BotLimits& getBotLimits() const       {return m_botLimits;}
+
+    //Rules for ending decided games early; checked at the end of every turn.
+    void setAdjudicationRules(const AdjudicationRules& rules)   {m_adjudicationRules = rules;}
+    const AdjudicationRules& getAdjudicationRules() const       {return m_adjudicationRules;}
+
 signals:
     //A signal that the game has been reset.
     void wasReset();
 
+    //Copies of the state for other threads: the whole state after a reset, and the
+    //changes at the end of every turn.  Only made if something is connected.
+    void wasResetTo(const GameSnapshot& state);
+    void turnEndedWith(const GameDelta& delta);
+
     //A signal that the game state has changed.
     void wasChanged();
 
-    //Log signals.
-    void logMessage(const std::string& message, QObject* sender);
-    void logError(const std::string& message, QObject* sender);
+    //Log signals.  The sender goes by its object name, since the receiver may be on another thread.
+    void logMessage(const std::string& message, const QString& sender);
+    void logError(const std::string& message, const QString& sender);
 
     //A signal that the turn has ended.
     void turnEnded();
 
+    //A signal that the game has been stopped, whether it's over or not.
+    void stopped();
+
 public slots:
+    //Show a game played elsewhere: replace the state of a game that isn't running
+    //here, or move it forward by one turn.  A state with owners that can't be players
+    //is turned down (logged, and false returned).
+    bool showSnapshot(const GameSnapshot& state);
+    void showDelta(const GameDelta& delta);
+
     void setMapFileName(QString mapFileName);
 
+    //Set the number of bots playing, from 2 to MAX_PLAYERS.  Takes effect on the next reset.
+    void setNumPlayers(int numPlayers);
+
+    //Set the file where every turn of the game gets recorded; empty for no replay.
+    void setReplayFileName(QString replayFileName);
+
     //Running the game.
     void reset();
     void step();
@@ -107,6 +305,7 @@ public slots:
     void setTurnLength(int turnLength)          {m_turnLength = turnLength;}
     void setFirstTurnLength(int firstTurnLength){m_firstTurnLength = firstTurnLength;}
     void setTimerIgnored(bool isTimerIgnored)   {m_isTimerIgnored = isTimerIgnored;}
+    void setCpuTimed(bool isCpuTimed)           {m_isCpuTimed = isCpuTimed;}
     void setMaxTurns(int maxTurns)              {m_maxTurns = maxTurns;}
     void setRenderDelay(int delayMs)            {m_renderDelay = delayMs;}
 
@@ -127,38 +326,110 @@ private:
     void logMessage(const std::string& message);
     void logError(const std::string& message);
 
-    //Process messages from a player.  Return false if player made illegal moves, true otherwise.
-    bool processOrders(const std::string& allOrders, Player* player);
+    //Check that a player finished the turn with legal orders, and set the planet properties
+    //it staged.  Return false if player made illegal moves or didn't finish the turn.
+    bool commitOrders(Player* player);
 
-    //Advance the game, growing fleets and fighting battles.
+    //Play out the turn by the rules: send out the fleets the players ordered, grow ships,
+    //move fleets along and fight battles.
     void advanceGame();
 
+    //Copy the planets and fleets onto the board the rules are played on.
+    void rebuildBoard();
+
     //Increment the current turn and send a notification.
     void incrementTurn();
 
+    //Replace all planets and fleets with the ones in the given state.
+    void loadSnapshot(const GameSnapshot& state);
+
+    //Append the current state to the replay file.
+    void recordReplayTurn();
+
+    //Start a new list of changed planets.
+    void clearChangedPlanets();
+
+    //Add a fleet to the game, or take one out, keeping the state hash up to date.
+    void addFleet(Fleet* fleet, int arrivalTurn);
+    void removeFleet(FleetList::iterator it);
+
+    //Find out whether the game is over, and who won.  Log the result if it's over.
+    bool checkGameOver();
+
+    //Find the player that has led by the adjudication ratios for long enough; 0 if there's none.
+    //Keeps count of the turns the current leader has been ahead.
+    int findDominantPlayer(const std::vector<int>& playerShips);
+
+    //Check whether a player without planets has no fleet that can take the planet it's headed
+    //for (see IsStranded()).
+    bool isStranded(int playerId);
+
+    //Check whether a bot has used up the CPU time of the turn, when turns are timed in CPU time.
+    bool isCpuBudgetSpent() const;
+
+    //Log the time and memory used by each bot, and how late the turn deadlines fired.
+    void reportPlayerStats();
+
     //Game objects.
-    Player* m_firstPlayer;
-    Player* m_secondPlayer;
-    Player* m_neutralPlayer;
+    std::vector<Player*> m_players;     //The neutral player, followed by the bots.
     std::vector<Planet*> m_planets;
     FleetList m_fleets;
     std::vector<Fleet*> m_newFleets;    //Fleets that appeared at last turn.
+    std::vector<FleetState> m_landedFleets; //Fleets that landed at last turn; they're gone.
+    std::vector<Planet*> m_changedPlanets;  //Planets that changed during the last turn.
+    std::vector<PropertyChange> m_changedProperties;
+    GameStateMessage m_stateMessage;
+    GameStateMessage m_deltaMessage;
+    bool m_isStateEncoded;                  //Whether m_stateMessage is up to date.
+    bool m_isDeltaEncoded;                  //Whether m_deltaMessage is up to date.
+    GameSnapshot m_board;                   //The planets and fleets as the rules see them.
+    bool m_isBoardCurrent;                  //Whether m_board matches the game objects.
+
+    //Working space of advanceGame(), kept between turns to save allocations.
+    std::vector<std::vector<StagedOrder> > m_turnOrders;
+    TurnEvents m_turnEvents;
+    std::vector<FleetList::iterator> m_fleetSlots;  //The fleets as the turn's events count them.
+
+    quint64 m_stateHash;                    //Without the turn; see getStateHash().
+    std::vector<quint64> m_turnHashes;
 
     //General game state.
     GameState m_state;
     int m_turn;
-    int m_winner;   //-1 = game not over; 0 = draw; 1 = player 1; 2 = player 2.
+    int m_winner;   //-1 = game not over; 0 = draw; n = player n.
+    Adjudication m_adjudication;
 
     std::string m_mapFileName;
+    std::string m_replayFileName;
+    std::ofstream m_replayFile;
 
     //Timer.
-    QTimer* m_timer;
+    DeadlineTimer* m_timer;
     int m_firstTurnLength;
     int m_turnLength;
     bool m_isTimerIgnored;
     int m_maxTurns;
+
+    //When turns are timed in CPU time, the timer only polls the bots' CPU usage.  A bot that
+    //sleeps or blocks is still cut off after CPU_WALL_FACTOR times the turn length.
+    static const int CPU_POLL_INTERVAL = 5;
+    static const int CPU_WALL_FACTOR = 10;
+    bool m_isCpuTimed;
+    QElapsedTimer m_turnClock;
+
+    //How late the turn deadlines of the current game fired.
+    int m_numDeadlines;
+    qint64 m_totalOvershootUs;
+    qint64 m_maxOvershootUs;
+
+    BotLimits m_botLimits;
     int m_renderDelay;
 
+    //Adjudication.
+    AdjudicationRules m_adjudicationRules;
+    int m_dominantPlayer;       //The player that has been ahead by the ratios, if any.
+    int m_numDominantTurns;     //For how many turns in a row.
+
     //Run state settings.
     RunningState m_runningState;
     QTimer* m_runTimer;
@@ -188,40 +459,24 @@ public:
     int getNumShips() const             { return m_numShips;}
     int getDistanceTo(Planet* planet) const;
 
-    //Advance a turn by growing new fleets on the planet.
-    void growFleets();
-
-    //Welcome (or fight) all fleets that arrived during this turn.
-    void welcomeArrivedFleets();
-
-    //Handle arrival of a fleet.
-    void landFleet(Fleet* fleet);
-    
-    //Manage externally-defined properties
-    std::string getProperty(const std::string& prop) {
-        if (m_properties.count(prop))
-            return m_properties[prop];
-        return std::string();
-    }
-    
-    //Manage externally-defined properties
-    void setProperty(const std::string& name, const std::string& val) {
-        m_properties[name] = val;
-    }
-    
-    std::vector<std::string> getPropNames() const {
-        std::vector<std::string> names;
-        typedef std::map<std::string, std::string>::const_iterator CI;
-        for (CI i = m_properties.begin(); i != m_properties.end(); ++i)
-            names.push_back(i->first);
-        return names;
-    }
+    //Bot-defined properties, by interned name id (see PropertyNames).  Setting a property
+    //to the value it already has changes nothing, and returns false.
+    bool setProperty(int nameId, const std::string& value);
+    const PlanetProperties& getProperties() const   { return m_properties;}
 
-signals:
-    void ownerSet(Player* owner);
-    void numShipsSet(int numShips);
+    //A counter that changes whenever any of the properties changes.
+    int getPropsVersion() const         { return m_propsVersion;}
+
+    //Forget that the planet has changed, to start tracking changes for a new turn.
+    void clearChanged()                 { m_isChanged = false;}
 
 private:
+    //Let the game know that this planet has changed during the current turn.
+    void markChanged();
+
+    //Move the planet's part of the game's state hash to a new owner and ship count.
+    void updateHash(Player* owner, int numShips);
+
     int m_id;
     Player* m_owner;
     double m_x;
@@ -230,8 +485,9 @@ private:
     int m_growthRate;
     PlanetWarsGame* m_game;
 
-    std::vector<Fleet*> m_landedFleets;
-    std::map<std::string, std::string> m_properties;
+    PlanetProperties m_properties;
+    int m_propsVersion;
+    bool m_isChanged;   //Whether the planet is already on the game's list of changed planets.
 };
 
 //A class representing a fleet.
@@ -248,7 +504,7 @@ public:
     void setSource(Planet* source)              { m_source = source;}
     void setDestination(Planet* destination)    { m_destination = destination;}
     void setTotalTripLength(int tripLength)     { m_totalTripLength = tripLength;}
-    void setTurnsRemaining(int turnsRemaining);
+    void setTurnsRemaining(int turnsRemaining)  { m_turnsRemaining = turnsRemaining;}
 
     Player* getOwner() const                    { return m_owner;}
     int getNumShips() const                     { return m_numShips;}
@@ -259,13 +515,15 @@ public:
     int getTotalTripLength() const              { return m_totalTripLength;}
     int getTurnsRemaining() const               { return m_turnsRemaining;}
 
-    //Move towards a planet.
-    void advance();
+    //Copy the fleet.
+    FleetState getState() const;
+
+    //The fleet's part of the game's state hash, worked out when it was added to the game.
+    void setStateHash(quint64 stateHash)        { m_stateHash = stateHash;}
+    quint64 getStateHash() const                { return m_stateHash;}
 
     //State of the fleet.
     bool hasArrived() const;
-    double getX() const         {return m_x;}
-    double getY() const         {return m_y;}
 
 private:
     Player* m_owner;
@@ -274,19 +532,12 @@ private:
     Planet* m_destination;
     int m_totalTripLength;
     int m_turnsRemaining;
+    quint64 m_stateHash;
 
     //These are temporary, to be used when the planet object was not built yet.
     //m_source and m_destination should be set before actually using this object.
     int m_sourceId;
     int m_destinationId;
-
-    double m_x;
-    double m_y;
-
-    double m_sourceX;
-    double m_sourceY;
-    double m_destinationX;
-    double m_destinationY;
 };
 
 //A class representing a player.
@@ -294,10 +545,19 @@ class Player : public QObject {
     Q_OBJECT
 
 public:
+    //Why a bot dropped out of a game.
+    enum Failure {
+        NO_FAILURE,
+        CRASHED,
+        TIMED_OUT,
+        ILLEGAL_ORDERS
+    };
+
     Player(QObject* parent);
     ~Player();
 
     void setId(int id)                      { m_id = id;}
+    void setGame(PlanetWarsGame* game)      { m_game = game;}
 
     int getId() const                       { return m_id;}
     std::string getLaunchCommand() const    { return m_launchCommand;}
@@ -311,14 +571,44 @@ public:
     //Check whether the process is running.
     bool isRunning() const;
 
-    //Read commands from the player process.
-    std::string readCommands();
+    //Forget the orders of the previous turn and start accepting new ones.
+    void beginTurn(int numPlanets);
+
+    //Stop the turn clocks and add the turn to the stats.  Done when "go" arrives,
+    //or at the end of the turn for bots that didn't finish.
+    void endTurn();
+
+    //CPU time used since the beginning of the turn; -1 if it can't be measured.
+    qint64 getTurnCpuMs() const;
+
+    //Time and memory used in the current game.
+    const PlayerStats& getStats() const     { return m_stats;}
+
+    //The reason the bot dropped out of the current game, if it did.
+    void setFailure(Failure failure)        { m_failure = failure;}
+    Failure getFailure() const              { return m_failure;}
+
+    //Orders checked and staged during the current turn.
+    void stageOrder(const StagedOrder& order);
+    void stageProperty(const PropertyChange& property);
+    const std::vector<StagedOrder>& getStagedOrders() const         { return m_stagedOrders;}
+    const std::vector<PropertyChange>& getStagedProperties() const  { return m_stagedProperties;}
+
+    //Hand over the staged orders, leaving none; the storage of the old list is kept.
+    void takeStagedOrders(std::vector<StagedOrder>* orders);
+
+    //Ships already ordered out of a planet during the current turn.
+    int getReservedShips(int planetId) const    { return m_reservedShips[planetId];}
 
     //Send updated map to the player process.
     void sendGameState(const std::string& gameState);
 
-    //Return player's POV from point of view of another player.
-    int povId(Player* player) const;
+    //Whether the bot has asked for the changes only instead of the full state (see GameStateMessage).
+    void setUsingDeltas(bool isUsingDeltas) { m_isUsingDeltas = isUsingDeltas;}
+    bool isUsingDeltas() const              { return m_isUsingDeltas;}
+
+    //Check whether anyone wants to see this player's messages of a given category.
+    bool isLogging(LogMask::Category category) const { return LogMask::isEnabled(m_id, category);}
 
     //Signal wrappers.
     void logMessage(const std::string& message);
@@ -327,8 +617,15 @@ public:
     void logStdIn(const std::string& message);
     void logStdOut(const std::string& message);
 
-    //Check whether the player is done the turn.
-    bool isDoneTurn();
+    //Check whether the player is done the turn: it has sent "go", or its orders were rejected.
+    bool isDoneTurn() const                 { return m_isDoneTurn;}
+
+    //Check whether the player has sent illegal orders or too much output this turn.
+    bool hasInvalidOrders() const           { return m_hasInvalidOrders;}
+
+    //Limits on what a bot may send in one turn, enforced as the output comes in.
+    static const int MAX_TURN_OUTPUT = 4 * 1024 * 1024;    //Bytes.
+    static const int MAX_TURN_ORDERS = 100000;
 
 public slots:
     //Set the shell command used to launch the AI bot.
@@ -344,23 +641,48 @@ public slots:
     void deleteProcess();
 
 signals:
-    //Log signals.
-    void logMessage(const std::string& message, QObject* sender);
-    void logError(const std::string& message, QObject* sender);
-    void logStdErr(const std::string& message, QObject* sender);
-    void logStdIn(const std::string& message, QObject* sender);
-    void logStdOut(const std::string& message, QObject* sender);
+    //Log signals (see PlanetWarsGame).
+    void logMessage(const std::string& message, const QString& sender);
+    void logError(const std::string& message, const QString& sender);
+    void logStdErr(const std::string& message, const QString& sender);
+    void logStdIn(const std::string& message, const QString& sender);
+    void logStdOut(const std::string& message, const QString& sender);
 
     void receivedStdOut();
+    void processFinished();
 
 private:
+    //Handle one complete line of the bot's output.
+    void processLine(const std::string& line);
+
+    //Reject the rest of the turn's output.
+    void rejectOrders(const std::string& message);
+
     int m_id;
     bool m_is_started;
     bool m_is_alive;
     std::string m_launchCommand; //The shell command used to launch the AI bot.
     QProcess* m_process;
-    std::string m_stdoutBuffer;   //A place for temporary storage of stdout output.
+    PlanetWarsGame* m_game;
+    std::string m_stdoutBuffer;   //The last, incomplete line of stdout output.
     bool m_isDoneTurn;
+    bool m_isUsingDeltas;
+    Failure m_failure;
+
+    //Orders of the current turn.
+    bool m_isInTurn;            //Whether the bot has been sent the state and may send orders.
+    bool m_hasInvalidOrders;
+    int m_numTurnLines;
+    int m_numTurnBytes;
+    std::vector<StagedOrder> m_stagedOrders;
+    std::vector<PropertyChange> m_stagedProperties;
+    std::vector<int> m_reservedShips;
+
+    //Time and memory accounting.
+    PlayerStats m_stats;
+    QElapsedTimer m_turnClock;
+    qint64 m_turnStartCpuMs;    //-1 if the CPU time can't be measured.
+    bool m_isTurnMeasured;      //Whether the current turn has been added to the stats.
 
     QTimer* m_processDeletionTimer; //A timer for scheduling QProcess object deletion.
 
@@ -4,55 +4,49 @@
 //This file contains graphics elements to be displayed on the game viewer.
 
 #include "graphics.h"
+#include <algorithm>
+#include <cmath>
 #include <sstream>
-#include <QLineF>
+#include <QFontMetricsF>
+#include <QPixmap>
+#include <QPixmapCache>
 #include <QPointF>
-#include <QPolygonF>
+#include <QStyleOptionGraphicsItem>
+#include <QTextDocument>
+#include <qmath.h>
 #include "game.h"
 
+namespace {
+
+//The property bots set to pick the colour of a planet.
+const int COLOR_PROPERTY = PropertyNames::intern("color");
+
+}
+
 /*===================================================
                 Class PlanetWarsView.
 ====================================================*/
 PlanetWarsView::PlanetWarsView(QObject *parent)
     :QGraphicsScene(parent) {
 
-    const qreal scalingFactor = 22;
-
     //Set up the palette.
     m_settings = new GraphicsSettings(this);
-    m_settings->backgroundColor.setRgb(0, 0, 0); //Black.
-    m_settings->firstPlayerColor.setRgb(219, 80, 80); //Red-ish.
-    m_settings->secondPlayerColor.setRgb(97, 191, 242); //Darker dirty cyan.
-//    m_settings->secondPlayerColor.setRgb(26, 130, 186); //Darker dirty cyan.
-    m_settings->neutralColor.setRgb(80,80,80);   //Grey.
-    m_settings->textColor.setRgb(255, 255, 255); //White.
-
-    m_settings->planetPen.setWidth(0.03 * scalingFactor);
-
-    m_settings->planetFleetFont.setPointSizeF(0.4 * scalingFactor);
-    m_settings->planetFleetFont.setFamily("Arial");
-    //m_settings->planetFleetFont.setLetterSpacing(QFont::AbsoluteSpacing,
-    //                                             -0.5 * scalingFactor);
 
-    //Planet id settings.
-    m_settings->planetIdColor.setRgb(0, 180, 0); //Green
-    m_settings->planetIdFont.setFamily("Arial");
-    m_settings->planetIdFont.setPointSizeF(0.3 * scalingFactor);;
+    //Set up the graphics scene.
+    this->setBackgroundBrush(m_settings->backgroundColor);
 
-    //Fleet settings.
-    m_settings->fleetFont.setPointSizeF(0.35 * scalingFactor);
-    m_settings->fleetFont.setFamily("Arial");
-    m_settings->firstPlayerFleetColor.setRgb(190, 0, 0);
-    m_settings->secondPlayerFleetColor.setRgb(0, 95, 163);
-    m_settings->firstPlayerFleetPen.setColor(m_settings->firstPlayerFleetColor);
-    m_settings->firstPlayerFleetPen.setWidthF(0.5);
-    m_settings->secondPlayerFleetPen.setColor(m_settings->secondPlayerFleetColor);
-    m_settings->secondPlayerFleetPen.setWidthF(0.5);
+    m_fleetLayer = new FleetLayer();
+    m_fleetLayer->setSettings(m_settings);
+    m_fleetLayer->setZValue(1);
+    this->addItem(m_fleetLayer);
 
-    m_settings->scalingFactor = scalingFactor;
+    //Set up the animation clock.
+    m_animationMs = MAX_ANIMATION_MS;
+    m_frameTimer = new QTimer(this);
+    m_frameTimer->setInterval(1000 / FRAMES_PER_SECOND);
+    QObject::connect(m_frameTimer, SIGNAL(timeout()), this, SLOT(advanceAnimation()));
 
-    //Set up the graphics scene.
-    this->setBackgroundBrush(m_settings->backgroundColor);
+    m_mapArea = 0;
     m_showGrowthRates = true;
     m_showPlanetIds = true;
     m_showPlanetProps = true;
@@ -60,12 +54,13 @@ PlanetWarsView::PlanetWarsView(QObject *parent)
 
 void PlanetWarsView::setGame(PlanetWarsGame *game) {
     m_game = game;
+    m_fleetLayer->setGame(game);
 
     QObject::connect(m_game, SIGNAL(turnEnded()), this, SLOT(redraw()));
 }
 
 void PlanetWarsView::reset() {
-    //Remove old planet and fleet views.
+    //Remove old planet views.
     const int numOldPlanets = static_cast<int>(m_planetViews.size());
 
     for (int i = 0; i < numOldPlanets; ++i) {
@@ -74,18 +69,12 @@ void PlanetWarsView::reset() {
         delete planetView;
     }
 
-    for (FleetViewList::iterator it = m_fleetViews.begin(); it != m_fleetViews.end(); ++it) {
-        FleetView* fleetView = *it;
-        this->removeItem(fleetView);
-        delete fleetView;
-    }
-
     m_planetViews.clear();
-    m_fleetViews.clear();
 
     //Create the planet views.
-    std::vector<Planet*> planets(m_game->getPlanets());
+    const std::vector<Planet*>& planets = m_game->getPlanets();
     const int numPlanets = static_cast<int>(planets.size());
+    QRectF mapBounds;
 
     for (int i = 0; i < numPlanets; ++i) {
         PlanetView* planetView = new PlanetView();
@@ -95,281 +84,760 @@ void PlanetWarsView::reset() {
 
         this->addItem(planetView);
         m_planetViews.push_back(planetView);
-    }
 
-    //Create fleet views.
-    FleetList fleets = m_game->getFleets();
+        mapBounds |= planetView->sceneBoundingRect();
+    }
 
-    for (FleetList::iterator it = fleets.begin(); it != fleets.end(); ++it) {
-        Fleet* fleet = (*it);
-        FleetView* fleetView = new FleetView();
-        fleetView->setSettings(m_settings);
-        fleetView->setPlanetWarsView(this);
-        fleetView->setFleet(fleet);
+    //Fleets always travel between planets, so they stay within the map.
+    const qreal fleetMargin = 1 * m_settings->scalingFactor;
+    m_fleetLayer->setBounds(mapBounds.adjusted(-fleetMargin, -fleetMargin, fleetMargin, fleetMargin));
+    m_mapArea = m_fleetLayer->boundingRect().width() * m_fleetLayer->boundingRect().height();
 
-        this->addItem(fleetView);
-        m_fleetViews.push_back(fleetView);
-    }
+    //Show the fleets from the map where they are; there's no previous turn to move from.
+    m_frameTimer->stop();
+    m_turnClock.invalidate();
+    m_fleetLayer->invalidateFleets();
+    m_fleetLayer->setProgress(1);
 
     this->update();
 }
 
 void PlanetWarsView::redraw() {
-    //Add any new fleets and invalidate the whole thing.
-    std::vector<Fleet*> newFleets = m_game->getNewFleets();
-    const int numNewFleets = static_cast<int>(newFleets.size());
+    //Spread the fleet movement over the time the last turn took, so that the fleets
+    //keep moving until about when the next turn arrives.
+    if (m_turnClock.isValid()) {
+        m_animationMs = qMin(m_turnClock.restart(), static_cast<qint64>(MAX_ANIMATION_MS));
 
-    for (int i = 0; i < numNewFleets; ++i) {
-        Fleet* fleet = newFleets[i];
+    } else {
+        m_turnClock.start();
+        m_animationMs = MAX_ANIMATION_MS;
+    }
 
-        FleetView* fleetView =  new FleetView();
-        fleetView->setSettings(m_settings);
-        fleetView->setPlanetWarsView(this);
-        fleetView->setFleet(fleet);
+    m_fleetLayer->setProgress(0);
+    m_frameTimer->start();
 
-        const qreal scalingFactor = m_settings->scalingFactor;
-        fleetView->setPos(scalingFactor * fleet->getX(), scalingFactor * fleet->getY());
+    //Repaint only what has changed during the turn.
+    qreal invalidatedArea = 0;
+    const std::vector<Planet*>& changedPlanets = m_game->getChangedPlanets();
+    const int numChangedPlanets = static_cast<int>(changedPlanets.size());
 
-        this->addItem(fleetView);
-        //this->addItem(fleetView->getArrow());
-        m_fleetViews.push_back(fleetView);
+    for (int i = 0; i < numChangedPlanets; ++i) {
+        invalidatedArea += m_planetViews[changedPlanets[i]->getId()]->refresh();
     }
 
-    this->update();
+    invalidatedArea += m_fleetLayer->invalidateFleets();
+
+    emit turnRepainted(invalidatedArea, m_mapArea);
 }
 
-void PlanetWarsView::removeFleetView(FleetView *fleetView) {
-    m_fleetViews.remove(fleetView);
-    this->removeItem(fleetView);
-    delete fleetView;
+void PlanetWarsView::advanceAnimation() {
+    qreal progress = 1;
+
+    if (m_animationMs > 0) {
+        progress = static_cast<qreal>(m_turnClock.elapsed()) / m_animationMs;
+    }
+
+    if (progress >= 1) {
+        progress = 1;
+        m_frameTimer->stop();
+    }
+
+    m_fleetLayer->setProgress(progress);
 }
 
 void PlanetWarsView::setShowGrowthRates(bool showGrowthRates) {
     m_showGrowthRates = showGrowthRates;
-    this->update();
+    this->refreshPlanets();
 }
 
 void PlanetWarsView::setShowPlanetIds(bool showPlanetIds) {
     m_showPlanetIds = showPlanetIds;
     m_showPlanetProps = showPlanetIds;
-    this->update();
+    this->refreshPlanets();
+}
+
+void PlanetWarsView::refreshPlanets() {
+    const int numPlanets = static_cast<int>(m_planetViews.size());
+
+    for (int i = 0; i < numPlanets; ++i) {
+        m_planetViews[i]->refresh();
+    }
 }
 
 /*===================================================
                 Class PlanetView.
 ====================================================*/
-PlanetView::PlanetView() {
+PlanetView::PlanetView()
+    :m_shownOwnerId(-1), m_shownNumShips(-1), m_shownGrowthRate(false), m_shownPropsVersion(-1),
+    m_colorPropsVersion(-1) {
+    m_numShipsText.setPerformanceHint(QStaticText::AggressiveCaching);
+    m_planetIdText.setPerformanceHint(QStaticText::AggressiveCaching);
+    m_propsText.setTextFormat(Qt::RichText);
 }
 
 void PlanetView::setPlanet(Planet *planet) {
     m_planet = planet;
 
     //Set the radius.
-    const qreal growthRate = static_cast<qreal>(planet->getGrowthRate());
-    m_radius = 0.6 + growthRate / 8;
-    m_radius *= m_settings->scalingFactor;
+    m_radius = m_settings->planetRadius(planet->getGrowthRate());
 
     //Set the position.
     const qreal x = m_planet->getX() * m_settings->scalingFactor;
     const qreal y = m_planet->getY() * m_settings->scalingFactor;
     this->setPos(x, y);
+
+    //The id never changes.
+    m_planetIdText.setText(QString::number(m_planet->getId()));
+    m_planetIdText.prepare(QTransform(), m_settings->planetIdFont);
+
+    this->prepareGeometryChange();
+    m_bounds = this->discRect();
 }
 
 QRectF PlanetView::boundingRect() const {
+    return m_bounds;
+}
+
+QRectF PlanetView::discRect() const {
     const qreal outerPlanetRadius = m_radius + m_settings->planetPen.widthF();
     QRectF rect(-outerPlanetRadius, -outerPlanetRadius, outerPlanetRadius*2, outerPlanetRadius*2);
     return rect;
 }
 
-void PlanetView::paint(QPainter *painter, const QStyleOptionGraphicsItem *option, QWidget *widget) {
-    //Turn on anti-aliasing.
-    painter->setRenderHint(QPainter::Antialiasing, true);
-
-    //Draw the planet.
-    painter->setPen(m_settings->planetPen);
-    const int ownerId = m_planet->getOwner()->getId();
-
-    if (1 ==  ownerId) {
-        painter->setBrush(m_settings->firstPlayerColor);
+qreal PlanetView::refresh() {
+    this->updateLabels(true);
 
-    } else if (2 ==  ownerId) {
-        painter->setBrush(m_settings->secondPlayerColor);
+    //The property text may stick out of the planet.
+    QRectF bounds = this->discRect();
 
-    } else {
-        painter->setBrush(m_settings->neutralColor);
+    if (m_planetWarsView->getShowPlanetProps() && !m_propsText.text().isEmpty()) {
+        bounds |= QRectF(m_propsPosition, m_propsText.size());
     }
 
-    std::string val;
-    if ((val = m_planet->getProperty("color")).size()) {
-        painter->setBrush(QBrush(QColor(val.c_str())));
+    if (bounds != m_bounds) {
+        this->prepareGeometryChange();
+        m_bounds = bounds;
     }
 
-    QPointF center(0, 0);
+    this->update();
+    return m_bounds.width() * m_bounds.height();
+}
 
-    painter->drawEllipse(center, m_radius, m_radius);
+void PlanetView::paint(QPainter *painter, const QStyleOptionGraphicsItem *option, QWidget *widget) {
+    const qreal levelOfDetail = option->levelOfDetailFromTransform(painter->worldTransform());
 
-    //Draw the number of ships on the planet.
-    std::stringstream streamNumShips;
-    streamNumShips << m_planet->getNumShips();
+    //When zoomed far out, the planet is just a colored dot; text would be sub-pixel anyway.
+    if (levelOfDetail < GraphicsSettings::POINT_DETAIL) {
+        this->updateLabels(false);
 
-    if (m_planetWarsView->getShowGrowthRates()) {
-        //If requested, draw the growth rate as well.
-        const int growthRate = m_planet->getGrowthRate();
+        const qreal size = qMin(m_radius * 2, qMax(m_radius, GraphicsSettings::POINT_SIZE / levelOfDetail));
+        painter->fillRect(QRectF(-size / 2, -size / 2, size, size), m_color);
+        return;
+    }
 
-        if (0 == growthRate) {
-            streamNumShips << "x";
+    this->updateLabels(true);
 
-        } else {
-            streamNumShips << "+" << m_planet->getGrowthRate();
-        }
-    }
+    //Draw the planet.
+    this->drawDisc(painter, m_color);
 
-    QString numShipsText(streamNumShips.str().c_str());
+    //Draw the number of ships on the planet.
+    const QRectF bounds = this->discRect();
+    const QSizeF numShipsSize = m_numShipsText.size();
 
     painter->setPen(m_settings->textColor);
     painter->setFont(m_settings->planetFleetFont);
-    painter->drawText(this->boundingRect(), Qt::AlignHCenter|Qt::AlignVCenter, numShipsText);
+    painter->drawStaticText(QPointF(-numShipsSize.width() / 2, -numShipsSize.height() / 2), m_numShipsText);
 
     //If requested, draw the planet IDs.
     if(m_planetWarsView->getShowPlanetIds()) {
-        std::stringstream streamPlanetId;
-        streamPlanetId << m_planet->getId();
-
-        QString qPlanetId(streamPlanetId.str().c_str());
-
         painter->setPen(m_settings->planetIdColor);
         painter->setFont(m_settings->planetIdFont);
-        painter->drawText(this->boundingRect(), Qt::AlignLeft|Qt::AlignTop, qPlanetId);
+        painter->drawStaticText(bounds.topLeft(), m_planetIdText);
     }
 
     //If requested, draw additional planet property data.
-    if (m_planetWarsView->getShowPlanetProps()) {
-        std::stringstream streamPlanetProps;
-        std::vector<std::string> propNames = m_planet->getPropNames();
-        if (propNames.size()) {
-            for (uint i = 0; i < propNames.size(); ++i) {
-                streamPlanetProps << propNames[i] << ": " 
-                    << m_planet->getProperty(propNames[i]) << endl;
-            }
+    if (m_planetWarsView->getShowPlanetProps() && !m_propsText.text().isEmpty()) {
+        painter->setPen(QColor("white"));
+        painter->setFont(m_settings->fleetFont);
+        painter->drawStaticText(m_propsPosition, m_propsText);
+    }
+}
+
+void PlanetView::updateLabels(bool includeText) {
+    const int ownerId = m_planet->getOwner()->getId();
+    const int numShips = m_planet->getNumShips();
+    const bool showGrowthRate = m_planetWarsView->getShowGrowthRates();
+    const int propsVersion = m_planet->getPropsVersion();
+
+    if (ownerId != m_shownOwnerId || propsVersion != m_colorPropsVersion) {
+        const std::string* colorProperty = m_planet->getProperties().find(COLOR_PROPERTY);
+        m_color = m_settings->planetColor(ownerId, (NULL != colorProperty) ? *colorProperty : std::string());
+        m_shownOwnerId = ownerId;
+        m_colorPropsVersion = propsVersion;
+    }
+
+    if (!includeText) {
+        return;
+    }
+
+    if (numShips != m_shownNumShips || showGrowthRate != m_shownGrowthRate) {
+        //If requested, show the growth rate as well.
+        m_numShipsText.setText(GraphicsSettings::planetLabel(numShips, m_planet->getGrowthRate(), showGrowthRate));
+        m_numShipsText.prepare(QTransform(), m_settings->planetFleetFont);
+
+        m_shownNumShips = numShips;
+        m_shownGrowthRate = showGrowthRate;
+    }
 
-            QString qPlanetProps(streamPlanetProps.str().c_str());
+    if (propsVersion != m_shownPropsVersion) {
+        QString props;
+        const PlanetProperties& properties = m_planet->getProperties();
 
-            painter->setPen(QColor("white"));
-            painter->setFont(m_settings->fleetFont);
-            painter->drawText(center + QPoint(8, -24), qPlanetProps);
+        for (int i = 0; i < properties.size(); ++i) {
+            if (i > 0) {
+                props.append("<br>");
+            }
+
+            QString line = QString("%1: %2")
+                           .arg(PropertyNames::getName(properties.getNameId(i)).c_str())
+                           .arg(properties.getValue(i).c_str());
+            props.append(Qt::escape(line));
         }
+
+        m_propsText.setText(props);
+        m_propsText.prepare(QTransform(), m_settings->fleetFont);
+        m_propsPosition = m_settings->propsPosition();
+
+        m_shownPropsVersion = propsVersion;
+    }
+}
+
+void PlanetView::drawDisc(QPainter *painter, const QColor &color) {
+    const QRectF bounds = this->discRect();
+    const qreal scale = QStyleOptionGraphicsItem::levelOfDetailFromTransform(painter->worldTransform());
+    const int pixelSize = qCeil(bounds.width() * scale);
+
+    if (pixelSize <= 0 || pixelSize > MAX_CACHED_DISC_SIZE) {
+        painter->setRenderHint(QPainter::Antialiasing, true);
+        painter->setPen(m_settings->planetPen);
+        painter->setBrush(color);
+        painter->drawEllipse(QPointF(0, 0), m_radius, m_radius);
+        return;
     }
 
+    //Discs depend only on the color and the on-screen size, so planets can share them.
+    const QString key = QString("planet:%1:%2:%3").arg(color.rgba()).arg(pixelSize).arg(m_radius);
+    QPixmap disc;
+
+    if (!QPixmapCache::find(key, &disc)) {
+        disc = QPixmap(pixelSize, pixelSize);
+        disc.fill(Qt::transparent);
+
+        QPainter discPainter(&disc);
+        discPainter.setRenderHint(QPainter::Antialiasing, true);
+        discPainter.scale(pixelSize / bounds.width(), pixelSize / bounds.height());
+        discPainter.translate(-bounds.topLeft());
+        discPainter.setPen(m_settings->planetPen);
+        discPainter.setBrush(color);
+        discPainter.drawEllipse(QPointF(0, 0), m_radius, m_radius);
+        discPainter.end();
+
+        QPixmapCache::insert(key, disc);
+    }
+
+    painter->drawPixmap(bounds, disc, QRectF(disc.rect()));
 }
 
 /*===================================================
-                Class FleetView.
+                Class FleetLayer.
 ====================================================*/
-FleetView::FleetView()
-    :m_arrow(NULL) {
-    m_connector = new FleetConnector(this);
+FleetLayer::FleetLayer()
+    :m_game(NULL), m_settings(NULL), m_progress(1), m_levelOfDetail(1), m_arrow(4) {
+}
+
+void FleetLayer::setBounds(const QRectF &bounds) {
+    this->prepareGeometryChange();
+    m_bounds = bounds;
+}
+
+void FleetLayer::setProgress(qreal progress) {
+    m_progress = progress;
+
+    //Lanes span whole trips, so there's no point tracking them piece by piece.
+    if (m_levelOfDetail < GraphicsSettings::LANE_DETAIL) {
+        this->update();
+        return;
+    }
+
+    const int numRects = static_cast<int>(m_currentRects.size());
+
+    for (int i = 0; i < numRects; ++i) {
+        this->update(m_currentRects[i]);
+    }
+}
+
+qreal FleetLayer::invalidateFleets() {
+    //Fleets that landed are still drawn where they were on the previous turn.
+    m_previousRects.swap(m_currentRects);
+    m_currentRects.clear();
+
+    if (NULL == m_game) {
+        return 0;
+    }
+
+    //Each fleet will move along its trip from its previous position to its current one.
+    const qreal margin = 1 * m_settings->scalingFactor;
+    const FleetList& fleets = m_game->getFleets();
+
+    for (FleetList::const_iterator it = fleets.begin(); it != fleets.end(); ++it) {
+        const Fleet* fleet = *it;
+        const QPointF source(fleet->getSource()->getX(), fleet->getSource()->getY());
+        const QPointF destination(fleet->getDestination()->getX(), fleet->getDestination()->getY());
+        const int totalTripLength = fleet->getTotalTripLength();
+        const int turnsRemaining = fleet->getTurnsRemaining();
+
+        const QPointF from = m_settings->fleetPosition(source, destination, totalTripLength, turnsRemaining, 0);
+        const QPointF to = m_settings->fleetPosition(source, destination, totalTripLength, turnsRemaining, 1);
+        m_currentRects.push_back(QRectF(from, to).normalized().adjusted(-margin, -margin, margin, margin));
+    }
+
+    if (m_levelOfDetail < GraphicsSettings::LANE_DETAIL) {
+        this->update();
+        return m_bounds.width() * m_bounds.height();
+    }
+
+    qreal area = 0;
+
+    for (size_t i = 0; i < m_previousRects.size(); ++i) {
+        this->update(m_previousRects[i]);
+        area += m_previousRects[i].width() * m_previousRects[i].height();
+    }
+
+    for (size_t i = 0; i < m_currentRects.size(); ++i) {
+        this->update(m_currentRects[i]);
+        area += m_currentRects[i].width() * m_currentRects[i].height();
+    }
+
+    return area;
+}
 
+QRectF FleetLayer::boundingRect() const {
+    return m_bounds;
 }
 
-FleetView::~FleetView() {
-    delete m_connector;
-    delete m_arrow;
+void FleetLayer::paint(QPainter *painter, const QStyleOptionGraphicsItem *option, QWidget *widget) {
+    if (NULL == m_game) {
+        return;
+    }
+
+    //When zoomed out, individual fleets are too small to tell apart.
+    const qreal levelOfDetail = option->levelOfDetailFromTransform(painter->worldTransform());
+    m_levelOfDetail = levelOfDetail;
+
+    if (levelOfDetail < GraphicsSettings::LANE_DETAIL) {
+        this->paintLanes(painter, levelOfDetail);
+        return;
+    }
+
+    painter->setFont(m_settings->fleetFont);
+    int lastOwnerId = -1;
+
+    const FleetList& fleets = m_game->getFleets();
+
+    for (FleetList::const_iterator it = fleets.begin(); it != fleets.end(); ++it) {
+        const Fleet* fleet = *it;
+
+        //Switch colors only when the owner changes.
+        const int ownerId = fleet->getOwner()->getId();
+
+        if (ownerId != lastOwnerId) {
+            painter->setPen(m_settings->fleetPen(ownerId));
+            painter->setBrush(m_settings->fleetColor(ownerId));
+            lastOwnerId = ownerId;
+        }
+
+        //Find where the fleet is between the turn it was at and the turn it is at now.
+        const QPointF source(fleet->getSource()->getX(), fleet->getSource()->getY());
+        const QPointF destination(fleet->getDestination()->getX(), fleet->getDestination()->getY());
+        const QPointF position = m_settings->fleetPosition(source, destination, fleet->getTotalTripLength(),
+                                                           fleet->getTurnsRemaining(), m_progress);
+        const qreal x = position.x();
+        const qreal y = position.y();
+
+        m_settings->placeFleetArrow(&m_arrow, position, source, destination);
+        painter->drawPolygon(m_arrow);
+
+        //Draw the number of ships, centered on the fleet position.
+        const QStaticText& numShips = this->label(fleet->getNumShips());
+        const QSizeF textSize = numShips.size();
+        painter->drawStaticText(QPointF(x - textSize.width() / 2, y - textSize.height() / 2), numShips);
+    }
 }
 
-void FleetView::setFleet(Fleet* fleet) {
-    m_fleet = fleet;
-    m_connector->setFleet(fleet);
+void FleetLayer::paintLanes(QPainter *painter, qreal levelOfDetail) {
+    //Group the fleets by owner, source and destination.  The lane list keeps its
+    //capacity between frames, so this doesn't allocate once it has grown.
+    m_lanes.clear();
+    const FleetList& fleets = m_game->getFleets();
+
+    for (FleetList::const_iterator it = fleets.begin(); it != fleets.end(); ++it) {
+        const Fleet* fleet = *it;
+
+        FleetLane lane;
+        lane.key = (static_cast<quint64>(fleet->getOwner()->getId()) << 48)
+                   | (static_cast<quint64>(fleet->getSource()->getId() & 0xffffff) << 24)
+                   | static_cast<quint64>(fleet->getDestination()->getId() & 0xffffff);
+        lane.numShips = fleet->getNumShips();
+        lane.fleet = fleet;
+        m_lanes.push_back(lane);
+    }
+
+    std::sort(m_lanes.begin(), m_lanes.end());
 
-    //Set up the arrow.
     const qreal scalingFactor = m_settings->scalingFactor;
-    m_arrow = new QGraphicsPolygonItem(this);
+    const bool showLabels = (levelOfDetail >= GraphicsSettings::POINT_DETAIL);
+    const int numFleets = static_cast<int>(m_lanes.size());
+    int lastOwnerId = -1;
 
-    QPolygonF arrowPolygon;
-    arrowPolygon << QPointF(0.5 * scalingFactor, 0)
+    painter->setFont(m_settings->fleetFont);
+
+    for (int i = 0; i < numFleets; ) {
+        //Sum up the ships on the lane.
+        const FleetLane& lane = m_lanes[i];
+        int numShips = 0;
+
+        for (; i < numFleets && m_lanes[i].key == lane.key; ++i) {
+            numShips += m_lanes[i].numShips;
+        }
+
+        const Fleet* fleet = lane.fleet;
+        const int ownerId = fleet->getOwner()->getId();
+
+        if (ownerId != lastOwnerId) {
+            painter->setPen(QPen(m_settings->fleetColor(ownerId), 0));
+            lastOwnerId = ownerId;
+        }
+
+        //Draw the lane as a line from the source to the destination.
+        const QPointF source(fleet->getSource()->getX() * scalingFactor, fleet->getSource()->getY() * scalingFactor);
+        const QPointF destination(fleet->getDestination()->getX() * scalingFactor,
+                                  fleet->getDestination()->getY() * scalingFactor);
+        painter->drawLine(source, destination);
+
+        if (showLabels) {
+            //Keep the label readable regardless of the zoom.
+            const QStaticText& text = this->label(numShips);
+            const QSizeF textSize = text.size();
+            const QPointF middle = (source + destination) / 2;
+
+            painter->save();
+            painter->translate(middle);
+            painter->scale(1 / levelOfDetail, 1 / levelOfDetail);
+            painter->drawStaticText(QPointF(-textSize.width() / 2, -textSize.height() / 2), text);
+            painter->restore();
+        }
+    }
+}
+
+const QStaticText& FleetLayer::label(int numShips) {
+    QHash<int, QStaticText>::iterator it = m_labels.find(numShips);
+
+    if (it != m_labels.end()) {
+        return it.value();
+    }
+
+    if (m_labels.size() >= MAX_CACHED_LABELS) {
+        m_labels.clear();
+    }
+
+    QStaticText text(QString::number(numShips));
+    text.setPerformanceHint(QStaticText::AggressiveCaching);
+    text.prepare(QTransform(), m_settings->fleetFont);
+    return m_labels.insert(numShips, text).value();
+}
+
+/*===================================================
+              Class GraphicsSettings.
+====================================================*/
+const qreal GraphicsSettings::LANE_DETAIL = 0.4;
+const qreal GraphicsSettings::POINT_DETAIL = 0.15;
+const qreal GraphicsSettings::POINT_SIZE = 2;
+
+GraphicsSettings::GraphicsSettings(QObject* parent)
+    :QObject(parent) {
+
+    const qreal scalingFactor = 22;
+
+    backgroundColor.setRgb(0, 0, 0); //Black.
+    firstPlayerColor.setRgb(219, 80, 80); //Red-ish.
+    secondPlayerColor.setRgb(97, 191, 242); //Darker dirty cyan.
+//    secondPlayerColor.setRgb(26, 130, 186); //Darker dirty cyan.
+    neutralColor.setRgb(80,80,80);   //Grey.
+    textColor.setRgb(255, 255, 255); //White.
+
+    planetPen.setWidth(0.03 * scalingFactor);
+
+    planetFleetFont.setPointSizeF(0.4 * scalingFactor);
+    planetFleetFont.setFamily("Arial");
+    //planetFleetFont.setLetterSpacing(QFont::AbsoluteSpacing,
+    //                                 -0.5 * scalingFactor);
+
+    //Planet id settings.
+    planetIdColor.setRgb(0, 180, 0); //Green
+    planetIdFont.setFamily("Arial");
+    planetIdFont.setPointSizeF(0.3 * scalingFactor);
+
+    //Fleet settings.
+    fleetFont.setPointSizeF(0.35 * scalingFactor);
+    fleetFont.setFamily("Arial");
+    firstPlayerFleetColor.setRgb(190, 0, 0);
+    secondPlayerFleetColor.setRgb(0, 95, 163);
+    firstPlayerFleetPen.setColor(firstPlayerFleetColor);
+    firstPlayerFleetPen.setWidthF(0.5);
+    secondPlayerFleetPen.setColor(secondPlayerFleetColor);
+    secondPlayerFleetPen.setWidthF(0.5);
+
+    //Colors for the extra players in free-for-all games.
+    otherPlayerColors.push_back(QColor(120, 200, 80));  //Green.
+    otherPlayerColors.push_back(QColor(230, 200, 60));  //Yellow.
+    otherPlayerColors.push_back(QColor(170, 110, 220)); //Purple.
+    otherPlayerColors.push_back(QColor(240, 150, 50));  //Orange.
+    otherPlayerColors.push_back(QColor(240, 120, 190)); //Pink.
+    otherPlayerColors.push_back(QColor(60, 200, 170));  //Teal.
+
+    for (size_t i = 0; i < otherPlayerColors.size(); ++i) {
+        otherPlayerFleetColors.push_back(otherPlayerColors[i].darker(150));
+        otherPlayerFleetPens.push_back(QPen(otherPlayerFleetColors[i], 0.5));
+    }
+
+    fleetArrow << QPointF(0.5 * scalingFactor, 0)
             << QPointF(0.4 * scalingFactor, 0.2 * scalingFactor)
             << QPointF(0.9 * scalingFactor, 0)
             << QPointF(0.4 * scalingFactor, -0.2 * scalingFactor);
 
-    m_arrow->setPolygon(arrowPolygon);
+    this->scalingFactor = scalingFactor;
+}
+
+qreal GraphicsSettings::planetRadius(int growthRate) const {
+    return (0.6 + static_cast<qreal>(growthRate) / 8) * scalingFactor;
+}
+
+QColor GraphicsSettings::planetColor(int ownerId, const std::string& colorProperty) const {
+    if (!colorProperty.empty()) {
+        return QColor(colorProperty.c_str());
+    }
+
+    if (1 == ownerId) {
+        return firstPlayerColor;
+
+    } else if (2 == ownerId) {
+        return secondPlayerColor;
 
-    //Set the arrow pen and color.
-    if (m_fleet->getOwner()->getId() == 1) {
-        m_arrow->setBrush(m_settings->firstPlayerFleetColor);
-        m_arrow->setPen(m_settings->firstPlayerFleetPen);
+    } else if (ownerId > 2 && ownerId - 3 < static_cast<int>(otherPlayerColors.size())) {
+        return otherPlayerColors[ownerId - 3];
 
     } else {
-        m_arrow->setBrush(m_settings->secondPlayerFleetColor);
-        m_arrow->setPen(m_settings->secondPlayerFleetPen);
+        return neutralColor;
     }
+}
 
-    //Set the arrow angle.
-    const qreal sourceX = fleet->getSource()->getX();
-    const qreal sourceY = fleet->getSource()->getY();
-    const qreal destinationX = fleet->getDestination()->getX();
-    const qreal destinationY = fleet->getDestination()->getY();
+QString GraphicsSettings::planetLabel(int numShips, int growthRate, bool showGrowthRate) {
+    std::stringstream streamNumShips;
+    streamNumShips << numShips;
 
-    QLineF trip(sourceX, sourceY, destinationX, destinationY);
-    m_arrow->setRotation(-trip.angle());
+    if (showGrowthRate) {
+        if (0 == growthRate) {
+            streamNumShips << "x";
 
+        } else {
+            streamNumShips << "+" << growthRate;
+        }
+    }
+
+    return QString(streamNumShips.str().c_str());
 }
 
-QRectF FleetView::boundingRect() const {
-    //return bounding rect.
-    const qreal baseRadius = 1 * m_settings->scalingFactor;
-    QRectF rect(-baseRadius, -baseRadius, baseRadius*2, baseRadius*2);
-    return rect;
+QPointF GraphicsSettings::propsPosition() const {
+    //The text sits on a baseline at (8, -24) relative to the planet center.
+    QFontMetricsF metrics(fleetFont);
+    return QPointF(8, -24 - metrics.ascent());
 }
 
-void FleetView::paint(QPainter *painter, const QStyleOptionGraphicsItem *option, QWidget *widget) {
-    const qreal scalingFactor = m_settings->scalingFactor;
+const QPen& GraphicsSettings::fleetPen(int ownerId) const {
+    if (ownerId > 2 && ownerId - 3 < static_cast<int>(otherPlayerFleetPens.size())) {
+        return otherPlayerFleetPens[ownerId - 3];
+    }
 
-    //Set the fleet position.
-    const qreal x = static_cast<qreal>(m_fleet->getX()) * m_settings->scalingFactor;
-    const qreal y = static_cast<qreal>(m_fleet->getY()) * m_settings->scalingFactor;
+    return (1 == ownerId) ? firstPlayerFleetPen : secondPlayerFleetPen;
+}
 
-    this->setPos(x, y);
+const QColor& GraphicsSettings::fleetColor(int ownerId) const {
+    if (ownerId > 2 && ownerId - 3 < static_cast<int>(otherPlayerFleetColors.size())) {
+        return otherPlayerFleetColors[ownerId - 3];
+    }
 
-    //Draw the number of ships
-    std::stringstream sNumShips;
-    sNumShips << m_fleet->getNumShips();
-    QString qNumShips(sNumShips.str().c_str());
+    return (1 == ownerId) ? firstPlayerFleetColor : secondPlayerFleetColor;
+}
 
-    QColor fleetColor = m_fleet->getOwner()->getId() == 1 ? m_settings->firstPlayerFleetColor : m_settings->secondPlayerFleetColor;
-    painter->setPen(fleetColor);
-    painter->setFont(m_settings->fleetFont);
+QPointF GraphicsSettings::fleetPosition(const QPointF &source, const QPointF &destination,
+                                        int totalTripLength, int turnsRemaining, qreal progress) const {
+    //The fleet moves from where it was on the previous turn to where it is now.
+    const int travelled = totalTripLength - turnsRemaining;
+    qreal fraction = 0;
 
-    const qreal baseRadius = 1 * scalingFactor;
-    QRectF rect(-baseRadius, -baseRadius, baseRadius*2, baseRadius*2);
-    painter->drawText(rect, Qt::AlignHCenter|Qt::AlignVCenter, qNumShips);
+    if (totalTripLength > 0) {
+        fraction = qMax(static_cast<qreal>(0), travelled - 1 + progress) / totalTripLength;
+    }
 
-    //The arrow is already set up.
-    //Paint the arrow.
-//    m_arrow->paint(painter, option, widget);
+    return (source + (destination - source) * fraction) * scalingFactor;
 }
 
-void FleetView::removeSelf() {
-    m_planetWarsView->removeFleetView(this);
+void GraphicsSettings::placeFleetArrow(QPolygonF *arrow, const QPointF &position,
+                                       const QPointF &source, const QPointF &destination) const {
+    //Point the arrow from the source towards the destination.
+    const qreal tripDx = destination.x() - source.x();
+    const qreal tripDy = destination.y() - source.y();
+    const qreal tripLength = sqrt(tripDx*tripDx + tripDy*tripDy);
+    const qreal ux = tripLength > 0 ? tripDx / tripLength : 1;
+    const qreal uy = tripLength > 0 ? tripDy / tripLength : 0;
+
+    const int numArrowPoints = fleetArrow.size();
+    arrow->resize(numArrowPoints);
+
+    for (int i = 0; i < numArrowPoints; ++i) {
+        const QPointF& point = fleetArrow[i];
+        (*arrow)[i] = QPointF(position.x() + point.x() * ux - point.y() * uy,
+                              position.y() + point.x() * uy + point.y() * ux);
+    }
 }
 
 /*===================================================
-              Class FleetConnector.
+               Class FrameRenderer.
 ====================================================*/
-FleetConnector::FleetConnector(FleetView *fleetView)
-    :QObject(NULL), m_fleetView(fleetView) {
+FrameRenderer::FrameRenderer(const GraphicsSettings *settings)
+    :m_settings(settings), m_frameSize(1024, 1024), m_showGrowthRates(true), m_showPlanetIds(false) {
 }
 
-void FleetConnector::setFleet(Fleet *fleet) {
-    m_fleet = fleet;
-    QObject::connect(m_fleet, SIGNAL(destroyed()), this, SLOT(removeFleet()));
+void FrameRenderer::fitMap(const GameSnapshot &state) {
+    const qreal scalingFactor = m_settings->scalingFactor;
+    const int numPlanets = static_cast<int>(state.planets.size());
+    QRectF mapBounds;
+
+    for (int i = 0; i < numPlanets; ++i) {
+        const PlanetState& planet = state.planets[i];
+        const qreal radius = m_settings->planetRadius(planet.growthRate) + m_settings->planetPen.widthF();
+        QPointF center(planet.x * scalingFactor, planet.y * scalingFactor);
+        mapBounds |= QRectF(center.x() - radius, center.y() - radius, radius * 2, radius * 2);
+    }
+
+    const qreal margin = 1 * scalingFactor;
+    mapBounds.adjust(-margin, -margin, margin, margin);
+
+    //Scale the map to fit the frame, keeping its proportions, and center it.
+    m_transform.reset();
+
+    if (mapBounds.isEmpty()) {
+        return;
+    }
+
+    const qreal scale = qMin(m_frameSize.width() / mapBounds.width(), m_frameSize.height() / mapBounds.height());
+    m_transform.translate((m_frameSize.width() - mapBounds.width() * scale) / 2,
+                          (m_frameSize.height() - mapBounds.height() * scale) / 2);
+    m_transform.scale(scale, scale);
+    m_transform.translate(-mapBounds.left(), -mapBounds.top());
 }
 
-void FleetConnector::removeFleet() {
-    m_fleetView->removeSelf();
+QImage FrameRenderer::render(const GameSnapshot &state) const {
+    QImage image(m_frameSize, QImage::Format_RGB32);
+    image.fill(m_settings->backgroundColor.rgb());
+
+    QPainter painter(&image);
+    painter.setTransform(m_transform);
+    this->paint(&painter, state);
+    painter.end();
+
+    return image;
 }
 
-/*===================================================
-              Class GraphicsSettings.
-====================================================*/
-GraphicsSettings::GraphicsSettings(QObject* parent)
-    :QObject(parent) {
+void FrameRenderer::paint(QPainter *painter, const GameSnapshot &state) const {
+    const qreal scalingFactor = m_settings->scalingFactor;
+    const int numPlanets = static_cast<int>(state.planets.size());
+
+    //Draw the planets.
+    for (int i = 0; i < numPlanets; ++i) {
+        const PlanetState& planet = state.planets[i];
+        const QPointF center(planet.x * scalingFactor, planet.y * scalingFactor);
+        const qreal radius = m_settings->planetRadius(planet.growthRate);
+        const qreal outerRadius = radius + m_settings->planetPen.widthF();
+        const QRectF bounds(center.x() - outerRadius, center.y() - outerRadius, outerRadius * 2, outerRadius * 2);
+
+        std::string colorProperty;
+        QString props;
+        const int numProps = static_cast<int>(planet.properties.size());
+
+        for (int j = 0; j < numProps; ++j) {
+            const std::pair<std::string, std::string>& property = planet.properties[j];
+
+            if ("color" == property.first) {
+                colorProperty = property.second;
+            }
+
+            if (j > 0) {
+                props.append("\n");
+            }
+
+            props.append(QString("%1: %2").arg(property.first.c_str()).arg(property.second.c_str()));
+        }
+
+        painter->setRenderHint(QPainter::Antialiasing, true);
+        painter->setPen(m_settings->planetPen);
+        painter->setBrush(m_settings->planetColor(planet.owner, colorProperty));
+        painter->drawEllipse(center, radius, radius);
+
+        painter->setPen(m_settings->textColor);
+        painter->setFont(m_settings->planetFleetFont);
+        painter->drawText(bounds, Qt::AlignHCenter|Qt::AlignVCenter,
+                          GraphicsSettings::planetLabel(planet.numShips, planet.growthRate, m_showGrowthRates));
+
+        if (m_showPlanetIds) {
+            painter->setPen(m_settings->planetIdColor);
+            painter->setFont(m_settings->planetIdFont);
+            painter->drawText(bounds, Qt::AlignLeft|Qt::AlignTop, QString::number(i));
+
+            if (!props.isEmpty()) {
+                const QPointF topLeft = center + m_settings->propsPosition();
+                painter->setPen(QColor("white"));
+                painter->setFont(m_settings->fleetFont);
+                painter->drawText(QRectF(topLeft, QSizeF(bounds.width() * 20, bounds.height() * 20)),
+                                  Qt::AlignLeft|Qt::AlignTop, props);
+            }
+        }
+    }
+
+    //Draw the fleets where they are at the end of the turn.
+    const int numFleets = static_cast<int>(state.fleets.size());
+    const qreal baseRadius = 1 * scalingFactor;
+    QPolygonF arrow;
+
+    painter->setRenderHint(QPainter::Antialiasing, false);
+    painter->setFont(m_settings->fleetFont);
+
+    for (int i = 0; i < numFleets; ++i) {
+        const FleetState& fleet = state.fleets[i];
+        const PlanetState& source = state.planets[fleet.sourceId];
+        const PlanetState& destination = state.planets[fleet.destinationId];
+        const QPointF sourcePosition(source.x, source.y);
+        const QPointF destinationPosition(destination.x, destination.y);
+
+        const QPointF position = m_settings->fleetPosition(sourcePosition, destinationPosition,
+                                                           fleet.totalTripLength, fleet.turnsRemaining, 1);
+        m_settings->placeFleetArrow(&arrow, position, sourcePosition, destinationPosition);
+
+        painter->setPen(m_settings->fleetPen(fleet.owner));
+        painter->setBrush(m_settings->fleetColor(fleet.owner));
+        painter->drawPolygon(arrow);
+
+        QRectF rect(position.x() - baseRadius, position.y() - baseRadius, baseRadius*2, baseRadius*2);
+        painter->drawText(rect, Qt::AlignHCenter|Qt::AlignVCenter, QString::number(fleet.numShips));
+    }
 }
@@ -6,15 +6,21 @@
 #ifndef GRAPHICS_H
 #define GRAPHICS_H
 
-#include <list>
+#include <string>
 #include <vector>
 #include <QColor>
+#include <QElapsedTimer>
 #include <QFont>
 #include <QGraphicsItem>
-#include <QGraphicsPolygonItem>
 #include <QGraphicsScene>
+#include <QHash>
+#include <QImage>
 #include <QPainter>
 #include <QPen>
+#include <QPolygonF>
+#include <QStaticText>
+#include <QTimer>
+#include <QTransform>
 
 //Forward-declared classes.
 class PlanetWarsGame;
@@ -22,11 +28,9 @@ class Planet;
 class Fleet;
 class Player;
 class PlanetView;
-class FleetView;
-class FleetConnector;
+class FleetLayer;
 class GraphicsSettings;
-
-typedef std::list<FleetView*> FleetViewList;
+struct GameSnapshot;
 
 //The main class containing the graphics.
 class PlanetWarsView : public QGraphicsScene {
@@ -44,8 +48,8 @@ public slots:
     //Update the game after its state changed.
     void redraw();
 
-    //Remove a fleet.
-    void removeFleetView(FleetView *fleetView);
+    //Move the fleets along to the current animation frame.
+    void advanceAnimation();
 
     //Planet display settings.
     void setShowGrowthRates(bool showGrowthRates);
@@ -54,11 +58,27 @@ public slots:
     bool getShowPlanetIds() const                   {return m_showPlanetIds;}
     bool getShowPlanetProps() const                 {return m_showPlanetProps;}
 
+signals:
+    //Report how much of the scene was invalidated at the end of a turn, out of the
+    //area of the whole map (both in scene units squared).
+    void turnRepainted(qreal invalidatedArea, qreal mapArea);
+
 private:
+    //Bring all planet labels up to date after a display setting has changed.
+    void refreshPlanets();
+
     PlanetWarsGame* m_game;
     GraphicsSettings* m_settings;
     std::vector<PlanetView*> m_planetViews;
-    FleetViewList m_fleetViews;
+    FleetLayer* m_fleetLayer;
+    qreal m_mapArea;
+
+    //Fleet animation between turns.
+    static const int FRAMES_PER_SECOND = 30;
+    static const int MAX_ANIMATION_MS = 1000;
+    QTimer* m_frameTimer;
+    QElapsedTimer m_turnClock;      //Time since the last turn ended.
+    qint64 m_animationMs;           //How long the fleets take to travel for one turn.
 
     //Planet display settings.
     bool m_showGrowthRates;
@@ -66,7 +86,9 @@ private:
     bool m_showPlanetProps;
 };
 
-//A class representing a planet.
+//A class representing a planet.  The planet disc is cached as a pixmap shared by all
+//planets of the same color and size, and the labels are laid out only when the
+//planet's owner, ship count or properties change.
 class PlanetView : public QGraphicsItem {
 public:
     PlanetView();
@@ -79,63 +101,132 @@ public:
     QRectF boundingRect() const;
     void paint(QPainter *painter, const QStyleOptionGraphicsItem *option, QWidget *widget);
 
-    //Handle changes in the planet's status.
-    //void updateNumShips(int numShips);
-    //void updateOwner(Player* owner);
+    //Bring the labels up to date after the planet has changed and schedule a repaint.
+    //Return the area that will be repainted.
+    qreal refresh();
 
 private:
+    //Largest disc that is still cached as a pixmap; bigger ones are drawn directly.
+    static const int MAX_CACHED_DISC_SIZE = 512;
+
+    //Lay out the labels again if anything they show has changed.  Without text,
+    //only the planet color is brought up to date.
+    void updateLabels(bool includeText);
+
+    //Draw the planet disc, from the pixmap cache if possible.
+    void drawDisc(QPainter* painter, const QColor& color);
+
+    //The area covered by the planet disc, without any labels that stick out.
+    QRectF discRect() const;
+
     Planet* m_planet;
     GraphicsSettings* m_settings;
     PlanetWarsView* m_planetWarsView;
 
     qreal m_radius;
+    QRectF m_bounds;
+
+    //What the cached labels currently show.
+    int m_shownOwnerId;
+    int m_shownNumShips;
+    bool m_shownGrowthRate;
+    int m_shownPropsVersion;
+    int m_colorPropsVersion;
+
+    QColor m_color;
+    QStaticText m_numShipsText;
+    QStaticText m_planetIdText;
+    QStaticText m_propsText;
+    QPointF m_propsPosition;
 };
 
-//A class representing a fleet view.
-class FleetView : public QGraphicsItem {
+//A single item that draws all fleets in flight in one pass.  Fleets come and go
+//every turn, so they are not given scene items of their own; the layer reads
+//them directly from the game and only keeps caches that are reused across frames.
+//The engine only tracks how many turns each fleet has left; positions are
+//worked out here, interpolated between the previous turn and the current one.
+class FleetLayer : public QGraphicsItem {
 public:
-    FleetView();
-    ~FleetView();
+    FleetLayer();
 
-    void setFleet(Fleet* fleet);
-    void setSettings(GraphicsSettings* settings) { m_settings = settings;}
-    void setPlanetWarsView(PlanetWarsView* view) { m_planetWarsView = view;}
+    void setGame(PlanetWarsGame* game)              { m_game = game;}
+    void setSettings(GraphicsSettings* settings)    { m_settings = settings;}
+
+    //Set the area that the fleets can occupy (the map plus some margin).
+    void setBounds(const QRectF& bounds);
+
+    //Set how far into the current turn the animation is, from 0 (fleets where they
+    //were on the previous turn) to 1 (fleets where they are now).
+    void setProgress(qreal progress);
+
+    //Schedule a repaint of the areas fleets have moved through at the end of a turn.
+    //Return the area that will be repainted.
+    qreal invalidateFleets();
 
     //The main painting logic.
     QRectF boundingRect() const;
     void paint(QPainter *painter, const QStyleOptionGraphicsItem *option, QWidget *widget);
 
-    void removeSelf();
+private:
+    //Most ship counts repeat from frame to frame; don't let the text cache grow without limit.
+    static const int MAX_CACHED_LABELS = 4096;
+
+    //Fleets grouped by owner, source and destination planet.
+    struct FleetLane {
+        quint64 key;
+        int numShips;
+        const Fleet* fleet;
 
-    QGraphicsPolygonItem* getArrow()        {return m_arrow;}
+        bool operator<(const FleetLane& other) const { return key < other.key;}
+    };
 
-private:
-    Fleet* m_fleet;
-    FleetConnector* m_connector;
+    //Draw each lane with fleets on it as a single line with the total ship count.
+    void paintLanes(QPainter* painter, qreal levelOfDetail);
+
+    //Get the laid-out ship count label.
+    const QStaticText& label(int numShips);
+
+    PlanetWarsGame* m_game;
     GraphicsSettings* m_settings;
-    PlanetWarsView* m_planetWarsView;
+    QRectF m_bounds;
+    qreal m_progress;
+    qreal m_levelOfDetail;              //Level of detail of the last paint.
 
-    qreal m_angle;
+    //Areas the fleets move through during this turn's and the last turn's animation.
+    std::vector<QRectF> m_currentRects;
+    std::vector<QRectF> m_previousRects;
 
-    QGraphicsPolygonItem* m_arrow;
+    QHash<int, QStaticText> m_labels;   //Ship count labels, keyed by ship count.
+    QPolygonF m_arrow;                  //Scratch space for the arrow being drawn.
+    std::vector<FleetLane> m_lanes;     //Scratch space for grouping fleets into lanes.
 };
 
-//This class is here because I can't seem to connect the fleet directly to the FleetView.
-//Its job is to forward Fleet's signals to FleetView object.
-class FleetConnector : public QObject {
-    Q_OBJECT
-
+//Draws a game state onto an image without a scene or a window.  It draws the same
+//things as PlanetView and FleetLayer, and can be used from several threads at once.
+class FrameRenderer {
 public:
-    FleetConnector(FleetView* fleetView);
+    FrameRenderer(const GraphicsSettings* settings);
 
-    void setFleet(Fleet *fleet);
+    void setFrameSize(const QSize& frameSize)       { m_frameSize = frameSize;}
+    void setShowGrowthRates(bool showGrowthRates)   { m_showGrowthRates = showGrowthRates;}
+    void setShowPlanetIds(bool showPlanetIds)       { m_showPlanetIds = showPlanetIds;}
+    QSize getFrameSize() const                      { return m_frameSize;}
 
-public slots:
-    void removeFleet();
+    //Scale and center the map of the given state within the frame.
+    void fitMap(const GameSnapshot& state);
+
+    //Draw the state into a new image.
+    QImage render(const GameSnapshot& state) const;
+
+    //Draw the state with the given painter, in scene coordinates.
+    void paint(QPainter* painter, const GameSnapshot& state) const;
 
 private:
-    FleetView* m_fleetView;
-    Fleet* m_fleet;
+    const GraphicsSettings* m_settings;
+    QSize m_frameSize;
+    QTransform m_transform;     //From scene coordinates to frame pixels.
+    bool m_showGrowthRates;
+    bool m_showPlanetIds;
 };
 
 class GraphicsSettings : public QObject {
@@ -144,12 +235,37 @@ class GraphicsSettings : public QObject {
 public:
     GraphicsSettings(QObject* parent);
 
+    //Levels of detail (on-screen pixels per scene unit) below which the view gets simpler.
+    //Below LANE_DETAIL, fleets on the same lane are drawn as one line with a total;
+    //below POINT_DETAIL, planets are drawn as dots and no text is drawn at all.
+    static const qreal LANE_DETAIL;
+    static const qreal POINT_DETAIL;
+    static const qreal POINT_SIZE;      //Size of a planet dot, in pixels.
+
+    //Geometry and text shared by the scene items and FrameRenderer.
+    qreal planetRadius(int growthRate) const;
+    QColor planetColor(int ownerId, const std::string& colorProperty) const;
+    static QString planetLabel(int numShips, int growthRate, bool showGrowthRate);
+    QPointF propsPosition() const;
+    const QPen& fleetPen(int ownerId) const;
+    const QColor& fleetColor(int ownerId) const;
+
+    //Get the scene position of a fleet; progress goes from 0 (the previous turn) to 1 (this turn).
+    //Source and destination are in map coordinates.
+    QPointF fleetPosition(const QPointF& source, const QPointF& destination,
+                          int totalTripLength, int turnsRemaining, qreal progress) const;
+
+    //Place the fleet arrow at the fleet position, pointing towards the destination.
+    void placeFleetArrow(QPolygonF* arrow, const QPointF& position,
+                         const QPointF& source, const QPointF& destination) const;
+
     //General colors.
     QColor backgroundColor;
 
     //Planet colors
     QColor firstPlayerColor;
     QColor secondPlayerColor;
+    std::vector<QColor> otherPlayerColors;  //Players 3 and up, in free-for-all games.
     QColor neutralColor;
     QColor textColor;
     QFont planetFleetFont;
@@ -160,6 +276,9 @@ public:
     QColor secondPlayerFleetColor;
     QPen firstPlayerFleetPen;
     QPen secondPlayerFleetPen;
+    std::vector<QColor> otherPlayerFleetColors;
+    std::vector<QPen> otherPlayerFleetPens;
+    QPolygonF fleetArrow;   //Arrow shape pointing along the x axis, relative to the fleet position.
 
     //Planet ids.
     QFont planetIdFont;
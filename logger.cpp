@@ -4,12 +4,16 @@
 //This file contains the logging display manager.
 
 #include "logger.h"
+#include <QDateTime>
+#include <QDir>
+#include <QStringList>
+#include <QTextDocument>
 
 /*===================================================
                    Class Logger.
 ====================================================*/
 Logger::Logger(QObject *parent)
-    : QObject(parent) {
+    : QObject(parent), m_logOutput(NULL), m_maxBlockCount(0) {
     //Initialize styles.
     m_plainColor.setRgb(0, 0, 0);           //Black
     m_gameMessageColor.setRgb(34, 112, 36); //Dark green
@@ -20,70 +24,69 @@ Logger::Logger(QObject *parent)
     m_playerStdInColor.setRgb(115, 95, 15); //Dark dirty khaki
     m_playerStdOutColor.setRgb(49, 49, 140);//Dark blue
 
-    //Initialize logging settings.
-    m_logFirstPlayerStdIn = false;
-    m_logFirstPlayerStdOut = false;
-    m_logFirstPlayerStdErr = true;
-    m_logSecondPlayerStdIn = false;
-    m_logSecondPlayerStdOut = false;
-    m_logSecondPlayerStdErr = true;
+    m_logFile = new RotatingLogFile(this);
+    QObject::connect(m_logFile, SIGNAL(logError(std::string,QString)),
+                     this, SLOT(recordError(std::string,QString)));
+}
 
+Logger::~Logger() {
+    m_logFile->close();
 }
 
-void Logger::recordMessage(const std::string &message, QObject *sender) {
-    this->recordLog(message, sender, Logger::MESSAGE);
+void Logger::setLogOutput(QTextEdit *output) {
+    m_logOutput = output;
+    this->setMaxBlockCount(m_maxBlockCount);
 }
 
-void Logger::recordError(const std::string &message, QObject *sender) {
-    this->recordLog(message, sender, Logger::ERROR);
+void Logger::setMaxBlockCount(int maxBlocks) {
+    m_maxBlockCount = maxBlocks;
+
+    //The document drops the oldest blocks by itself once the limit is reached.
+    if (NULL != m_logOutput) {
+        m_logOutput->document()->setMaximumBlockCount(maxBlocks);
+    }
 }
 
-void Logger::recordStdErr(const std::string &message, QObject *sender) {
-    this->recordLog(message, sender, Logger::STDERR);
+void Logger::startNewGame() {
+    m_logFile->startNewGame();
 }
 
-void Logger::recordStdIn(const std::string &message, QObject *sender) {
-    this->recordLog(message, sender, Logger::STDIN);
+void Logger::recordMessage(const std::string &message, const QString &sender) {
+    this->recordLog(message, sender, LogMask::MESSAGE);
 }
 
-void Logger::recordStdOut(const std::string &message, QObject *sender) {
-    this->recordLog(message, sender, Logger::STDOUT);
+void Logger::recordError(const std::string &message, const QString &sender) {
+    this->recordLog(message, sender, LogMask::ERROR);
 }
 
-void Logger::recordLog(const std::string &message, QObject *sender, const int messageType) {
-    QString senderName = sender->objectName();
+void Logger::recordStdErr(const std::string &message, const QString &sender) {
+    this->recordLog(message, sender, LogMask::STDERR);
+}
 
-    //Check whether we should be logging this.
-    if (0 == senderName.compare("Player 1")) {
-        if (!m_logFirstPlayerStdIn && (Logger::STDIN == messageType)) {
-            return;
-        } else if (!m_logFirstPlayerStdOut && (Logger::STDOUT == messageType)) {
-            return;
-        } else if (!m_logFirstPlayerStdErr && (Logger::STDERR == messageType)) {
-            return;
-        }
-    } else if (0 == senderName.compare("Player 2")) {
-        if (!m_logSecondPlayerStdIn && (Logger::STDIN == messageType)) {
-            return;
-        } else if (!m_logSecondPlayerStdOut && (Logger::STDOUT == messageType)) {
-            return;
-        } else if (!m_logSecondPlayerStdErr && (Logger::STDERR == messageType)) {
-            return;
-        }
-    }
+void Logger::recordStdIn(const std::string &message, const QString &sender) {
+    this->recordLog(message, sender, LogMask::STDIN);
+}
+
+void Logger::recordStdOut(const std::string &message, const QString &sender) {
+    this->recordLog(message, sender, LogMask::STDOUT);
+}
+
+void Logger::recordLog(const std::string &message, const QString &senderName, const LogMask::Category messageType) {
+    //Filtering has already been done by the sender (see LogMask).  The sender is known
+    //by name only; by now it may be gone, or busy on another thread.
 
     //Compose the full messag string.
     QString qMessage(message.c_str());
     QString fullMessage;
     fullMessage.append('[').append(senderName);
 
-    if (STDIN == messageType) {
+    if (LogMask::STDIN == messageType) {
         fullMessage.append(" stdin");
 
-    } else if (STDOUT == messageType) {
+    } else if (LogMask::STDOUT == messageType) {
         fullMessage.append(" stdout");
 
-    } else if (STDERR == messageType) {
+    } else if (LogMask::STDERR == messageType) {
         fullMessage.append(" stderr");
     }
 
@@ -96,27 +99,27 @@ void Logger::recordLog(const std::string &message, QObject *sender, const int me
         color = m_plainColor;
 
     } else if ('G' == senderName.at(0)) {
-        color = (messageType == Logger::MESSAGE ? m_gameMessageColor : m_gameErrorColor);
+        color = (messageType == LogMask::MESSAGE ? m_gameMessageColor : m_gameErrorColor);
 
     } else if ('P' == senderName.at(0)) {
         switch(messageType) {
-        case Logger::MESSAGE:
+        case LogMask::MESSAGE:
             color = m_playerMessageColor;
             break;
 
-        case Logger::ERROR:
+        case LogMask::ERROR:
             color = m_playerErrorColor;
             break;
 
-        case Logger::STDERR:
+        case LogMask::STDERR:
             color = m_playerStdErrColor;
             break;
 
-        case Logger::STDIN:
+        case LogMask::STDIN:
             color = m_playerStdInColor;
             break;
 
-        case Logger::STDOUT:
+        case LogMask::STDOUT:
             color = m_playerStdOutColor;
             break;
 
@@ -131,4 +134,165 @@ void Logger::recordLog(const std::string &message, QObject *sender, const int me
     //Write to the log.
     m_logOutput->setTextColor(color);
     m_logOutput->append(fullMessage);
+
+    if (m_logFile->isEnabled()) {
+        m_logFile->write(fullMessage);
+    }
+}
+
+/*===================================================
+               Class RotatingLogFile.
+====================================================*/
+RotatingLogFile::RotatingLogFile(QObject *parent)
+    :QObject(parent), m_isEnabled(false), m_hasFailed(false), m_isFailureReported(false), m_directory("logs"),
+    m_maxFileSize(16 * 1024 * 1024), m_maxFiles(10), m_isCompressed(false), m_isPerGame(false),
+    m_fileIndex(0), m_fileSize(0) {
+    m_prefix = "planetwarrior-" + QDateTime::currentDateTime().toString("yyyyMMdd-hhmmss");
+    this->setObjectName("Log File");
+}
+
+RotatingLogFile::~RotatingLogFile() {
+    this->close();
+}
+
+void RotatingLogFile::setEnabled(bool isEnabled) {
+    if (!isEnabled) {
+        this->close();
+    }
+
+    m_isEnabled = isEnabled;
+    m_hasFailed = false;
+}
+
+void RotatingLogFile::write(const QString &line) {
+    if (m_hasFailed || (!m_file.isOpen() && !this->openNextFile())) {
+        return;
+    }
+
+    QByteArray data = line.toUtf8();
+    data.append('\n');
+
+    if (m_isCompressed) {
+        m_chunk.append(data);
+
+        if (m_chunk.size() >= COMPRESSED_CHUNK_SIZE) {
+            this->flushChunk();
+        }
+
+    } else if (m_file.write(data) < 0) {
+        this->fail("Unable to write the log file " + m_file.fileName() + ": " + m_file.errorString());
+
+    } else {
+        m_fileSize += data.size();
+    }
+
+    //After a failure, the file is opened again on the next retry.
+    if (m_hasFailed) {
+        this->close();
+
+    } else if (m_fileSize >= m_maxFileSize) {
+        this->close();
+        this->openNextFile();
+    }
+}
+
+void RotatingLogFile::startNewGame() {
+    if (!m_isPerGame) {
+        return;
+    }
+
+    this->close();
+    m_prefix = "game-" + QDateTime::currentDateTime().toString("yyyyMMdd-hhmmss-zzz");
+    m_fileIndex = 0;
+    m_hasFailed = false;
+}
+
+void RotatingLogFile::close() {
+    if (!m_file.isOpen()) {
+        return;
+    }
+
+    if (m_isCompressed) {
+        this->flushChunk();
+    }
+
+    m_file.close();
+}
+
+bool RotatingLogFile::openNextFile() {
+    if (!QDir().mkpath(m_directory)) {
+        this->fail("Unable to create the log directory " + m_directory + ".");
+        return false;
+    }
+
+    ++m_fileIndex;
+    this->removeOldFiles();
+    m_file.setFileName(this->fileName(m_fileIndex));
+
+    if (!m_file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        this->fail("Unable to open the log file " + m_file.fileName() + ": " + m_file.errorString());
+        return false;
+    }
+
+    m_fileSize = 0;
+    m_isFailureReported = false;
+    return true;
+}
+
+void RotatingLogFile::removeOldFiles() {
+    if (m_maxFiles <= 0) {
+        return;
+    }
+
+    //Per-game files start a new series every game, so the window covers every series.
+    QStringList nameFilters;
+    nameFilters << "planetwarrior-*.log" << "planetwarrior-*.logz" << "game-*.log" << "game-*.logz";
+
+    QDir directory(m_directory);
+    const QStringList oldFiles = directory.entryList(nameFilters, QDir::Files, QDir::Time | QDir::Reversed);
+
+    for (int i = 0; i <= oldFiles.size() - m_maxFiles; ++i) {
+        directory.remove(oldFiles[i]);
+    }
+}
+
+void RotatingLogFile::fail(const QString &message) {
+    //Don't keep trying on every message; the user's setting stays as it is.
+    m_hasFailed = true;
+
+    if (!m_isFailureReported) {
+        m_isFailureReported = true;
+        emit logError(message.toStdString(), this->objectName());
+    }
+}
+
+QString RotatingLogFile::fileName(int index) const {
+    QString name = QString("%1-%2.%3")
+                   .arg(m_prefix)
+                   .arg(index, 4, 10, QChar('0'))
+                   .arg(m_isCompressed ? "logz" : "log");
+    return QDir(m_directory).filePath(name);
+}
+
+void RotatingLogFile::flushChunk() {
+    if (m_chunk.isEmpty()) {
+        return;
+    }
+
+    //Each chunk is stored as a 32-bit big-endian length followed by the qCompress() output,
+    //so the file can be decompressed chunk by chunk with qUncompress().
+    QByteArray compressed = qCompress(m_chunk);
+    const quint32 length = static_cast<quint32>(compressed.size());
+    char header[4];
+    header[0] = static_cast<char>((length >> 24) & 0xff);
+    header[1] = static_cast<char>((length >> 16) & 0xff);
+    header[2] = static_cast<char>((length >> 8) & 0xff);
+    header[3] = static_cast<char>(length & 0xff);
+
+    if (m_file.write(header, 4) < 0 || m_file.write(compressed) < 0) {
+        this->fail("Unable to write the log file " + m_file.fileName() + ": " + m_file.errorString());
+    }
+
+    m_fileSize += 4 + compressed.size();
+    m_chunk.clear();
 }
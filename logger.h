@@ -7,8 +7,14 @@
 #define LOGGER_H
 
 #include <string>
+#include <QByteArray>
 #include <QColor>
+#include <QFile>
+#include <QString>
 #include <QTextEdit>
+#include "logmask.h"
+
+class RotatingLogFile;
 
 
 //A class responsible for taking care of logging.
@@ -17,42 +23,49 @@ class Logger : public QObject {
 
 public:
     Logger(QObject* parent);
+    ~Logger();
+
+    void setLogOutput(QTextEdit* output);
+
+    //Limit on the number of lines (blocks) kept in the on-screen log; 0 = unlimited.
+    void setMaxBlockCount(int maxBlocks);
+    int getMaxBlockCount() const                { return m_maxBlockCount;}
 
-    void setLogOutput(QTextEdit* output)    {m_logOutput = output;}
+    //Access to the on-disk copy of the log.
+    RotatingLogFile* getLogFile() const         { return m_logFile;}
+
+    bool isLoggingFirstPlayerStdIn() const      { return LogMask::isEnabled(1, LogMask::STDIN);}
+    bool isLoggingFirstPlayerStdOut() const     { return LogMask::isEnabled(1, LogMask::STDOUT);}
+    bool isLoggingFirstPlayerStdErr() const     { return LogMask::isEnabled(1, LogMask::STDERR);}
+    bool isLoggingSecondPlayerStdIn() const     { return LogMask::isEnabled(2, LogMask::STDIN);}
+    bool isLoggingSecondPlayerStdOut() const    { return LogMask::isEnabled(2, LogMask::STDOUT);}
+    bool isLoggingSecondPlayerStdErr() const    { return LogMask::isEnabled(2, LogMask::STDERR);}
 
 public slots:
-    void recordMessage(const std::string& message, QObject* sender);
-    void recordError(const std::string& message, QObject* sender);
-    void recordStdErr(const std::string& message, QObject* sender);
-    void recordStdIn(const std::string& message, QObject* sender);
-    void recordStdOut(const std::string& message, QObject* sender);
-
-    void setLogFirstPlayerStdIn(bool doLog)     { m_logFirstPlayerStdIn = doLog;}
-    void setLogFirstPlayerStdOut(bool doLog)    { m_logFirstPlayerStdOut = doLog;}
-    void setLogFirstPlayerStdErr(bool doLog)    { m_logFirstPlayerStdErr = doLog;}
-    void setLogSecondPlayerStdIn(bool doLog)    { m_logSecondPlayerStdIn = doLog;}
-    void setLogSecondPlayerStdOut(bool doLog)   { m_logSecondPlayerStdOut = doLog;}
-    void setLogSecondPlayerStdErr(bool doLog)   { m_logSecondPlayerStdErr = doLog;}
-
-    bool isLoggingFirstPlayerStdIn() const      { return m_logFirstPlayerStdIn;}
-    bool isLoggingFirstPlayerStdOut() const     { return m_logFirstPlayerStdOut;}
-    bool isLoggingFirstPlayerStdErr() const     { return m_logFirstPlayerStdErr;}
-    bool isLoggingSecondPlayerStdIn() const     { return m_logSecondPlayerStdIn;}
-    bool isLoggingSecondPlayerStdOut() const    { return m_logSecondPlayerStdOut;}
-    bool isLoggingSecondPlayerStdErr() const    { return m_logSecondPlayerStdErr;}
+    void recordMessage(const std::string& message, const QString& sender);
+    void recordError(const std::string& message, const QString& sender);
+    void recordStdErr(const std::string& message, const QString& sender);
+    void recordStdIn(const std::string& message, const QString& sender);
+    void recordStdOut(const std::string& message, const QString& sender);
+
+    //Start a new log file if per-game log files are enabled.
+    void startNewGame();
+
+    //The switches are shared with the log producers, which check them before emitting.
+    void setLogFirstPlayerStdIn(bool doLog)     { LogMask::setEnabled(1, LogMask::STDIN, doLog);}
+    void setLogFirstPlayerStdOut(bool doLog)    { LogMask::setEnabled(1, LogMask::STDOUT, doLog);}
+    void setLogFirstPlayerStdErr(bool doLog)    { LogMask::setEnabled(1, LogMask::STDERR, doLog);}
+    void setLogSecondPlayerStdIn(bool doLog)    { LogMask::setEnabled(2, LogMask::STDIN, doLog);}
+    void setLogSecondPlayerStdOut(bool doLog)   { LogMask::setEnabled(2, LogMask::STDOUT, doLog);}
+    void setLogSecondPlayerStdErr(bool doLog)   { LogMask::setEnabled(2, LogMask::STDERR, doLog);}
 
 private:
-    //Message types:
-    static const int MESSAGE = 0;
-    static const int ERROR = 1;
-    static const int STDERR = 2;
-    static const int STDIN = 3;
-    static const int STDOUT = 4;
-
     //Record the log entry.
-    void recordLog(const std::string& message, QObject* sender, int messageType);
+    void recordLog(const std::string& message, const QString& senderName, LogMask::Category messageType);
 
     QTextEdit* m_logOutput;
+    int m_maxBlockCount;
+    RotatingLogFile* m_logFile;
 
     QColor m_plainColor;
     QColor m_gameMessageColor;
@@ -62,14 +75,78 @@ private:
     QColor m_playerStdErrColor;
     QColor m_playerStdInColor;
     QColor m_playerStdOutColor;
-
-    bool m_logFirstPlayerStdIn;
-    bool m_logFirstPlayerStdOut;
-    bool m_logFirstPlayerStdErr;
-    bool m_logSecondPlayerStdIn;
-    bool m_logSecondPlayerStdOut;
-    bool m_logSecondPlayerStdErr;
 };
 
+//Writes the log to a series of size-limited files on disk, optionally compressing them.
+//Only the most recent files are kept, counting those of earlier runs and games in the same
+//directory; older ones are deleted as new ones are opened.
+class RotatingLogFile : public QObject {
+    Q_OBJECT
+
+public:
+    RotatingLogFile(QObject* parent);
+    ~RotatingLogFile();
+
+    void setEnabled(bool isEnabled);
+    void setDirectory(const QString& directory)     { m_directory = directory; m_hasFailed = false;}
+    void setMaxFileSize(qint64 maxFileSize)         { m_maxFileSize = maxFileSize;}
+    void setMaxFiles(int maxFiles)                  { m_maxFiles = maxFiles;}
+    void setCompressed(bool isCompressed)           { m_isCompressed = isCompressed;}
+    void setPerGame(bool isPerGame)                 { m_isPerGame = isPerGame;}
+
+    //Whether the user wants the log on disk, even if it can't be written at the moment.
+    bool isEnabled() const                          { return m_isEnabled;}
+    QString getDirectory() const                    { return m_directory;}
+    qint64 getMaxFileSize() const                   { return m_maxFileSize;}
+    int getMaxFiles() const                         { return m_maxFiles;}
+    bool isCompressed() const                       { return m_isCompressed;}
+    bool isPerGame() const                          { return m_isPerGame;}
+
+    //Append a line to the log.
+    void write(const QString& line);
+
+    //Begin a new series of files for a new game (only if per-game files are on).
+    void startNewGame();
+
+    //Write out any buffered data and close the current file.
+    void close();
+
+signals:
+    //Reported once when the log can't be written; it's tried again with the next game
+    //or when the settings change.
+    void logError(const std::string& message, const QString& sender);
+
+private:
+    //Size of the buffer accumulated before a compressed chunk is written out.
+    static const int COMPRESSED_CHUNK_SIZE = 64 * 1024;
+
+    //Open the next file in the series, deleting the ones that fell out of the window.
+    bool openNextFile();
+    QString fileName(int index) const;
+
+    //Delete the oldest log files in the directory, leaving room for maxFiles - 1 of them.
+    void removeOldFiles();
+
+    //Stop writing until the next retry, and tell the user why.
+    void fail(const QString& message);
+
+    //Write the pending buffer as one compressed chunk.
+    void flushChunk();
+
+    bool m_isEnabled;
+    bool m_hasFailed;       //Whether writing failed since the last retry.
+    bool m_isFailureReported;   //Whether the user has heard of it since the last file was opened.
+    QString m_directory;
+    qint64 m_maxFileSize;
+    int m_maxFiles;
+    bool m_isCompressed;
+    bool m_isPerGame;
+
+    QString m_prefix;       //Common part of the names of the files in the current series.
+    int m_fileIndex;        //Index of the current file in the series.
+    QFile m_file;
+    qint64 m_fileSize;      //Bytes written to the current file so far.
+    QByteArray m_chunk;     //Data waiting to be compressed.
+};
 
 #endif // LOGGER_H
@@ -0,0 +1,30 @@
+//Available under GPL v3 license.
+//Author: Iouri Khramtsov.
+
+//This file contains the process-wide switches that decide which log messages get produced.
+
+#include "logmask.h"
+
+//By default, everything except the bots' stdin and stdout is logged.
+QAtomicInt LogMask::s_masks[LogMask::NUM_CATEGORIES] = {
+    QAtomicInt(~0),     //MESSAGE
+    QAtomicInt(~0),     //ERROR
+    QAtomicInt(~0),     //STDERR
+    QAtomicInt(0),      //STDIN
+    QAtomicInt(0),      //STDOUT
+};
+
+void LogMask::setEnabled(int sourceId, Category category, bool isEnabled) {
+    const unsigned int bit = getBit(sourceId);
+
+    //Other sources' bits may be changed concurrently, so retry until our update sticks.
+    for (;;) {
+        const int oldMask = static_cast<int>(s_masks[category]);
+        const unsigned int oldBits = static_cast<unsigned int>(oldMask);
+        const int newMask = static_cast<int>(isEnabled ? (oldBits | bit) : (oldBits & ~bit));
+
+        if (s_masks[category].testAndSetOrdered(oldMask, newMask)) {
+            return;
+        }
+    }
+}
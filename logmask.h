@@ -0,0 +1,43 @@
+//Available under GPL v3 license.
+//Author: Iouri Khramtsov.
+
+//This file contains the process-wide switches that decide which log messages get produced.
+
+#ifndef LOGMASK_H
+#define LOGMASK_H
+
+#include <QAtomicInt>
+
+//A set of flags shared between the log producers (game engine, players) and the logger.
+//Producers check the flags before building a message or emitting a log signal, so a
+//disabled log category costs a single branch.  Each category holds one bit per
+//log source; source 0 is the game engine, sources 1 and up are the players.
+class LogMask {
+public:
+    enum Category {
+        MESSAGE,
+        ERROR,
+        STDERR,
+        STDIN,
+        STDOUT,
+        NUM_CATEGORIES
+    };
+
+    static const int MAX_SOURCES = 32;
+
+    //Check whether messages of this category from the given source are wanted.
+    static bool isEnabled(int sourceId, Category category) {
+        return (static_cast<unsigned int>(static_cast<int>(s_masks[category])) & getBit(sourceId)) != 0;
+    }
+
+    //Turn logging of a category on or off for a given source.
+    static void setEnabled(int sourceId, Category category, bool isEnabled);
+
+private:
+    //The bit of a source in the masks.  Unsigned, so that source 31 doesn't shift into the sign.
+    static unsigned int getBit(int sourceId)    { return 1u << (sourceId & (MAX_SOURCES - 1));}
+
+    static QAtomicInt s_masks[NUM_CATEGORIES];
+};
+
+#endif // LOGMASK_H
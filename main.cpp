@@ -6,13 +6,667 @@
  * with this source code (also available online at http://www.gnu.org/licenses/gpl.txt).
  */
 
+#include <cstdio>
+#include <cstdlib>
+#include <algorithm>
+#include <cstring>
 #include <QtGui/QApplication>
+#include <QEventLoop>
+#include <QFile>
+#include <QStringList>
 #include "MainWindow.h"
+#include "console.h"
+#include "exporter.h"
+#include "game.h"
+#include "results.h"
+#include "sprt.h"
+
+//Render a replay into image files without opening a window:
+//  PlanetWarrior --export-frames <replay file> <output directory or -> [<width>x<height>]
+int exportFrames(int argc, char *argv[])
+{
+    //Fonts and images are needed, but not the window system.
+    QApplication a(argc, argv, false);
+
+    if (argc < 4) {
+        fprintf(stderr, "Usage: %s --export-frames <replay file> <output directory or -> [<width>x<height>]\n", argv[0]);
+        return 1;
+    }
+
+    FrameExporter exporter(NULL);
+    exporter.setOutputDirectory(argv[3]);
+
+    if (argc > 4) {
+        QStringList size = QString(argv[4]).split('x');
+
+        if (size.size() == 2) {
+            exporter.setFrameSize(QSize(size[0].toInt(), size[1].toInt()));
+        }
+    }
+
+    QString error;
+
+    if (!exporter.exportReplay(argv[2], &error)) {
+        fprintf(stderr, "%s\n", error.toLocal8Bit().constData());
+        return 1;
+    }
+
+    return 0;
+}
+
+//Settings shared by the runners that play games without a window.
+struct HeadlessOptions {
+    HeadlessOptions()
+        :maxTurns(200), turnLength(1000), firstTurnLength(3000), isCpuTimed(false),
+          isRecordingTurnHashes(false) {}
+
+    int maxTurns;
+    int turnLength;
+    int firstTurnLength;
+    bool isCpuTimed;
+    bool isRecordingTurnHashes;
+    std::string resultsFileName;
+    BotLimits limits;
+    AdjudicationRules adjudication;
+};
+
+//Parse one of the options shared by the headless runners at argv[i].  Return the number of
+//arguments it takes, 0 if it's not one of them, or -1 if it's malformed.
+int parseHeadlessOption(int argc, char *argv[], int i, HeadlessOptions* options)
+{
+    if (0 == strcmp(argv[i], "--cpu-time")) {
+        //A flag without a value.
+        options->isCpuTimed = true;
+        return 1;
+    }
+
+    if (0 == strcmp(argv[i], "--adjudicate-stranded")) {
+        options->adjudication.isStrandedOut = true;
+        return 1;
+    }
+
+    if (0 == strcmp(argv[i], "--turn-hashes")) {
+        options->isRecordingTurnHashes = true;
+        return 1;
+    }
+
+    const char* valueOptions[] = {"--max-turns", "--turn-length", "--first-turn-length", "--results",
+                                  "--cpus", "--numa-node", "--cgroup", "--bot-cpu-seconds",
+                                  "--bot-memory-mb", "--bot-max-processes", "--adjudicate-ratio"};
+    const int numValueOptions = sizeof(valueOptions) / sizeof(valueOptions[0]);
+
+    bool isValueOption = false;
+
+    for (int j = 0; j < numValueOptions && !isValueOption; ++j) {
+        isValueOption = (0 == strcmp(argv[i], valueOptions[j]));
+    }
+
+    if (!isValueOption) {
+        return 0;
+    }
+
+    if (i + 1 >= argc) {
+        fprintf(stderr, "Missing value for %s\n", argv[i]);
+        return -1;
+    }
+
+    const char* value = argv[i + 1];
+
+    if (0 == strcmp(argv[i], "--max-turns")) {
+        options->maxTurns = atoi(value);
+
+    } else if (0 == strcmp(argv[i], "--turn-length")) {
+        options->turnLength = atoi(value);
+
+    } else if (0 == strcmp(argv[i], "--first-turn-length")) {
+        options->firstTurnLength = atoi(value);
+
+    } else if (0 == strcmp(argv[i], "--results")) {
+        options->resultsFileName = value;
+
+    } else if (0 == strcmp(argv[i], "--cpus")) {
+        if (!ParseCpuList(value, &options->limits.cpus)) {
+            fprintf(stderr, "Bad list of cores: %s\n", value);
+            return -1;
+        }
+
+    } else if (0 == strcmp(argv[i], "--numa-node")) {
+        //Memory gets allocated on the node the cores belong to as the processes touch it.
+        if (!ReadNumaNodeCpus(atoi(value), &options->limits.cpus)) {
+            fprintf(stderr, "Unknown NUMA node: %s\n", value);
+            return -1;
+        }
+
+    } else if (0 == strcmp(argv[i], "--cgroup")) {
+        options->limits.cgroupDirectory = value;
+
+    } else if (0 == strcmp(argv[i], "--bot-cpu-seconds")) {
+        options->limits.cpuSeconds = atoi(value);
+
+    } else if (0 == strcmp(argv[i], "--bot-memory-mb")) {
+        options->limits.memoryMb = atoi(value);
+
+    } else if (0 == strcmp(argv[i], "--bot-max-processes")) {
+        options->limits.maxProcesses = atoi(value);
+
+    } else if (0 == strcmp(argv[i], "--adjudicate-ratio")) {
+        //<ship ratio>,<production ratio>,<turns>
+        QStringList parts = QString(value).split(',');
+
+        if (3 != parts.size()) {
+            fprintf(stderr, "Bad adjudication ratio: %s\n", value);
+            return -1;
+        }
+
+        options->adjudication.shipRatio = parts[0].toDouble();
+        options->adjudication.productionRatio = parts[1].toDouble();
+        options->adjudication.numTurns = parts[2].toInt();
+    }
+
+    return 2;
+}
+
+//Set up what all the games of a headless run share.  Return false if it can't be done.
+bool startHeadlessRun(const HeadlessOptions& options, ResultsStore* results)
+{
+    //Keep the engine on the game's cores too.
+    if (!options.limits.cpus.empty() && !PinToCpus(options.limits.cpus)) {
+        fprintf(stderr, "Unable to run on the given cores.\n");
+        return false;
+    }
+
+    std::string error;
+
+    if (!PrepareCgroupDirectory(options.limits, &error)) {
+        fprintf(stderr, "%s\n", error.c_str());
+        return false;
+    }
+
+    if (!options.resultsFileName.empty() && !results->open(options.resultsFileName, &error)) {
+        fprintf(stderr, "%s\n", error.c_str());
+        return false;
+    }
+
+    return true;
+}
+
+//Play one game to the end.  Return false if it couldn't start.
+bool runGame(const std::string& mapFileName, const QStringList& bots, const std::string& replayFileName,
+             const HeadlessOptions& options, GameResult* result)
+{
+    PlanetWarsGame game(NULL);
+    game.setMapFileName(mapFileName);
+    game.setReplayFileName(replayFileName);
+    game.setMaxTurns(options.maxTurns);
+    game.setTurnLength(options.turnLength);
+    game.setFirstTurnLength(options.firstTurnLength);
+    game.setCpuTimed(options.isCpuTimed);
+    game.setTimerIgnored(false);
+    game.setRenderDelay(0);
+    game.setNumPlayers(bots.size());
+    game.setBotLimits(options.limits);
+    game.setAdjudicationRules(options.adjudication);
+
+    //Send all the logs to stderr.
+    ConsoleLogger logger(NULL);
+    QObject::connect(&game, SIGNAL(logMessage(std::string,QString)),
+                     &logger, SLOT(recordMessage(std::string,QString)));
+    QObject::connect(&game, SIGNAL(logError(std::string,QString)),
+                     &logger, SLOT(recordError(std::string,QString)));
+
+    for (int i = 1; i <= game.getNumPlayers(); ++i) {
+        Player* player = game.getPlayer(i);
+        player->setLaunchCommand(bots[i - 1]);
+
+        QObject::connect(player, SIGNAL(logMessage(std::string,QString)),
+                         &logger, SLOT(recordMessage(std::string,QString)));
+        QObject::connect(player, SIGNAL(logError(std::string,QString)),
+                         &logger, SLOT(recordError(std::string,QString)));
+        QObject::connect(player, SIGNAL(logStdErr(std::string,QString)),
+                         &logger, SLOT(recordStdErr(std::string,QString)));
+    }
+
+    game.reset();
+
+    if (PlanetWarsGame::RESET != game.getState()) {
+        //The map couldn't be loaded; the game has already said why.
+        return false;
+    }
+
+    QEventLoop loop;
+    QObject::connect(&game, SIGNAL(stopped()), &loop, SLOT(quit()));
+    game.run();
+    loop.exec();
+
+    game.stopPlayers();
+    GetGameResult(game, result);
+
+    //The final hash is always kept; the one of every turn only on request, as it's most of the record.
+    if (!options.isRecordingTurnHashes && !result->turnHashes.empty()) {
+        result->turnHashes.erase(result->turnHashes.begin(), result->turnHashes.end() - 1);
+    }
+
+    return true;
+}
+
+//Play one game between any number of bots without opening a window:
+//  PlanetWarrior --play <map file> --bot <command> --bot <command> [--bot <command> ...]
+//                [--max-turns <n>] [--turn-length <ms>] [--first-turn-length <ms>] [--replay <file>]
+//                [--results <file>] [--cpu-time] [--cpus <list> | --numa-node <n>] [--cgroup <directory>]
+//                [--bot-cpu-seconds <s>] [--bot-memory-mb <mb>] [--bot-max-processes <n>]
+//                [--adjudicate-ratio <ships>,<production>,<turns>] [--adjudicate-stranded] [--turn-hashes]
+//With --cpu-time, the turn lengths are measured in the bots' CPU time instead of wall time.
+//--cpus (e.g. 4-7) or --numa-node keeps the game and its bots on a set of cores, so that
+//games running side by side don't compete for them.  The bot limits are applied through
+//the given cgroup v2 directory if there is one, and through rlimits otherwise.
+//--adjudicate-ratio 3,2,20 ends the game once a player has had three times the ships and twice
+//the production of everyone else for 20 turns in a row; --adjudicate-stranded ends it once
+//the players without planets can't take any.
+//With --results, the outcome is added to a results file (see ResultsStore), with the state
+//hash of every turn if --turn-hashes is given.
+//Prints the number of the winner, or 0 for a draw, to stdout.
+int playGame(int argc, char *argv[])
+{
+    QCoreApplication a(argc, argv);
+
+    if (argc < 3) {
+        fprintf(stderr, "Usage: %s --play <map file> --bot <command> --bot <command> [--bot <command> ...] "
+                "[--max-turns <n>] [--turn-length <ms>] [--first-turn-length <ms>] [--replay <file>] "
+                "[--results <file>] [--cpu-time] [--cpus <list> | --numa-node <n>] [--cgroup <directory>] "
+                "[--bot-cpu-seconds <s>] [--bot-memory-mb <mb>] [--bot-max-processes <n>] "
+                "[--adjudicate-ratio <ships>,<production>,<turns>] [--adjudicate-stranded] [--turn-hashes]\n", argv[0]);
+        return 1;
+    }
+
+    HeadlessOptions options;
+    QStringList bots;
+    std::string replayFileName;
+
+    for (int i = 3; i < argc;) {
+        const int numUsed = parseHeadlessOption(argc, argv, i, &options);
+
+        if (numUsed < 0) {
+            return 1;
+
+        } else if (numUsed > 0) {
+            i += numUsed;
+
+        } else if (i + 1 < argc && 0 == strcmp(argv[i], "--bot")) {
+            bots.append(argv[i + 1]);
+            i += 2;
+
+        } else if (i + 1 < argc && 0 == strcmp(argv[i], "--replay")) {
+            replayFileName = argv[i + 1];
+            i += 2;
+
+        } else {
+            fprintf(stderr, "Unknown option %s\n", argv[i]);
+            return 1;
+        }
+    }
+
+    if (bots.size() < 2 || bots.size() > PlanetWarsGame::MAX_PLAYERS) {
+        fprintf(stderr, "Between 2 and %d bots are needed.\n", static_cast<int>(PlanetWarsGame::MAX_PLAYERS));
+        return 1;
+    }
+
+    ResultsStore results;
+
+    if (!startHeadlessRun(options, &results)) {
+        return 1;
+    }
+
+    GameResult result;
+
+    if (!runGame(argv[2], bots, replayFileName, options, &result)) {
+        return 1;
+    }
+
+    std::string error;
+
+    if (!options.resultsFileName.empty() && !results.append(result, 0, &error)) {
+        fprintf(stderr, "%s\n", error.c_str());
+    }
+
+    if (result.winner < 0) {
+        //A bot crashed or misbehaved before the game could finish.
+        return 1;
+    }
+
+    printf("%d\n", result.winner);
+    return 0;
+}
+
+//Orders bots by their Elo rating, best first.
+struct IsBetterRated {
+    IsBetterRated(const std::vector<Rating>& ratings) :ratings(ratings) {}
+    bool operator()(int first, int second) const {return ratings[first].elo > ratings[second].elo;}
+
+    const std::vector<Rating>& ratings;
+};
+
+//Play the games of a tournament one after another:
+//  PlanetWarrior --tournament <schedule file> --results <file> [options of --play other than --bot and --replay]
+//Each line of the schedule is one game: the map file and the bot commands, separated by tabs.
+//Empty lines and lines starting with # are skipped.  Games already in the results file are
+//not played again, so an interrupted tournament carries on where it stopped.
+//Prints the ratings of the bots to stdout at the end.
+int playTournament(int argc, char *argv[])
+{
+    QCoreApplication a(argc, argv);
+
+    HeadlessOptions options;
+
+    for (int i = 3; i < argc;) {
+        const int numUsed = parseHeadlessOption(argc, argv, i, &options);
+
+        if (numUsed < 0) {
+            return 1;
+
+        } else if (0 == numUsed) {
+            fprintf(stderr, "Unknown option %s\n", argv[i]);
+            return 1;
+        }
+
+        i += numUsed;
+    }
+
+    if (argc < 3 || options.resultsFileName.empty()) {
+        fprintf(stderr, "Usage: %s --tournament <schedule file> --results <file> [--max-turns <n>] "
+                "[--turn-length <ms>] [--first-turn-length <ms>] [--cpu-time] [--cpus <list> | --numa-node <n>] "
+                "[--cgroup <directory>] [--bot-cpu-seconds <s>] [--bot-memory-mb <mb>] [--bot-max-processes <n>] "
+                "[--adjudicate-ratio <ships>,<production>,<turns>] [--adjudicate-stranded] [--turn-hashes]\n",
+                argv[0]);
+        return 1;
+    }
+
+    QFile schedule(QString::fromLocal8Bit(argv[2]));
+
+    if (!schedule.open(QIODevice::ReadOnly | QIODevice::Text)) {
+        fprintf(stderr, "Unable to read the schedule %s\n", argv[2]);
+        return 1;
+    }
+
+    ResultsStore results;
+
+    if (!startHeadlessRun(options, &results)) {
+        return 1;
+    }
+
+    for (int lineNumber = 1; !schedule.atEnd(); ++lineNumber) {
+        const QByteArray line = schedule.readLine().trimmed();
+
+        if (line.isEmpty() || line.startsWith('#')) {
+            continue;
+        }
+
+        //A game is known by its place in the schedule and what it's made of.
+        const quint64 key = MakeGameKey((QByteArray::number(lineNumber) + '\t' + line).constData());
+
+        if (results.contains(key)) {
+            continue;
+        }
+
+        QStringList bots = QString::fromLocal8Bit(line.constData()).split('\t', QString::SkipEmptyParts);
+        const std::string mapFileName = bots.takeFirst().toLocal8Bit().constData();
+
+        if (bots.size() < 2 || bots.size() > PlanetWarsGame::MAX_PLAYERS) {
+            fprintf(stderr, "Line %d of the schedule: between 2 and %d bots are needed.\n",
+                    lineNumber, static_cast<int>(PlanetWarsGame::MAX_PLAYERS));
+            continue;
+        }
+
+        GameResult result;
+        std::string error;
+
+        if (!runGame(mapFileName, bots, "", options, &result)) {
+            fprintf(stderr, "Line %d of the schedule: the game couldn't start.\n", lineNumber);
+
+        } else if (!results.append(result, key, &error)) {
+            fprintf(stderr, "%s\n", error.c_str());
+            return 1;
+        }
+    }
+
+    //Print the standings.
+    const std::vector<std::string>& names = results.getBots();
+    const std::vector<Rating>& ratings = results.getRatings();
+    std::vector<int> order;
+
+    for (int i = 0; i < static_cast<int>(ratings.size()); ++i) {
+        order.push_back(i);
+    }
+
+    std::sort(order.begin(), order.end(), IsBetterRated(ratings));
+
+    printf("%7s %7s %5s %7s %7s %7s %7s  %s\n", "elo", "glicko", "rd", "games", "wins", "draws", "fails", "bot");
+
+    for (size_t i = 0; i < order.size(); ++i) {
+        const Rating& rating = ratings[order[i]];
+        printf("%7.1f %7.1f %5.1f %7d %7d %7d %7d  %s\n", rating.elo, rating.glicko, rating.glickoDeviation,
+               rating.numGames, rating.numWins, rating.numDraws, rating.numFailures, names[order[i]].c_str());
+    }
+
+    return 0;
+}
+
+//Play bot B against bot A until a sequential test decides whether B is stronger:
+//  PlanetWarrior --match --bot <command A> --bot <command B> --map <file> [--map <file> ...]
+//                [--elo0 <elo>] [--elo1 <elo>] [--alpha <rate>] [--beta <rate>] [--max-games <n>]
+//                [options of --play other than --replay]
+//The games go through the maps in turn, each map played twice with the bots swapping sides.
+//After each game B's wins, draws and losses go into a test of "B is at most elo0 stronger"
+//(default 0) against "B is at least elo1 stronger" (default 5), with error rates alpha and
+//beta (default 0.05 each), and the match stops as soon as either is accepted.
+//Prints H1 if B is stronger, H0 if it's not, or nothing if --max-games ran out first.
+int playMatch(int argc, char *argv[])
+{
+    QCoreApplication a(argc, argv);
+
+    HeadlessOptions options;
+    QStringList bots;
+    std::vector<std::string> maps;
+    double elo0 = 0;
+    double elo1 = 5;
+    double alpha = 0.05;
+    double beta = 0.05;
+    int maxGames = 20000;
+
+    for (int i = 2; i < argc;) {
+        const int numUsed = parseHeadlessOption(argc, argv, i, &options);
+
+        if (numUsed < 0) {
+            return 1;
+
+        } else if (numUsed > 0) {
+            i += numUsed;
+            continue;
+
+        } else if (i + 1 >= argc) {
+            fprintf(stderr, "Unknown option %s\n", argv[i]);
+            return 1;
+
+        } else if (0 == strcmp(argv[i], "--bot")) {
+            bots.append(argv[i + 1]);
+
+        } else if (0 == strcmp(argv[i], "--map")) {
+            maps.push_back(argv[i + 1]);
+
+        } else if (0 == strcmp(argv[i], "--elo0")) {
+            elo0 = atof(argv[i + 1]);
+
+        } else if (0 == strcmp(argv[i], "--elo1")) {
+            elo1 = atof(argv[i + 1]);
+
+        } else if (0 == strcmp(argv[i], "--alpha")) {
+            alpha = atof(argv[i + 1]);
+
+        } else if (0 == strcmp(argv[i], "--beta")) {
+            beta = atof(argv[i + 1]);
+
+        } else if (0 == strcmp(argv[i], "--max-games")) {
+            maxGames = atoi(argv[i + 1]);
+
+        } else {
+            fprintf(stderr, "Unknown option %s\n", argv[i]);
+            return 1;
+        }
+
+        i += 2;
+    }
+
+    if (2 != bots.size() || maps.empty() || elo1 <= elo0
+            || alpha <= 0 || alpha >= 1 || beta <= 0 || beta >= 1) {
+        fprintf(stderr, "Usage: %s --match --bot <command A> --bot <command B> --map <file> [--map <file> ...] "
+                "[--elo0 <elo>] [--elo1 <elo>] [--alpha <rate>] [--beta <rate>] [--max-games <n>] "
+                "[--max-turns <n>] [--turn-length <ms>] [--first-turn-length <ms>] [--results <file>] [--cpu-time] "
+                "[--cpus <list> | --numa-node <n>] [--cgroup <directory>] [--bot-cpu-seconds <s>] "
+                "[--bot-memory-mb <mb>] [--bot-max-processes <n>] [--adjudicate-ratio <ships>,<production>,<turns>] "
+                "[--adjudicate-stranded] [--turn-hashes]\n", argv[0]);
+        return 1;
+    }
+
+    ResultsStore results;
+
+    if (!startHeadlessRun(options, &results)) {
+        return 1;
+    }
+
+    Sprt test(elo0, elo1, alpha, beta);
+
+    for (int game = 0; game < maxGames && Sprt::UNDECIDED == test.getDecision(); ++game) {
+        //B is player 2 in even games and player 1 in odd ones.
+        const std::string& mapFileName = maps[(game / 2) % maps.size()];
+        const bool isBFirst = (1 == game % 2);
+        const int bPlayer = isBFirst ? 1 : 2;
+
+        QStringList sides;
+        sides << bots[isBFirst ? 1 : 0] << bots[isBFirst ? 0 : 1];
+
+        GameResult result;
+        std::string error;
+
+        if (!runGame(mapFileName, sides, "", options, &result)) {
+            fprintf(stderr, "The game on %s couldn't start.\n", mapFileName.c_str());
+            return 1;
+        }
+
+        if (!options.resultsFileName.empty() && !results.append(result, 0, &error)) {
+            fprintf(stderr, "%s\n", error.c_str());
+            return 1;
+        }
+
+        //A bot that drops out loses; a game stopped without anyone to blame doesn't count.
+        const bool hasBFailed = (Player::NO_FAILURE != result.failures[bPlayer - 1]);
+        const bool hasAFailed = (Player::NO_FAILURE != result.failures[2 - bPlayer]);
+
+        if (result.winner > 0) {
+            test.addScore((bPlayer == result.winner) ? 1.0 : 0.0);
+        } else if (0 == result.winner || (hasAFailed && hasBFailed)) {
+            test.addScore(0.5);
+        } else if (hasAFailed || hasBFailed) {
+            test.addScore(hasAFailed ? 1.0 : 0.0);
+        }
+
+        fprintf(stderr, "Game %d: B %d-%d-%d, LLR %.2f (%.2f, %.2f)\n", game + 1,
+                test.getNumWins(), test.getNumDraws(), test.getNumLosses(),
+                test.getLlr(), test.getLowerBound(), test.getUpperBound());
+    }
+
+    switch (test.getDecision()) {
+    case Sprt::ACCEPT_H1:
+        printf("H1\n");
+        break;
+
+    case Sprt::ACCEPT_H0:
+        printf("H0\n");
+        break;
+
+    default:
+        break;
+    }
+
+    return 0;
+}
+
+//Find the first turn on which two replays of a game differ, going by the state hashes in them:
+//  PlanetWarrior --diff-replays <replay file> <replay file>
+//Prints the turn, or nothing if the replays are the same.  Returns 1 if they differ.
+int diffReplays(int argc, char *argv[])
+{
+    if (argc < 4) {
+        fprintf(stderr, "Usage: %s --diff-replays <replay file> <replay file>\n", argv[0]);
+        return 2;
+    }
+
+    std::vector<quint64> hashes[2];
+
+    for (int i = 0; i < 2; ++i) {
+        QFile replay(QString::fromLocal8Bit(argv[i + 2]));
+
+        if (!replay.open(QIODevice::ReadOnly)) {
+            fprintf(stderr, "Unable to open %s\n", argv[i + 2]);
+            return 2;
+        }
+
+        const QByteArray text = replay.readAll();
+        std::string error;
+
+        if (!ReadReplayHashes(std::string(text.constData(), text.size()), &hashes[i], &error)) {
+            fprintf(stderr, "%s: %s\n", argv[i + 2], error.c_str());
+            return 2;
+        }
+    }
+
+    const int turn = FindReplayDivergence(hashes[0], hashes[1]);
+
+    if (turn < 0) {
+        return 0;
+    }
+
+    printf("%d\n", turn);
+    return 1;
+}
 
 int main(int argc, char *argv[])
 {
+    if (argc > 1 && 0 == strcmp(argv[1], "--export-frames")) {
+        return exportFrames(argc, argv);
+    }
+
+    if (argc > 1 && 0 == strcmp(argv[1], "--play")) {
+        return playGame(argc, argv);
+    }
+
+    if (argc > 1 && 0 == strcmp(argv[1], "--tournament")) {
+        return playTournament(argc, argv);
+    }
+
+    if (argc > 1 && 0 == strcmp(argv[1], "--match")) {
+        return playMatch(argc, argv);
+    }
+
+    if (argc > 1 && 0 == strcmp(argv[1], "--diff-replays")) {
+        return diffReplays(argc, argv);
+    }
+
     QApplication a(argc, argv);
     MainWindow w;
+
+    //  --serve-spectators <address>    Broadcast the games to other instances.
+    //  --spectate <address>            Watch the games broadcast by another instance.
+    for (int i = 1; i + 1 < argc; ++i) {
+        if (0 == strcmp(argv[i], "--serve-spectators")) {
+            if (!w.startSpectatorServer(argv[i + 1])) {
+                fprintf(stderr, "Unable to listen for spectators on %s\n", argv[i + 1]);
+                return 1;
+            }
+
+        } else if (0 == strcmp(argv[i], "--spectate")) {
+            w.spectate(argv[i + 1]);
+        }
+    }
+
     w.show();
 
     return a.exec();
@@ -0,0 +1,73 @@
+//Available under GPL v3 license.
+//Author: Iouri Khramtsov.
+
+//This file contains the process-wide cache of parsed maps.
+
+#include "mapcache.h"
+#include <fstream>
+#include <iterator>
+#include <QFileInfo>
+#include "utils.h"
+
+QMutex MapCache::s_mutex;
+std::map<std::string, MapCache::Entry> MapCache::s_entries;
+std::map<quint64, MapCache::MapPointer> MapCache::s_contents;
+
+MapCache::MapPointer MapCache::getMap(const std::string &fileName, std::string *error) {
+    const QFileInfo fileInfo(QString::fromLocal8Bit(fileName.c_str()));
+    const QDateTime modified = fileInfo.lastModified();
+    const qint64 size = fileInfo.size();
+
+    {
+        QMutexLocker locker(&s_mutex);
+        std::map<std::string, Entry>::const_iterator it = s_entries.find(fileName);
+
+        if (s_entries.end() != it && it->second.modified == modified && it->second.size == size) {
+            return it->second.map;
+        }
+    }
+
+    //Read the file without holding up the games that use other maps.
+    std::ifstream mapFile(fileName.c_str());
+
+    if (mapFile.fail()) {
+        *error = "Unable to open the map file.";
+        return MapPointer();
+    }
+
+    const std::string mapString = std::string(std::istreambuf_iterator<char>(mapFile), std::istreambuf_iterator<char>());
+    const quint64 contentHash = HashBytes(mapString.data(), mapString.size());
+
+    MapPointer map;
+
+    {
+        QMutexLocker locker(&s_mutex);
+        std::map<quint64, MapPointer>::const_iterator it = s_contents.find(contentHash);
+
+        if (s_contents.end() != it) {
+            map = it->second;
+        }
+    }
+
+    if (map.isNull()) {
+        GameSnapshot* parsedMap = new GameSnapshot();
+
+        if (!ParseGameState(mapString, parsedMap, error)) {
+            delete parsedMap;
+            return MapPointer();
+        }
+
+        map = MapPointer(parsedMap);
+    }
+
+    //Another game may have parsed the same map in the meantime; either copy will do.
+    QMutexLocker locker(&s_mutex);
+    s_contents.insert(std::make_pair(contentHash, map));
+
+    Entry& entry = s_entries[fileName];
+    entry.modified = modified;
+    entry.size = size;
+    entry.map = map;
+
+    return map;
+}
@@ -0,0 +1,39 @@
+//Available under GPL v3 license.
+//Author: Iouri Khramtsov.
+
+//This file contains the process-wide cache of parsed maps.
+
+#ifndef MAPCACHE_H
+#define MAPCACHE_H
+
+#include <map>
+#include <string>
+#include <QDateTime>
+#include <QMutex>
+#include <QSharedPointer>
+#include "game.h"
+
+//Maps parsed once and shared by all the games in the process.  A map is looked up by its
+//path, and the file is only read again when its modification time or size changes; files
+//with the same contents share one parsed map.  The maps never change once parsed, so games
+//on any thread may copy from them at the same time.
+class MapCache {
+public:
+    typedef QSharedPointer<const GameSnapshot> MapPointer;
+
+    //Get a parsed map.  Return a null pointer and set the error if it can't be read or parsed.
+    static MapPointer getMap(const std::string& fileName, std::string* error);
+
+private:
+    struct Entry {
+        QDateTime modified;
+        qint64 size;
+        MapPointer map;
+    };
+
+    static QMutex s_mutex;
+    static std::map<std::string, Entry> s_entries;         //By path.
+    static std::map<quint64, MapPointer> s_contents;       //By the hash of the file's contents.
+};
+
+#endif // MAPCACHE_H
@@ -0,0 +1,244 @@
+//Available under GPL v3 license.
+//Author: Iouri Khramtsov.
+
+//This file contains the C interface of the engine library.
+
+#include "planetwars.h"
+#include <algorithm>
+#include <cstring>
+#include <new>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "rules.h"
+#include "utils.h"
+
+struct pw_game {
+    GameSnapshot state;
+    std::vector<std::vector<StagedOrder> > orders;     //By player id - 1, for the players in the map.
+    TurnEvents events;
+};
+
+namespace {
+
+//Copy a message into the caller's buffer, cutting it short if needed.
+void CopyError(const std::string& message, char* error, size_t errorSize) {
+    if (NULL == error || 0 == errorSize) {
+        return;
+    }
+
+    const size_t length = std::min(message.size(), errorSize - 1);
+    memcpy(error, message.data(), length);
+    error[length] = '\0';
+}
+
+//Check that the owners in a parsed map can play by the rules, and count the players.
+bool CheckOwners(const GameSnapshot& state, int* numPlayers, std::string* error) {
+    std::stringstream message;
+
+    for (size_t i = 0; i < state.planets.size(); ++i) {
+        const int owner = state.planets[i].owner;
+
+        if (owner < 0 || owner > MAX_NUM_PLAYERS) {
+            message << "Planet " << i << " has an invalid owner " << owner << ".";
+            *error = message.str();
+            return false;
+        }
+
+        *numPlayers = std::max(*numPlayers, owner);
+    }
+
+    for (size_t i = 0; i < state.fleets.size(); ++i) {
+        const FleetState& fleet = state.fleets[i];
+
+        if (fleet.owner < 1 || fleet.owner > MAX_NUM_PLAYERS) {
+            message << "Fleet " << i << " has an invalid owner " << fleet.owner << ".";
+            *error = message.str();
+            return false;
+        }
+
+        if (fleet.turnsRemaining < 1) {
+            message << "Fleet " << i << " has already arrived.";
+            *error = message.str();
+            return false;
+        }
+
+        *numPlayers = std::max(*numPlayers, fleet.owner);
+    }
+
+    return true;
+}
+
+}
+
+pw_game* pw_create_from_map(const char* map_text, char* error, size_t error_size) {
+    std::string message;
+    int numPlayers = 2;
+
+    if (NULL == map_text) {
+        CopyError("No map given.", error, error_size);
+        return NULL;
+    }
+
+    try {
+        pw_game* game = new pw_game;
+
+        if (!ParseGameState(map_text, &game->state, &message) || !CheckOwners(game->state, &numPlayers, &message)) {
+            CopyError(message, error, error_size);
+            delete game;
+            return NULL;
+        }
+
+        game->state.turn = 0;
+        game->orders.resize(numPlayers);
+        CopyError("", error, error_size);
+        return game;
+
+    } catch (const std::bad_alloc&) {
+        CopyError("Out of memory.", error, error_size);
+        return NULL;
+    }
+}
+
+void pw_destroy(pw_game* game) {
+    delete game;
+}
+
+int pw_set_orders(pw_game* game, int player_id, const char* orders, char* error, size_t error_size) {
+    if (player_id < 1 || player_id > MAX_NUM_PLAYERS) {
+        std::stringstream message;
+        message << "Player id " << player_id << " is out of range.";
+        CopyError(message.str(), error, error_size);
+        return -1;
+    }
+
+    //A player missing from the map owns no planets, so it can't give any orders.
+    const bool isInGame = player_id <= static_cast<int>(game->orders.size());
+
+    if (isInGame) {
+        game->orders[player_id - 1].clear();
+    }
+
+    if (NULL == orders) {
+        CopyError("", error, error_size);
+        return 0;
+    }
+
+    try {
+        const std::vector<PlanetState>& planets = game->state.planets;
+        const int numPlanets = static_cast<int>(planets.size());
+        std::vector<int> reservedShips(numPlanets, 0);
+        std::vector<StagedOrder> stagedOrders;
+        std::vector<std::string> lines = Tokenize(orders, "\n");
+
+        for (size_t i = 0; i < lines.size(); ++i) {
+            const std::string line = TrimSpaces(lines[i]);
+
+            if (line.empty() || '#' == line[0]) {
+                continue;
+
+            } else if ("go" == line) {
+                break;
+            }
+
+            //Check the order the way the engine checks the orders of the bots.
+            StagedOrder order;
+            std::string message;
+            bool isLegal = ParseOrder(line, &order, &message)
+                    && CheckOrderRoute(order, numPlanets, &message);
+
+            if (isLegal) {
+                const PlanetState& source = planets[order.sourceId];
+                const int availableShips = source.numShips - reservedShips[order.sourceId];
+                isLegal = CheckOrderShips(order, player_id, source.owner, availableShips, &message);
+            }
+
+            if (!isLegal) {
+                std::stringstream lineMessage;
+                lineMessage << "Error on line " << i + 1 << " of the orders.  " << message;
+                CopyError(lineMessage.str(), error, error_size);
+                return -1;
+            }
+
+            reservedShips[order.sourceId] += order.numShips;
+            stagedOrders.push_back(order);
+        }
+
+        if (isInGame) {
+            game->orders[player_id - 1].swap(stagedOrders);
+        }
+
+        CopyError("", error, error_size);
+        return 0;
+
+    } catch (const std::bad_alloc&) {
+        CopyError("Out of memory.", error, error_size);
+        return -1;
+    }
+}
+
+int pw_step(pw_game* game) {
+    try {
+        AdvanceGameState(game->orders, &game->state, &game->events);
+
+    } catch (const std::bad_alloc&) {
+        return -1;
+    }
+
+    for (size_t i = 0; i < game->orders.size(); ++i) {
+        game->orders[i].clear();
+    }
+
+    return 0;
+}
+
+int pw_get_turn(const pw_game* game) {
+    return game->state.turn;
+}
+
+int pw_get_planets(const pw_game* game, pw_planet* planets, int max_planets) {
+    const int numPlanets = static_cast<int>(game->state.planets.size());
+
+    for (int i = 0; i < numPlanets && i < max_planets; ++i) {
+        const PlanetState& planet = game->state.planets[i];
+        planets[i].x = planet.x;
+        planets[i].y = planet.y;
+        planets[i].owner = planet.owner;
+        planets[i].num_ships = planet.numShips;
+        planets[i].growth_rate = planet.growthRate;
+    }
+
+    return numPlanets;
+}
+
+int pw_get_fleets(const pw_game* game, pw_fleet* fleets, int max_fleets) {
+    const int numFleets = static_cast<int>(game->state.fleets.size());
+
+    for (int i = 0; i < numFleets && i < max_fleets; ++i) {
+        const FleetState& fleet = game->state.fleets[i];
+        fleets[i].owner = fleet.owner;
+        fleets[i].num_ships = fleet.numShips;
+        fleets[i].source_id = fleet.sourceId;
+        fleets[i].destination_id = fleet.destinationId;
+        fleets[i].total_trip_length = fleet.totalTripLength;
+        fleets[i].turns_remaining = fleet.turnsRemaining;
+    }
+
+    return numFleets;
+}
+
+size_t pw_format_state(const pw_game* game, char* text, size_t text_size) {
+    std::string state;
+
+    try {
+        state = FormatGameState(game->state);
+
+    } catch (const std::bad_alloc&) {
+        CopyError("", text, text_size);
+        return 0;
+    }
+
+    CopyError(state, text, text_size);
+    return state.size();
+}
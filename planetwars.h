@@ -0,0 +1,75 @@
+/*Available under GPL v3 license.
+  Author: Iouri Khramtsov.
+
+  This file contains the C interface of the engine library, for running games from other
+  programs and languages without Qt.  A game is made from a map, then played turn by turn:
+  set the orders of each player, step, and read the planets and fleets back.
+
+  The functions don't keep pointers to the caller's memory; a game may be used from any
+  thread, but only from one at a time. */
+
+#ifndef PLANETWARS_H
+#define PLANETWARS_H
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*Most players that can take part in one game.*/
+#define PW_MAX_PLAYERS 8
+
+typedef struct pw_game pw_game;
+
+typedef struct pw_planet {
+    double x;
+    double y;
+    int owner;              /*0 for neutral.*/
+    int num_ships;
+    int growth_rate;
+} pw_planet;
+
+typedef struct pw_fleet {
+    int owner;
+    int num_ships;
+    int source_id;
+    int destination_id;
+    int total_trip_length;
+    int turns_remaining;
+} pw_fleet;
+
+/*Make a game from the text of a map.  Return NULL on failure, describing the problem in
+  error (if given; it is always terminated).*/
+pw_game* pw_create_from_map(const char* map_text, char* error, size_t error_size);
+
+/*Free a game.*/
+void pw_destroy(pw_game* game);
+
+/*Set the orders of a player (1 to PW_MAX_PLAYERS) for the next step, replacing the ones
+  set before.  The orders are lines as bots print them: "<source> <destination> <num ships>";
+  comments are skipped and a "go" line ends them.  If any order is illegal, none of them are
+  kept; return -1 and describe the problem in error.  Return 0 otherwise.*/
+int pw_set_orders(pw_game* game, int player_id, const char* orders, char* error, size_t error_size);
+
+/*Play out one turn with the orders set, then clear them.  Return -1 if the game couldn't
+  be stepped (it ran out of memory), 0 otherwise.*/
+int pw_step(pw_game* game);
+
+/*Turns played so far.*/
+int pw_get_turn(const pw_game* game);
+
+/*Copy up to max_planets planets (by id) or max_fleets fleets into the caller's buffer.
+  Return the total number there is, which may be larger than the number copied.*/
+int pw_get_planets(const pw_game* game, pw_planet* planets, int max_planets);
+int pw_get_fleets(const pw_game* game, pw_fleet* fleets, int max_fleets);
+
+/*Write out the game state as it is sent to the bots, from the actual owner ids.  Return the
+  length of the text without the terminating 0; it is only complete if less than text_size.*/
+size_t pw_format_state(const pw_game* game, char* text, size_t text_size);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* PLANETWARS_H */
@@ -0,0 +1,96 @@
+//Available under GPL v3 license.
+//Author: Iouri Khramtsov.
+
+//This file contains the storage of the planet properties set by the bots.
+
+#include "properties.h"
+#include <deque>
+#include <map>
+#include <QMutex>
+#include <QMutexLocker>
+
+namespace {
+
+//The names are looked up from the engine and the display threads alike.  The table is made
+//on first use, so that names can be interned during static initialization as well.
+struct NameTable {
+    QMutex mutex;
+    std::map<std::string, int> ids;
+    std::deque<std::string> names;      //Adding names doesn't move the old ones.
+};
+
+NameTable& GetNameTable() {
+    static NameTable table;
+    return table;
+}
+
+}
+
+/*===================================================
+                Class PropertyNames.
+====================================================*/
+const int PropertyNames::MAX_NAMES;
+const size_t PropertyNames::MAX_NAME_LENGTH;
+const int PropertyNames::NO_NAME;
+
+int PropertyNames::intern(const std::string &name) {
+    NameTable& table = GetNameTable();
+    QMutexLocker locker(&table.mutex);
+
+    std::map<std::string, int>::const_iterator it = table.ids.find(name);
+
+    if (table.ids.end() != it) {
+        return it->second;
+    }
+
+    if (name.size() > MAX_NAME_LENGTH || static_cast<int>(table.names.size()) >= MAX_NAMES) {
+        return NO_NAME;
+    }
+
+    const int nameId = static_cast<int>(table.names.size());
+    table.names.push_back(name);
+    table.ids[name] = nameId;
+
+    return nameId;
+}
+
+const std::string& PropertyNames::getName(int nameId) {
+    NameTable& table = GetNameTable();
+    QMutexLocker locker(&table.mutex);
+
+    return table.names[nameId];
+}
+
+/*===================================================
+                Class PlanetProperties.
+====================================================*/
+bool PlanetProperties::set(int nameId, const std::string &value) {
+    const int numValues = static_cast<int>(m_values.size());
+
+    for (int i = 0; i < numValues; ++i) {
+        if (m_values[i].first == nameId) {
+            if (m_values[i].second == value) {
+                return false;
+            }
+
+            //Reuses the string's buffer when the new value fits in it.
+            m_values[i].second.assign(value);
+            return true;
+        }
+    }
+
+    m_values.push_back(std::make_pair(nameId, value));
+    return true;
+}
+
+const std::string* PlanetProperties::find(int nameId) const {
+    const int numValues = static_cast<int>(m_values.size());
+
+    for (int i = 0; i < numValues; ++i) {
+        if (m_values[i].first == nameId) {
+            return &m_values[i].second;
+        }
+    }
+
+    return NULL;
+}
@@ -0,0 +1,52 @@
+//Available under GPL v3 license.
+//Author: Iouri Khramtsov.
+
+//This file contains the storage of the planet properties set by the bots.
+
+#ifndef PROPERTIES_H
+#define PROPERTIES_H
+
+#include <cstddef>
+#include <string>
+#include <utility>
+#include <vector>
+
+//The process-wide table of property names.  Each name is stored once and known by a small
+//id from then on, which stays valid for the life of the process.  The names come from the
+//bots and are never dropped, so the table is capped: a bot making up a new name every turn
+//mustn't grow a long tournament without end.
+class PropertyNames {
+public:
+    static const int MAX_NAMES = 1024;
+    static const size_t MAX_NAME_LENGTH = 64;
+
+    //Returned for names that can't be added.
+    static const int NO_NAME = -1;
+
+    //Get the id of a name, adding the name if it's new.  Return NO_NAME if the name is
+    //too long, or new and the table is full.
+    static int intern(const std::string& name);
+
+    //Get the name with a given id.
+    static const std::string& getName(int nameId);
+};
+
+//The properties of one planet: a short list of values by name id, in the order the names
+//were first set.  Bots set a handful of properties at most, so a linear search beats a map.
+class PlanetProperties {
+public:
+    //Set a property.  Return false, without touching anything, if it already had that value.
+    bool set(int nameId, const std::string& value);
+
+    //Get the value of a property; NULL if it isn't set.
+    const std::string* find(int nameId) const;
+
+    int size() const                            {return static_cast<int>(m_values.size());}
+    int getNameId(int index) const              {return m_values[index].first;}
+    const std::string& getValue(int index) const {return m_values[index].second;}
+
+private:
+    std::vector<std::pair<int, std::string> > m_values;
+};
+
+#endif // PROPERTIES_H
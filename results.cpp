@@ -0,0 +1,584 @@
+//Available under GPL v3 license.
+//Author: Iouri Khramtsov.
+
+//This file contains the store of game results kept by the tournament and headless runners.
+
+#include "results.h"
+#include <algorithm>
+#include <climits>
+#include <cmath>
+#include <cstddef>
+#include <cstdio>
+#include <cstring>
+#include <sstream>
+#include "utils.h"
+
+#ifdef Q_OS_UNIX
+#include <cerrno>
+#include <sys/file.h>
+#endif
+
+namespace {
+
+const char RESULTS_MAGIC[8] = {'P', 'W', 'R', 'E', 'S', 'U', 'L', 'T'};
+const char RATINGS_MAGIC[8] = {'P', 'W', 'R', 'A', 'T', 'I', 'N', 'G'};
+const quint32 FORMAT_VERSION = 1;
+
+enum RecordType {
+    RECORD_BOT = 1,
+    RECORD_MAP = 2,
+    RECORD_GAME = 3,
+    RECORD_TURN_HASHES = 4      //quint64 hashes of the turns of the preceding game.
+};
+
+struct FileHeader {
+    char magic[8];
+    quint32 version;
+    quint32 reserved;
+};
+
+struct RecordHeader {
+    quint32 type;
+    quint32 size;           //Size of the payload, padding included.
+};
+
+//Size of the game records in the first version of the format.
+const size_t MIN_GAME_RECORD_SIZE = offsetof(GameRecord, adjudication);
+
+struct RatingsHeader {
+    char magic[8];
+    quint32 version;
+    quint32 numBots;
+    quint64 numGames;       //Number of games the ratings cover.
+};
+
+//Rating parameters.
+const double INITIAL_RATING = 1500.0;
+const double ELO_K = 32.0;
+const double GLICKO_MAX_DEVIATION = 350.0;
+const double GLICKO_MIN_DEVIATION = 30.0;
+const double GLICKO_DRIFT = 15.0;           //Growth of the deviation between two games of a bot.
+const double PI = 3.14159265358979323846;
+
+Rating NewRating() {
+    Rating rating;
+    rating.elo = INITIAL_RATING;
+    rating.glicko = INITIAL_RATING;
+    rating.glickoDeviation = GLICKO_MAX_DEVIATION;
+    rating.numGames = 0;
+    rating.numWins = 0;
+    rating.numDraws = 0;
+    rating.numFailures = 0;
+    return rating;
+}
+
+//Holds an exclusive lock on an open file while it lives, so that the runners sharing a
+//results file take turns reading and appending to it.
+class FileLock {
+public:
+    explicit FileLock(int handle)
+        :m_handle(handle) {
+#ifdef Q_OS_UNIX
+        while (0 != flock(m_handle, LOCK_EX) && EINTR == errno) {
+        }
+#endif
+    }
+
+    ~FileLock() {
+#ifdef Q_OS_UNIX
+        flock(m_handle, LOCK_UN);
+#endif
+    }
+
+private:
+    int m_handle;
+};
+
+//Add a record to a buffer.
+void AppendRecord(QByteArray* output, RecordType type, const void* payload, int size) {
+    RecordHeader header;
+    header.type = type;
+    header.size = (size + 7) & ~7;
+
+    output->append(reinterpret_cast<const char*>(&header), sizeof(header));
+    output->append(reinterpret_cast<const char*>(payload), size);
+    output->append(QByteArray(header.size - size, '\0'));
+}
+
+qint32 ClampToInt(qint64 value) {
+    return static_cast<qint32>(std::min<qint64>(value, INT_MAX));
+}
+
+//Update the ratings of the bots in a game.  Each pair of bots is scored as a game of its own:
+//the winner beats everyone, bots that failed lose to everyone, and the rest are ranked by
+//the ships they have left.  Games cut short without anyone to blame don't count.
+void UpdateRatings(const GameRecord& record, std::vector<Rating>* ratings) {
+    const int numPlayers = std::min<int>(record.numPlayers, PlanetWarsGame::MAX_PLAYERS);
+    bool hasFailure = false;
+
+    std::vector<qint64> scores(numPlayers);
+
+    for (int i = 0; i < numPlayers; ++i) {
+        if (Player::NO_FAILURE != record.failures[i]) {
+            scores[i] = -1;
+            hasFailure = true;
+
+        } else if (record.winner == i + 1) {
+            scores[i] = LLONG_MAX;
+
+        } else {
+            scores[i] = record.ships[i];
+        }
+    }
+
+    if (numPlayers < 2 || (record.winner < 0 && !hasFailure)) {
+        return;
+    }
+
+    //Work out the changes from the ratings before the game.
+    std::vector<Rating> before(numPlayers);
+    std::vector<double> deviations(numPlayers);
+
+    for (int i = 0; i < numPlayers; ++i) {
+        before[i] = (*ratings)[record.botIds[i]];
+
+        const double deviation = before[i].glickoDeviation;
+        deviations[i] = std::min(sqrt(deviation * deviation + GLICKO_DRIFT * GLICKO_DRIFT), GLICKO_MAX_DEVIATION);
+    }
+
+    const double q = log(10.0) / 400.0;
+    const qint64 bestScore = *std::max_element(scores.begin(), scores.end());
+    const int numBest = static_cast<int>(std::count(scores.begin(), scores.end(), bestScore));
+
+    for (int i = 0; i < numPlayers; ++i) {
+        double eloChange = 0;
+        double glickoVariance = 0;      //1/d^2 in Glickman's notation.
+        double glickoSum = 0;
+
+        for (int j = 0; j < numPlayers; ++j) {
+            if (i == j) {
+                continue;
+            }
+
+            const double score = (scores[i] > scores[j]) ? 1.0 : ((scores[i] == scores[j]) ? 0.5 : 0.0);
+
+            const double eloExpected = 1.0 / (1.0 + pow(10.0, (before[j].elo - before[i].elo) / 400.0));
+            eloChange += ELO_K / (numPlayers - 1) * (score - eloExpected);
+
+            const double g = 1.0 / sqrt(1.0 + 3.0 * q * q * deviations[j] * deviations[j] / (PI * PI));
+            const double glickoExpected = 1.0 / (1.0 + pow(10.0, -g * (before[i].glicko - before[j].glicko) / 400.0));
+            glickoVariance += q * q * g * g * glickoExpected * (1.0 - glickoExpected);
+            glickoSum += g * (score - glickoExpected);
+        }
+
+        const double precision = 1.0 / (deviations[i] * deviations[i]) + glickoVariance;
+
+        Rating& rating = (*ratings)[record.botIds[i]];
+        rating.elo += eloChange;
+        rating.glicko = before[i].glicko + q / precision * glickoSum;
+        rating.glickoDeviation = std::max(sqrt(1.0 / precision), GLICKO_MIN_DEVIATION);
+
+        ++rating.numGames;
+
+        if (scores[i] < 0) {
+            ++rating.numFailures;
+
+        } else if (scores[i] == bestScore) {
+            if (1 == numBest) {
+                ++rating.numWins;
+            } else {
+                ++rating.numDraws;
+            }
+        }
+    }
+}
+
+}
+
+/*===================================================
+                Struct GameResult.
+====================================================*/
+GameResult::GameResult()
+    :winner(-1), numTurns(0), adjudication(PlanetWarsGame::NOT_ADJUDICATED) {
+}
+
+void GetGameResult(const PlanetWarsGame& game, GameResult* result) {
+    const std::vector<int> ships = game.getShipCounts();
+
+    result->mapFileName = game.getMapFileName();
+    result->winner = game.getWinner();
+    result->numTurns = game.getTurn();
+    result->adjudication = game.getAdjudication();
+    result->turnHashes = game.getTurnHashes();
+    result->bots.clear();
+    result->ships.clear();
+    result->stats.clear();
+    result->failures.clear();
+
+    for (int i = 1; i <= game.getNumPlayers(); ++i) {
+        const Player* player = game.getPlayer(i);
+        result->bots.push_back(player->getLaunchCommand());
+        result->ships.push_back(ships[i]);
+        result->stats.push_back(player->getStats());
+        result->failures.push_back(player->getFailure());
+    }
+}
+
+quint64 MakeGameKey(const std::string& description) {
+    const quint64 hash = HashBytes(description.data(), description.size());
+    return (0 == hash) ? 1 : hash;
+}
+
+/*===================================================
+                Class ResultsStore.
+====================================================*/
+ResultsStore::ResultsStore()
+    :m_scannedSize(0), m_numGames(0) {
+}
+
+bool ResultsStore::open(const std::string& fileName, std::string* error) {
+    m_file.setFileName(QString::fromLocal8Bit(fileName.c_str()));
+    m_ratingsFileName = fileName + ".ratings";
+
+    if (!m_file.open(QIODevice::ReadWrite)) {
+        *error = "Unable to open the results file " + fileName;
+        return false;
+    }
+
+    FileLock lock(m_file.handle());
+    const quint64 numRatedGames = this->loadRatings();
+
+    if (!this->readRecords(numRatedGames, error)) {
+        return false;
+    }
+
+    //Saved ratings that don't match the log (e.g. left from an older file) are worked out again.
+    if (numRatedGames > m_numGames || m_ratings.size() != m_bots.size()) {
+        m_ratings.clear();
+
+        if (!this->readRecords(0, error)) {
+            return false;
+        }
+    }
+
+    if (numRatedGames != m_numGames) {
+        this->saveRatings();
+    }
+
+    return true;
+}
+
+bool ResultsStore::readRecords(quint64 numRatedGames, std::string* error) {
+    m_numGames = 0;
+    m_scannedSize = 0;
+    m_bots.clear();
+    m_maps.clear();
+    m_botIds.clear();
+    m_mapIds.clear();
+    m_keys.clear();
+
+    FileHeader header;
+    const qint64 fileSize = m_file.size();
+
+    if (0 == fileSize) {
+        memset(&header, 0, sizeof(header));
+        memcpy(header.magic, RESULTS_MAGIC, sizeof(header.magic));
+        header.version = FORMAT_VERSION;
+
+        if (sizeof(header) != m_file.write(reinterpret_cast<const char*>(&header), sizeof(header)) || !m_file.flush()) {
+            *error = "Unable to write the results file.";
+            return false;
+        }
+
+        m_scannedSize = sizeof(header);
+        return true;
+    }
+
+    if (fileSize < static_cast<qint64>(sizeof(header))
+        || !m_file.seek(0)
+        || sizeof(header) != m_file.read(reinterpret_cast<char*>(&header), sizeof(header))) {
+        *error = "Not a results file.";
+        return false;
+    }
+
+    if (0 != memcmp(header.magic, RESULTS_MAGIC, sizeof(header.magic)) || FORMAT_VERSION != header.version) {
+        *error = "Not a results file, or one written by a different version.";
+        return false;
+    }
+
+    m_scannedSize = sizeof(header);
+    return this->readNewRecords(numRatedGames, error);
+}
+
+bool ResultsStore::readNewRecords(quint64 numRatedGames, std::string* error) {
+    const qint64 fileSize = m_file.size();
+
+    if (fileSize < m_scannedSize) {
+        *error = "The results file has been cut short by another program.";
+        return false;
+
+    } else if (fileSize == m_scannedSize) {
+        return true;
+    }
+
+    const qint64 size = fileSize - m_scannedSize;
+    const uchar* data = m_file.map(m_scannedSize, size);
+
+    if (NULL == data) {
+        *error = "Unable to map the results file into memory.";
+        return false;
+    }
+
+    qint64 offset = 0;
+    bool isValid = true;
+
+    while (isValid && offset + static_cast<qint64>(sizeof(RecordHeader)) <= size) {
+        RecordHeader recordHeader;
+        memcpy(&recordHeader, data + offset, sizeof(recordHeader));
+
+        const qint64 end = offset + sizeof(recordHeader) + recordHeader.size;
+
+        if (end > size) {
+            break;
+        }
+
+        const char* payload = reinterpret_cast<const char*>(data + offset + sizeof(recordHeader));
+
+        if (RECORD_BOT == recordHeader.type || RECORD_MAP == recordHeader.type) {
+            //Names are zero-terminated within their padding.
+            const std::string name(payload, strnlen(payload, recordHeader.size));
+
+            if (RECORD_BOT == recordHeader.type) {
+                m_botIds[name] = static_cast<quint32>(m_bots.size());
+                m_bots.push_back(name);
+
+                if (m_ratings.size() < m_bots.size()) {
+                    m_ratings.push_back(NewRating());
+                }
+
+            } else {
+                m_mapIds[name] = static_cast<quint32>(m_maps.size());
+                m_maps.push_back(name);
+            }
+
+        } else if (RECORD_GAME == recordHeader.type) {
+            GameRecord record;
+            isValid = (recordHeader.size >= MIN_GAME_RECORD_SIZE);
+
+            if (isValid) {
+                memset(&record, 0, sizeof(record));
+                memcpy(&record, payload, std::min<size_t>(recordHeader.size, sizeof(record)));
+                isValid = (record.numPlayers <= PlanetWarsGame::MAX_PLAYERS);
+            }
+
+            for (quint32 i = 0; isValid && i < record.numPlayers; ++i) {
+                isValid = (record.botIds[i] < m_bots.size());
+            }
+
+            if (!isValid) {
+                break;
+            }
+
+            if (0 != record.key) {
+                m_keys.insert(record.key);
+            }
+
+            if (m_numGames >= numRatedGames) {
+                UpdateRatings(record, &m_ratings);
+            }
+
+            ++m_numGames;
+        }
+
+        //Records of unknown types are skipped.
+        offset = end;
+    }
+
+    m_file.unmap(const_cast<uchar*>(data));
+    m_scannedSize += offset;
+
+    //A complete record that makes no sense is damage; the games after it are kept.
+    if (!isValid) {
+        std::stringstream message;
+        message << "The results file has a damaged game record at offset " << m_scannedSize << ".";
+        *error = message.str();
+        return false;
+    }
+
+    //Drop what's left of a record that was being written when a runner stopped.  Runners
+    //write under the lock, so nobody else is in the middle of writing it.
+    if (m_scannedSize < fileSize && !m_file.resize(m_scannedSize)) {
+        *error = "Unable to drop an incomplete record from the results file.";
+        return false;
+    }
+
+    return true;
+}
+
+bool ResultsStore::append(const GameResult& result, quint64 key, std::string* error) {
+    //Other runners may have added bots, maps and games since we last looked; the ids
+    //are given out in the order of the file, so catch up before giving out new ones.
+    FileLock lock(m_file.handle());
+
+    if (!this->readNewRecords(m_numGames, error)) {
+        return false;
+    }
+
+    const size_t numBots = m_bots.size();
+    const size_t numMaps = m_maps.size();
+
+    QByteArray output;
+
+    GameRecord record;
+    memset(&record, 0, sizeof(record));
+    record.key = key;
+    record.mapId = this->getMapId(result.mapFileName, &output);
+    record.numTurns = result.numTurns;
+    record.winner = result.winner;
+    record.numPlayers = std::min<int>(result.bots.size(), PlanetWarsGame::MAX_PLAYERS);
+    record.adjudication = static_cast<quint8>(result.adjudication);
+    record.finalHash = result.turnHashes.empty() ? 0 : result.turnHashes.back();
+
+    for (quint32 i = 0; i < record.numPlayers; ++i) {
+        const PlayerStats& stats = result.stats[i];
+
+        record.botIds[i] = this->getBotId(result.bots[i], &output);
+        record.ships[i] = result.ships[i];
+        record.totalCpuMs[i] = ClampToInt(stats.totalCpuMs);
+        record.maxTurnCpuMs[i] = ClampToInt(stats.maxTurnCpuMs);
+        record.totalWallMs[i] = ClampToInt(stats.totalWallMs);
+        record.maxTurnWallMs[i] = ClampToInt(stats.maxTurnWallMs);
+        record.peakRssKb[i] = ClampToInt(stats.peakRssKb);
+        record.failures[i] = static_cast<quint8>(result.failures[i]);
+    }
+
+    AppendRecord(&output, RECORD_GAME, &record, sizeof(record));
+
+    if (!result.turnHashes.empty()) {
+        AppendRecord(&output, RECORD_TURN_HASHES, &result.turnHashes[0],
+                     static_cast<int>(result.turnHashes.size() * sizeof(quint64)));
+    }
+
+    //Write the new names and the game at once, so that a crash can only cut off the end.
+    const qint64 fileSize = m_file.size();
+
+    if (!m_file.seek(fileSize) || output.size() != m_file.write(output) || !m_file.flush()) {
+        m_file.resize(fileSize);
+
+        for (size_t i = numBots; i < m_bots.size(); ++i) {
+            m_botIds.erase(m_bots[i]);
+        }
+
+        for (size_t i = numMaps; i < m_maps.size(); ++i) {
+            m_mapIds.erase(m_maps[i]);
+        }
+
+        m_bots.resize(numBots);
+        m_ratings.resize(numBots);
+        m_maps.resize(numMaps);
+
+        *error = "Unable to write the results file.";
+        return false;
+    }
+
+    m_scannedSize = fileSize + output.size();
+
+    if (0 != key) {
+        m_keys.insert(key);
+    }
+
+    UpdateRatings(record, &m_ratings);
+    ++m_numGames;
+
+    this->saveRatings();
+    return true;
+}
+
+quint32 ResultsStore::getBotId(const std::string& name, QByteArray* output) {
+    std::map<std::string, quint32>::const_iterator it = m_botIds.find(name);
+
+    if (m_botIds.end() != it) {
+        return it->second;
+    }
+
+    const quint32 id = static_cast<quint32>(m_bots.size());
+    m_botIds[name] = id;
+    m_bots.push_back(name);
+    m_ratings.push_back(NewRating());
+
+    AppendRecord(output, RECORD_BOT, name.c_str(), static_cast<int>(name.size()) + 1);
+    return id;
+}
+
+quint32 ResultsStore::getMapId(const std::string& name, QByteArray* output) {
+    std::map<std::string, quint32>::const_iterator it = m_mapIds.find(name);
+
+    if (m_mapIds.end() != it) {
+        return it->second;
+    }
+
+    const quint32 id = static_cast<quint32>(m_maps.size());
+    m_mapIds[name] = id;
+    m_maps.push_back(name);
+
+    AppendRecord(output, RECORD_MAP, name.c_str(), static_cast<int>(name.size()) + 1);
+    return id;
+}
+
+quint64 ResultsStore::loadRatings() {
+    m_ratings.clear();
+
+    FILE* file = fopen(m_ratingsFileName.c_str(), "rb");
+
+    if (NULL == file) {
+        return 0;
+    }
+
+    RatingsHeader header;
+    bool isValid = (1 == fread(&header, sizeof(header), 1, file))
+                   && 0 == memcmp(header.magic, RATINGS_MAGIC, sizeof(header.magic))
+                   && FORMAT_VERSION == header.version;
+
+    if (isValid) {
+        m_ratings.resize(header.numBots);
+        isValid = (0 == header.numBots) || (header.numBots == fread(&m_ratings[0], sizeof(Rating), header.numBots, file));
+    }
+
+    fclose(file);
+
+    if (!isValid) {
+        m_ratings.clear();
+        return 0;
+    }
+
+    return header.numGames;
+}
+
+void ResultsStore::saveRatings() {
+    RatingsHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, RATINGS_MAGIC, sizeof(header.magic));
+    header.version = FORMAT_VERSION;
+    header.numBots = static_cast<quint32>(m_ratings.size());
+    header.numGames = m_numGames;
+
+    //Replace the old file in one step, so that it always matches some prefix of the log.
+    const std::string temporaryFileName = m_ratingsFileName + ".tmp";
+    FILE* file = fopen(temporaryFileName.c_str(), "wb");
+
+    if (NULL == file) {
+        return;
+    }
+
+    bool isWritten = (1 == fwrite(&header, sizeof(header), 1, file));
+
+    if (isWritten && !m_ratings.empty()) {
+        isWritten = (m_ratings.size() == fwrite(&m_ratings[0], sizeof(Rating), m_ratings.size(), file));
+    }
+
+    if (0 == fclose(file) && isWritten) {
+        rename(temporaryFileName.c_str(), m_ratingsFileName.c_str());
+    } else {
+        remove(temporaryFileName.c_str());
+    }
+}
@@ -0,0 +1,131 @@
+//Available under GPL v3 license.
+//Author: Iouri Khramtsov.
+
+//This file contains the store of game results kept by the tournament and headless runners.
+
+#ifndef RESULTS_H
+#define RESULTS_H
+
+#include <map>
+#include <string>
+#include <vector>
+#include <QFile>
+#include <QSet>
+#include "game.h"
+
+//The outcome of one game, as the runners see it.
+struct GameResult {
+    GameResult();
+
+    std::string mapFileName;
+    std::vector<std::string> bots;          //Launch commands; bot i is player i + 1.
+    int winner;                             //Player number; 0 for a draw, -1 if the game didn't finish.
+    int numTurns;
+    PlanetWarsGame::Adjudication adjudication;
+    std::vector<quint64> turnHashes;        //State hash at the end of each turn, from the map on.
+    std::vector<int> ships;                 //Ships left at the end, per bot.
+    std::vector<PlayerStats> stats;
+    std::vector<Player::Failure> failures;
+};
+
+//Collect the outcome of a game that has stopped.
+void GetGameResult(const PlanetWarsGame& game, GameResult* result);
+
+//Make the key a tournament game is recorded under out of a description of the game.  Never 0.
+quint64 MakeGameKey(const std::string& description);
+
+//One game as it's kept in the results file.  The layout is fixed, in the machine's byte order,
+//so that the file can be mapped into memory and read in place.
+struct GameRecord {
+    quint64 key;                    //Identifies the game in a tournament; 0 if it wasn't part of one.
+    quint32 mapId;
+    quint32 numTurns;
+    qint32 winner;
+    quint32 numPlayers;
+    quint32 botIds[PlanetWarsGame::MAX_PLAYERS];
+    qint32 ships[PlanetWarsGame::MAX_PLAYERS];
+    qint32 totalCpuMs[PlanetWarsGame::MAX_PLAYERS];    //-1 if unknown.
+    qint32 maxTurnCpuMs[PlanetWarsGame::MAX_PLAYERS];
+    qint32 totalWallMs[PlanetWarsGame::MAX_PLAYERS];
+    qint32 maxTurnWallMs[PlanetWarsGame::MAX_PLAYERS];
+    qint32 peakRssKb[PlanetWarsGame::MAX_PLAYERS];     //-1 if unknown.
+    quint8 failures[PlanetWarsGame::MAX_PLAYERS];      //Player::Failure.
+    quint8 adjudication;                               //PlanetWarsGame::Adjudication.
+    quint8 reserved[7];
+    quint64 finalHash;                                 //State hash at the end of the game.
+};
+
+//Ratings of one bot.
+struct Rating {
+    double elo;
+    double glicko;
+    double glickoDeviation;
+    int numGames;
+    int numWins;            //Games in which the bot finished first on its own.
+    int numDraws;           //Games in which it shared the first place.
+    int numFailures;        //Games in which it crashed, timed out or sent illegal orders.
+};
+
+//An append-only log of game results with the ratings of the bots in it.
+//
+//The file holds a header followed by records, each a type and a size followed by the
+//payload padded to 8 bytes.  Bot and map records hold a name, and get ids in the order
+//they appear; game records hold a GameRecord referring to those ids, and may be followed by
+//a record of the state hash of every turn of the game.  A record cut short
+//by a crash is dropped when the file is opened again.  Game records written before fields
+//were added at the end of GameRecord are shorter, and read with those fields zeroed.
+//
+//Several runners may share a file: each takes a lock on it to append, and first reads the
+//records the others have added.
+//
+//The ratings are brought up to date with every game added, and saved next to the log
+//(<file>.ratings) together with the number of games they cover, so that opening the
+//store only goes through the games added since.
+class ResultsStore {
+public:
+    ResultsStore();
+
+    //Open or create a results file.  Return false and set the error if it can't be used.
+    bool open(const std::string& fileName, std::string* error);
+
+    //Add a game.  The key ties the game to its place in a tournament (0 for none).
+    bool append(const GameResult& result, quint64 key, std::string* error);
+
+    //Check whether a game of a tournament has been recorded already.
+    bool contains(quint64 key) const        {return m_keys.contains(key);}
+
+    int getNumGames() const                 {return static_cast<int>(m_numGames);}
+
+    //Bots and their ratings, by bot id.
+    const std::vector<std::string>& getBots() const     {return m_bots;}
+    const std::vector<Rating>& getRatings() const       {return m_ratings;}
+
+private:
+    //Go through the records of the file; drop an incomplete one at the end.
+    bool readRecords(quint64 numRatedGames, std::string* error);
+
+    //Go through the records added since the last look, e.g. by another runner.
+    bool readNewRecords(quint64 numRatedGames, std::string* error);
+
+    //Read and write the saved ratings.  Return the number of games they cover.
+    quint64 loadRatings();
+    void saveRatings();
+
+    //Get the id of a bot or a map, adding a record for a new one to the output.
+    quint32 getBotId(const std::string& name, QByteArray* output);
+    quint32 getMapId(const std::string& name, QByteArray* output);
+
+    QFile m_file;
+    qint64 m_scannedSize;       //Size of the part of the file that has been read.
+    std::string m_ratingsFileName;
+    quint64 m_numGames;
+
+    std::vector<std::string> m_bots;
+    std::vector<std::string> m_maps;
+    std::map<std::string, quint32> m_botIds;
+    std::map<std::string, quint32> m_mapIds;
+    std::vector<Rating> m_ratings;
+    QSet<quint64> m_keys;
+};
+
+#endif // RESULTS_H
@@ -0,0 +1,416 @@
+//Available under GPL v3 license.
+//Author: Iouri Khramtsov.
+
+//This file contains the rules of the game on plain game states.
+
+#include "rules.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <sstream>
+
+#include "utils.h"
+
+/*===================================================
+                Game state parsing.
+====================================================*/
+bool ParseGameState(const std::string &text, GameSnapshot *state, std::string *error) {
+    state->turn = 0;
+    state->planets.clear();
+    state->fleets.clear();
+
+    //Lines on which we find fleets.
+    std::vector<size_t> fleetLines;
+
+    //Process each line, reading the fleet and planet information from respective lines.
+    std::vector<std::string> lines = Tokenize(text, "\n");
+
+    for (size_t i = 0; i < lines.size(); ++i) {
+        std::string& line = lines[i];
+
+        //Remove comments.
+        size_t commentBegin = line.find('#');
+
+        if (commentBegin != std::string::npos)
+            line = line.substr(0, commentBegin);
+
+        if (TrimSpaces(line).size() == 0) continue;
+
+        //Split the line into individual elements.
+        std::vector<std::string> tokens = Tokenize(line, " \r");
+
+        if (tokens.size() == 0) continue;
+
+        if (tokens[0] == "P") {
+            //Record a planet.
+            if (tokens.size() != 6) {
+                std::stringstream message;
+                message <<"Map file error [line " << i
+                        << "]: expected 6 tokens on a planet line, have " << tokens.size() <<".";
+                *error = message.str();
+                return false;
+            }
+
+            PlanetState planet;
+            planet.x = atof(tokens[1].c_str());
+            planet.y = atof(tokens[2].c_str());
+            planet.owner = atoi(tokens[3].c_str());
+            planet.numShips = atoi(tokens[4].c_str());
+            planet.growthRate = atoi(tokens[5].c_str());
+
+            state->planets.push_back(planet);
+
+        } else if (tokens[0] == "F") {
+            //Record a fleet.
+            if (tokens.size() != 7) {
+                std::stringstream message;
+                message <<"Map file error [line " << i
+                        << "]: expected 7 tokens on a fleet line, have " << tokens.size() <<".";
+                *error = message.str();
+                return false;
+            }
+
+            FleetState fleet;
+            fleet.owner = atoi(tokens[1].c_str());
+            fleet.numShips = atoi(tokens[2].c_str());
+            fleet.sourceId = atoi(tokens[3].c_str());
+            fleet.destinationId = atoi(tokens[4].c_str());
+            fleet.totalTripLength = atoi(tokens[5].c_str());
+            fleet.turnsRemaining = atoi(tokens[6].c_str());
+
+            state->fleets.push_back(fleet);
+            fleetLines.push_back(i);
+
+        } else if (tokens[0] == "go" && 1 == tokens.size()) {
+            //End of a game state message; nothing more to read.
+            break;
+
+        } else {
+            std::stringstream message;
+            message << "Map file error [line " << i
+                    << "]: a non-empty line that does not contain a planet or a fleet.";
+            *error = message.str();
+            return false;
+        }
+    }
+
+    //Check the planet references inside fleets.
+    const int numPlanets = static_cast<int>(state->planets.size());
+    const int numFleets = static_cast<int>(state->fleets.size());
+
+    for (int i = 0; i < numFleets; ++i) {
+        const FleetState& fleet = state->fleets[i];
+        int badPlanetId = -1;
+
+        if (fleet.sourceId < 0 || fleet.sourceId >= numPlanets) {
+            badPlanetId = fleet.sourceId;
+
+        } else if (fleet.destinationId < 0 || fleet.destinationId >= numPlanets) {
+            badPlanetId = fleet.destinationId;
+        }
+
+        if (-1 != badPlanetId) {
+            std::stringstream message;
+            message << "Map file error [line " << fleetLines[i]
+                    << "]: fleet refers to an invalid planet with id=" << badPlanetId << ".";
+            *error = message.str();
+            return false;
+        }
+    }
+
+    return true;
+}
+
+std::string FormatGameState(const GameSnapshot &state) {
+    std::stringstream gameState;
+
+    for (size_t i = 0; i < state.planets.size(); ++i) {
+        const PlanetState& planet = state.planets[i];
+        gameState << "P " << planet.x
+                << " " << planet.y
+                << " " << planet.owner
+                << " " << planet.numShips
+                << " " << planet.growthRate
+                << std::endl;
+    }
+
+    for (size_t i = 0; i < state.fleets.size(); ++i) {
+        const FleetState& fleet = state.fleets[i];
+        gameState << "F " << fleet.owner
+                << " " << fleet.numShips
+                << " " << fleet.sourceId
+                << " " << fleet.destinationId
+                << " " << fleet.totalTripLength
+                << " " << fleet.turnsRemaining
+                << std::endl;
+    }
+
+    gameState << "go" << std::endl;
+
+    return gameState.str();
+}
+
+bool ParseReplay(const std::string &text, std::vector<GameSnapshot> *states, std::string *error) {
+    states->clear();
+
+    //Each game state ends with a "go" line, just like the messages sent to the bots.
+    std::vector<std::string> lines = Tokenize(text, "\n");
+    std::string block;
+
+    for (size_t i = 0; i <= lines.size(); ++i) {
+        const bool isEnd = (i == lines.size());
+
+        if (!isEnd && TrimSpaces(lines[i]) != "go") {
+            block.append(lines[i]).append("\n");
+            continue;
+        }
+
+        if (TrimSpaces(block).size() != 0) {
+            GameSnapshot state;
+
+            if (!ParseGameState(block, &state, error)) {
+                std::stringstream message;
+                message << "Replay turn " << states->size() << ": " << *error;
+                *error = message.str();
+                return false;
+            }
+
+            state.turn = static_cast<int>(states->size());
+            states->push_back(state);
+        }
+
+        block.clear();
+    }
+
+    return true;
+}
+
+/*===================================================
+                Orders.
+====================================================*/
+int GetTripLength(double sourceX, double sourceY, double destinationX, double destinationY) {
+    const double dx = destinationX - sourceX;
+    const double dy = destinationY - sourceY;
+    const int distance = static_cast<int>(ceil(sqrt(dx*dx + dy*dy)));
+    return distance;
+}
+
+bool ParseOrder(const std::string &line, StagedOrder *order, std::string *error) {
+    std::vector<std::string> tokens = Tokenize(line, " ");
+
+    if (3 != tokens.size()) {
+        std::stringstream message;
+        message << "Expected 3 tokens on a move order line, have " << tokens.size() << ".";
+        *error = message.str();
+        return false;
+    }
+
+    order->sourceId = atoi(tokens[0].c_str());
+    order->destinationId = atoi(tokens[1].c_str());
+    order->numShips = atoi(tokens[2].c_str());
+    return true;
+}
+
+bool CheckOrderRoute(const StagedOrder &order, int numPlanets, std::string *error) {
+    std::stringstream message;
+
+    if (order.sourceId < 0 || order.sourceId >= numPlanets) {
+        message << "Source planet " << order.sourceId << " does not exist.";
+
+    } else if (order.destinationId < 0 || order.destinationId >= numPlanets) {
+        message << "Destination planet " << order.destinationId << " does not exist.";
+
+    } else if (order.sourceId == order.destinationId) {
+        message << "Source planet and destination planet are the same.";
+
+    } else {
+        return true;
+    }
+
+    *error = message.str();
+    return false;
+}
+
+bool CheckOrderShips(const StagedOrder &order, int playerId, int sourceOwner, int availableShips,
+                     std::string *error) {
+    std::stringstream message;
+
+    if (sourceOwner != playerId) {
+        message << "Source planet " << order.sourceId << " does not belong to this player.";
+
+    } else if (order.numShips > availableShips || order.numShips < 0) {
+        message << "Cannot send " << order.numShips << " ships from planet " << order.sourceId
+                << ".  Planet has " << availableShips << " ships.";
+
+    } else {
+        return true;
+    }
+
+    *error = message.str();
+    return false;
+}
+
+/*===================================================
+                Turns.
+====================================================*/
+bool IsStranded(const GameSnapshot &state, int playerId) {
+    const int numPlanets = static_cast<int>(state.planets.size());
+
+    for (int i = 0; i < numPlanets; ++i) {
+        if (state.planets[i].owner == playerId) {
+            return false;
+        }
+    }
+
+    //Count the defenders as few as they can be.  A neutral planet keeps its ships, but a
+    //player may send every ship off its planet before the fleets land; only the ones grown
+    //that turn are sure to be there, since ships leave before the planets grow.  Either way,
+    //every fleet of a third player that's headed for the planet may take some of them out.
+    std::vector<int> attacks(numPlanets, 0);
+    std::vector<bool> isAttacked(numPlanets, false);
+    std::vector<int> defenders(numPlanets);
+
+    for (int i = 0; i < numPlanets; ++i) {
+        const PlanetState& planet = state.planets[i];
+        defenders[i] = (0 == planet.owner) ? planet.numShips : planet.growthRate;
+    }
+
+    for (size_t i = 0; i < state.fleets.size(); ++i) {
+        const FleetState& fleet = state.fleets[i];
+        const int destinationId = fleet.destinationId;
+
+        if (fleet.owner == playerId) {
+            attacks[destinationId] += fleet.numShips;
+            isAttacked[destinationId] = true;
+
+        } else if (fleet.owner != state.planets[destinationId].owner) {
+            defenders[destinationId] -= fleet.numShips;
+        }
+    }
+
+    //On a tie, the defenders keep the planet.
+    for (int i = 0; i < numPlanets; ++i) {
+        if (isAttacked[i] && attacks[i] > defenders[i]) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+namespace {
+
+//Play out a turn in a game of NUM_PLAYERS players, so that the battles are resolved by the
+//version of ResolveBattle() made for that number of owners.
+template <int NUM_PLAYERS>
+void AdvanceGameStateFor(const std::vector<std::vector<StagedOrder> >& orders, GameSnapshot* state,
+                         TurnEvents* events) {
+    const int NUM_OWNERS = NUM_PLAYERS + 1;
+
+    std::vector<PlanetState>& planets = state->planets;
+    std::vector<FleetState>& fleets = state->fleets;
+    const int numPlanets = static_cast<int>(planets.size());
+
+    ++state->turn;
+    events->launchedFleets.clear();
+    events->landedFleets.clear();
+
+    //Send out the new fleets, player by player.
+    for (size_t i = 0; i < orders.size(); ++i) {
+        for (size_t j = 0; j < orders[i].size(); ++j) {
+            const StagedOrder& order = orders[i][j];
+            PlanetState& source = planets[order.sourceId];
+            const PlanetState& destination = planets[order.destinationId];
+
+            source.numShips -= order.numShips;
+
+            FleetState fleet;
+            fleet.owner = static_cast<int>(i) + 1;
+            fleet.numShips = order.numShips;
+            fleet.sourceId = order.sourceId;
+            fleet.destinationId = order.destinationId;
+            fleet.totalTripLength = GetTripLength(source.x, source.y, destination.x, destination.y);
+            fleet.turnsRemaining = fleet.totalTripLength;
+            fleets.push_back(fleet);
+            events->launchedFleets.push_back(fleet);
+        }
+    }
+
+    //Make planets grow ships.
+    for (int i = 0; i < numPlanets; ++i) {
+        if (0 != planets[i].owner) {
+            planets[i].numShips += planets[i].growthRate;
+        }
+    }
+
+    //Advance fleets, tallying up the forces on the planets they reach.  Only the planets
+    //with arrivals get a tally.
+    std::vector<int>& battleIds = events->battleIds;
+    std::vector<int>& battlePlanets = events->battlePlanets;
+    std::vector<int>& battleForces = events->battleForces;
+
+    battleIds.resize(numPlanets, -1);
+    battlePlanets.clear();
+
+    size_t numRemaining = 0;
+
+    for (size_t i = 0; i < fleets.size(); ++i) {
+        FleetState& fleet = fleets[i];
+
+        if (--fleet.turnsRemaining > 0) {
+            fleets[numRemaining++] = fleet;
+            continue;
+        }
+
+        int& battleId = battleIds[fleet.destinationId];
+
+        if (-1 == battleId) {
+            battleId = static_cast<int>(battlePlanets.size());
+            battlePlanets.push_back(fleet.destinationId);
+
+            if (battleForces.size() < battlePlanets.size() * NUM_OWNERS) {
+                battleForces.resize(battlePlanets.size() * NUM_OWNERS, 0);
+            }
+        }
+
+        battleForces[battleId * NUM_OWNERS + fleet.owner] += fleet.numShips;
+        events->landedFleets.push_back(std::make_pair(static_cast<int>(i), fleet));
+    }
+
+    fleets.resize(numRemaining);
+
+    //Welcome (or fight) the arrived fleets, leaving the tallies cleared for the next turn.
+    for (size_t i = 0; i < battlePlanets.size(); ++i) {
+        PlanetState& planet = planets[battlePlanets[i]];
+        int* forces = &battleForces[i * NUM_OWNERS];
+        forces[planet.owner] += planet.numShips;
+
+        int winnerId = planet.owner;
+        int remainingShips = 0;
+        ResolveBattle<NUM_OWNERS>(forces, planet.owner, &winnerId, &remainingShips);
+
+        planet.owner = winnerId;
+        planet.numShips = remainingShips;
+
+        std::fill(forces, forces + NUM_OWNERS, 0);
+        battleIds[battlePlanets[i]] = -1;
+    }
+}
+
+}
+
+void AdvanceGameState(const std::vector<std::vector<StagedOrder> > &orders, GameSnapshot *state,
+                      TurnEvents *events) {
+    //Pick the version of the code made for this number of players.
+    switch (orders.size()) {
+    case 0:
+    case 1:
+    case 2: AdvanceGameStateFor<2>(orders, state, events); break;
+    case 3: AdvanceGameStateFor<3>(orders, state, events); break;
+    case 4: AdvanceGameStateFor<4>(orders, state, events); break;
+    case 5: AdvanceGameStateFor<5>(orders, state, events); break;
+    case 6: AdvanceGameStateFor<6>(orders, state, events); break;
+    case 7: AdvanceGameStateFor<7>(orders, state, events); break;
+    default: AdvanceGameStateFor<MAX_NUM_PLAYERS>(orders, state, events); break;
+    }
+}
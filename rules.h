@@ -0,0 +1,149 @@
+//Available under GPL v3 license.
+//Author: Iouri Khramtsov.
+
+//This file contains the rules of the game on plain game states.  It doesn't depend on Qt,
+//so that it can be built into the engine library (see planetwars.h) as well as the GUI.
+
+#ifndef RULES_H
+#define RULES_H
+
+#include <string>
+#include <utility>
+#include <vector>
+
+//Most players that can take part in one game.  Owner ids must stay single digits
+//(see GameStateMessage).
+const int MAX_NUM_PLAYERS = 8;
+
+//Plain copies of the game objects, detached from the running game so that they can be
+//handed to other threads, written out or rendered later.
+struct PlanetState {
+    double x;
+    double y;
+    int owner;
+    int numShips;
+    int growthRate;
+    std::vector<std::pair<std::string, std::string> > properties;
+};
+
+struct FleetState {
+    int owner;
+    int numShips;
+    int sourceId;
+    int destinationId;
+    int totalTripLength;
+    int turnsRemaining;
+};
+
+//The state of the game at the end of a turn.
+struct GameSnapshot {
+    int turn;
+    std::vector<PlanetState> planets;
+    std::vector<FleetState> fleets;
+};
+
+//A move order that has passed the checks, waiting to be carried out when the turn ends.
+struct StagedOrder {
+    int sourceId;
+    int destinationId;
+    int numShips;
+};
+
+//Write out a game state in the map format, ending with a "go" line.
+std::string FormatGameState(const GameSnapshot& state);
+
+//Parse a map, or a game state message in the same format.  On failure, return false
+//and describe the problem in error.
+bool ParseGameState(const std::string& text, GameSnapshot* state, std::string* error);
+
+//Parse a replay: a sequence of game states, each terminated by a "go" line.
+bool ParseReplay(const std::string& text, std::vector<GameSnapshot>* states, std::string* error);
+
+//Number of turns it takes a fleet to fly between two points.
+int GetTripLength(double sourceX, double sourceY, double destinationX, double destinationY);
+
+//Read a move order line: "<source planet> <destination planet> <num ships>".
+bool ParseOrder(const std::string& line, StagedOrder* order, std::string* error);
+
+//Check that an order goes between two different planets that exist.
+bool CheckOrderRoute(const StagedOrder& order, int numPlanets, std::string* error);
+
+//Check that a player may send the ordered ships: the source planet must be the player's,
+//and hold the ships not yet taken by the player's earlier orders this turn.
+bool CheckOrderShips(const StagedOrder& order, int playerId, int sourceOwner, int availableShips,
+                     std::string* error);
+
+//What happened to the fleets during a turn, for keeping another copy of the game in step.
+//Keep one from turn to turn: it also holds the working space of AdvanceGameState(), so that
+//playing a turn doesn't allocate once the game is under way.
+struct TurnEvents {
+    //The fleets sent out by the orders, in the order of the orders, as they set off.
+    std::vector<FleetState> launchedFleets;
+
+    //The fleets that landed, as they landed, each with its place among the fleets in flight
+    //at the start of the turn followed by the launched ones.
+    std::vector<std::pair<int, FleetState> > landedFleets;
+
+    //Battle tallies: the battle on each planet (-1 for none), the planet of each battle, and
+    //the ships each owner brought to it (neutral first).  Left cleared between turns.
+    std::vector<int> battleIds;
+    std::vector<int> battlePlanets;
+    std::vector<int> battleForces;
+};
+
+//Play out one turn: send out the fleets ordered by each player (orders[i] are the orders of
+//player i + 1, already checked; there's a list for every player in the game), grow ships on
+//the owned planets, move the fleets along and fight the battles on the planets they reach.
+//The planet properties are left alone.  The fleets still in flight keep their order,
+//followed by the launched ones that are.
+void AdvanceGameState(const std::vector<std::vector<StagedOrder> >& orders, GameSnapshot* state,
+                      TurnEvents* events);
+
+//Check whether a player without planets has no fleet that can take the planet it's headed
+//for, however the other players play, and even with everyone else attacking that planet.
+bool IsStranded(const GameSnapshot& state, int playerId);
+
+//Map an owner id onto the point of view of a player: every player sees itself as player 1,
+//and the others as 2, 3, ... in turn order after it.  The neutral player is 0 for everyone.
+//Seen from player 1, the ids stay the same.
+template <int NUM_PLAYERS>
+inline int PovId(int povPlayerId, int ownerId) {
+    if (0 == ownerId) {
+        return 0;
+    }
+
+    const int offset = ownerId - povPlayerId;
+    return (offset < 0 ? offset + NUM_PLAYERS : offset) + 1;
+}
+
+//Resolve a battle on a planet, given the forces of each owner (neutral first).  The largest
+//force takes the planet and keeps as many ships as it outnumbers the second largest by.
+//If the two largest forces are tied, the planet stays with its owner, with no ships left.
+template <int NUM_OWNERS>
+inline void ResolveBattle(const int* forces, int ownerId, int* winnerId, int* remainingShips) {
+    int largest = 0;
+    int secondLargest = 0;
+    int largestId = ownerId;
+
+    for (int i = 0; i < NUM_OWNERS; ++i) {
+        if (forces[i] > largest) {
+            secondLargest = largest;
+            largest = forces[i];
+            largestId = i;
+
+        } else if (forces[i] > secondLargest) {
+            secondLargest = forces[i];
+        }
+    }
+
+    if (largest > secondLargest) {
+        *winnerId = largestId;
+        *remainingShips = largest - secondLargest;
+
+    } else {
+        *winnerId = ownerId;
+        *remainingShips = 0;
+    }
+}
+
+#endif // RULES_H
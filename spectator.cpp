@@ -0,0 +1,411 @@
+//Available under GPL v3 license.
+//Author: Iouri Khramtsov.
+
+//This file contains the server that broadcasts games to spectators, and the matching client.
+
+#include "spectator.h"
+#include <cstdlib>
+#include <sstream>
+#include <QHostAddress>
+#include <QLocalSocket>
+#include <QStringList>
+#include <QTcpSocket>
+#include "utils.h"
+
+namespace {
+
+const char* LOCAL_PREFIX = "local:";
+
+//Put the header and the property lines around the body of a message, which ends with "go".
+QByteArray FormatMessage(const std::string& header, const std::string& body, const std::string& properties) {
+    const size_t bodyEnd = body.size() - std::string("go\n").size();
+    const std::string text = header + body.substr(0, bodyEnd) + properties + body.substr(bodyEnd);
+    return QByteArray(text.data(), static_cast<int>(text.size()));
+}
+
+void FormatProperty(int planetId, const std::string& name, const std::string& value, std::stringstream* lines) {
+    *lines << "V " << planetId << " " << name << " " << value << "\n";
+}
+
+//Write out the changes made during a turn as a "D" message.
+QByteArray FormatDeltaMessage(const GameDelta& delta) {
+    std::stringstream header;
+    header << "D " << delta.turn << std::endl;
+
+    //The body is the same as in the messages sent to the bots that take deltas, which
+    //don't get the properties.
+    GameStateMessage changes;
+    changes.encodeDelta(delta);
+
+    std::stringstream properties;
+
+    for (size_t i = 0; i < delta.properties.size(); ++i) {
+        const PropertyChange& property = delta.properties[i];
+        FormatProperty(property.planetId, PropertyNames::getName(property.nameId), property.value, &properties);
+    }
+
+    return FormatMessage(header.str(), changes.getText(), properties.str());
+}
+
+//Write out a whole game state as an "S" message.
+QByteArray FormatSnapshotMessage(const GameSnapshot& state) {
+    std::stringstream header;
+    header << "S " << state.turn << std::endl;
+
+    std::stringstream properties;
+
+    for (size_t i = 0; i < state.planets.size(); ++i) {
+        const std::vector<std::pair<std::string, std::string> >& planetProperties = state.planets[i].properties;
+
+        for (size_t j = 0; j < planetProperties.size(); ++j) {
+            FormatProperty(static_cast<int>(i), planetProperties[j].first, planetProperties[j].second, &properties);
+        }
+    }
+
+    return FormatMessage(header.str(), FormatGameState(state), properties.str());
+}
+
+//Read a property line: "V <planet id> <name> <value>".
+bool ParseProperty(const std::vector<std::string>& tokens, int* planetId, std::string* name, std::string* value) {
+    if (tokens.size() != 4 || "V" != tokens[0]) {
+        return false;
+    }
+
+    *planetId = atoi(tokens[1].c_str());
+    *name = tokens[2];
+    *value = tokens[3];
+    return true;
+}
+
+} //namespace
+
+/*===================================================
+               Class SpectatorServer.
+====================================================*/
+SpectatorServer::SpectatorServer(QObject *parent)
+    :QObject(parent), m_game(NULL) {
+    m_state.turn = 0;
+
+    m_tcpServer = new QTcpServer(this);
+    m_localServer = new QLocalServer(this);
+
+    QObject::connect(m_tcpServer, SIGNAL(newConnection()), this, SLOT(acceptTcpConnection()));
+    QObject::connect(m_localServer, SIGNAL(newConnection()), this, SLOT(acceptLocalConnection()));
+}
+
+SpectatorServer::~SpectatorServer() {
+    for (SpectatorList::iterator it = m_spectators.begin(); it != m_spectators.end(); ++it) {
+        QObject::disconnect(it->socket, 0, this, 0);
+    }
+}
+
+bool SpectatorServer::listen(const QString &address) {
+    if (address.startsWith(LOCAL_PREFIX)) {
+        const QString name = address.mid(QString(LOCAL_PREFIX).size());
+
+        //Clean up after a server that didn't shut down properly.
+        QLocalServer::removeServer(name);
+        return m_localServer->listen(name);
+    }
+
+    QHostAddress host(QHostAddress::Any);
+    QString port = address;
+    const int colon = address.lastIndexOf(':');
+
+    if (colon >= 0) {
+        host = QHostAddress(address.left(colon) == "localhost" ? "127.0.0.1" : address.left(colon));
+        port = address.mid(colon + 1);
+    }
+
+    return m_tcpServer->listen(host, port.toUShort());
+}
+
+void SpectatorServer::setGame(PlanetWarsGame *game) {
+    m_game = game;
+
+    QObject::connect(m_game, SIGNAL(wasReset()), this, SLOT(startGame()));
+    QObject::connect(m_game, SIGNAL(turnEnded()), this, SLOT(sendTurn()));
+}
+
+void SpectatorServer::startGame() {
+    m_state = m_game->takeSnapshot();
+
+    for (SpectatorList::iterator it = m_spectators.begin(); it != m_spectators.end(); ++it) {
+        this->sendSnapshot(*it);
+    }
+}
+
+void SpectatorServer::sendTurn() {
+    //Keep our own copy up to date for spectators that join later or fall behind.
+    const GameDelta delta = m_game->takeDelta();
+    ApplyGameDelta(delta, &m_state);
+
+    if (m_spectators.empty()) {
+        return;
+    }
+
+    //The message is the same for everyone, so encode it once.
+    const QByteArray message = FormatDeltaMessage(delta);
+
+    for (SpectatorList::iterator it = m_spectators.begin(); it != m_spectators.end(); ++it) {
+        Spectator& spectator = *it;
+
+        if (spectator.isBehind) {
+            //Will get a snapshot once the backlog is sent.
+            continue;
+        }
+
+        if (this->getBacklog(spectator.socket) > MAX_BACKLOG) {
+            //Don't let a slow spectator hold up the game or eat up memory.
+            spectator.isBehind = true;
+            continue;
+        }
+
+        spectator.socket->write(message);
+    }
+}
+
+void SpectatorServer::acceptTcpConnection() {
+    while (m_tcpServer->hasPendingConnections()) {
+        QTcpSocket* socket = m_tcpServer->nextPendingConnection();
+        this->addSpectator(socket);
+    }
+}
+
+void SpectatorServer::acceptLocalConnection() {
+    while (m_localServer->hasPendingConnections()) {
+        QLocalSocket* socket = m_localServer->nextPendingConnection();
+        this->addSpectator(socket);
+    }
+}
+
+void SpectatorServer::addSpectator(QIODevice *socket) {
+    QObject::connect(socket, SIGNAL(bytesWritten(qint64)), this, SLOT(onBytesWritten()));
+    QObject::connect(socket, SIGNAL(disconnected()), this, SLOT(onDisconnected()));
+
+    Spectator spectator;
+    spectator.socket = socket;
+    spectator.isBehind = false;
+    m_spectators.push_back(spectator);
+
+    //Late joiners start from the current state.
+    this->sendSnapshot(m_spectators.back());
+}
+
+void SpectatorServer::sendSnapshot(Spectator &spectator) {
+    spectator.socket->write(FormatSnapshotMessage(m_state));
+    spectator.isBehind = false;
+}
+
+void SpectatorServer::onBytesWritten() {
+    QIODevice* socket = qobject_cast<QIODevice*>(this->sender());
+
+    for (SpectatorList::iterator it = m_spectators.begin(); it != m_spectators.end(); ++it) {
+        if (it->socket == socket) {
+            //Once a spectator that fell behind has caught up, send it the state as of now,
+            //which covers all the turns it missed.
+            if (it->isBehind && 0 == this->getBacklog(socket)) {
+                this->sendSnapshot(*it);
+            }
+
+            return;
+        }
+    }
+}
+
+void SpectatorServer::onDisconnected() {
+    QIODevice* socket = qobject_cast<QIODevice*>(this->sender());
+
+    for (SpectatorList::iterator it = m_spectators.begin(); it != m_spectators.end(); ++it) {
+        if (it->socket == socket) {
+            m_spectators.erase(it);
+            break;
+        }
+    }
+
+    if (NULL != socket) {
+        socket->deleteLater();
+    }
+}
+
+qint64 SpectatorServer::getBacklog(QIODevice *socket) const {
+    return socket->bytesToWrite();
+}
+
+/*===================================================
+               Class SpectatorClient.
+====================================================*/
+SpectatorClient::SpectatorClient(PlanetWarsGame *game, QObject *parent)
+    :QObject(parent), m_game(game), m_socket(NULL), m_hasSnapshot(false) {
+    this->setObjectName("Spectator");
+}
+
+void SpectatorClient::connectToServer(const QString &address) {
+    if (address.startsWith(LOCAL_PREFIX)) {
+        QLocalSocket* socket = new QLocalSocket(this);
+        m_socket = socket;
+        QObject::connect(socket, SIGNAL(connected()), this, SLOT(onConnected()));
+        QObject::connect(socket, SIGNAL(disconnected()), this, SLOT(onDisconnected()));
+        QObject::connect(socket, SIGNAL(readyRead()), this, SLOT(readMessages()));
+        socket->connectToServer(address.mid(QString(LOCAL_PREFIX).size()));
+
+    } else {
+        const int colon = address.lastIndexOf(':');
+        QTcpSocket* socket = new QTcpSocket(this);
+        m_socket = socket;
+        QObject::connect(socket, SIGNAL(connected()), this, SLOT(onConnected()));
+        QObject::connect(socket, SIGNAL(disconnected()), this, SLOT(onDisconnected()));
+        QObject::connect(socket, SIGNAL(readyRead()), this, SLOT(readMessages()));
+        socket->connectToHost(colon >= 0 ? address.left(colon) : QString("localhost"),
+                              address.mid(colon + 1).toUShort());
+    }
+}
+
+void SpectatorClient::onConnected() {
+    emit logMessage("Connected to the spectator server.", this->objectName());
+}
+
+void SpectatorClient::onDisconnected() {
+    emit logError("Disconnected from the spectator server.", this->objectName());
+}
+
+void SpectatorClient::readMessages() {
+    if (NULL == m_socket || !m_socket->isOpen()) {
+        return;
+    }
+
+    const QByteArray data = m_socket->readAll();
+    m_buffer.append(data.constData(), data.size());
+
+    //Process all complete messages; each one ends with a "go" line.
+    size_t begin = 0;
+
+    for (;;) {
+        const size_t headerEnd = m_buffer.find('\n', begin);
+
+        if (std::string::npos == headerEnd) {
+            break;
+        }
+
+        const size_t go = m_buffer.find("\ngo\n", headerEnd);
+
+        if (std::string::npos == go) {
+            break;
+        }
+
+        const std::string header = m_buffer.substr(begin, headerEnd - begin);
+        const std::string body = (go > headerEnd) ? m_buffer.substr(headerEnd + 1, go - headerEnd) : std::string();
+        this->processMessage(header, body);
+
+        begin = go + 4;
+    }
+
+    m_buffer.erase(0, begin);
+
+    //A server that never ends its message isn't one we can follow.
+    if (m_buffer.size() > MAX_BUFFER_SIZE) {
+        emit logError("The spectator server sent a message that is too long.", this->objectName());
+        m_buffer.clear();
+        m_hasSnapshot = false;
+        m_socket->close();
+    }
+}
+
+void SpectatorClient::processMessage(const std::string &header, const std::string &body) {
+    std::vector<std::string> headerTokens = Tokenize(header, " ");
+
+    if (headerTokens.size() != 2) {
+        emit logError("Bad message from the spectator server: " + header, this->objectName());
+        return;
+    }
+
+    const int turn = atoi(headerTokens[1].c_str());
+
+    if ("S" == headerTokens[0]) {
+        //Take out the property lines, which aren't part of the map format.
+        std::vector<std::string> lines = Tokenize(body, "\n");
+        std::vector<std::vector<std::string> > properties;
+        std::string map;
+
+        for (size_t i = 0; i < lines.size(); ++i) {
+            std::vector<std::string> tokens = Tokenize(lines[i], " ");
+
+            if (!tokens.empty() && "V" == tokens[0]) {
+                properties.push_back(tokens);
+
+            } else {
+                map += lines[i] + "\n";
+            }
+        }
+
+        GameSnapshot state;
+        std::string error;
+
+        if (!ParseGameState(map, &state, &error)) {
+            emit logError("Bad snapshot from the spectator server. " + error, this->objectName());
+            return;
+        }
+
+        for (size_t i = 0; i < properties.size(); ++i) {
+            int planetId = -1;
+            std::string name;
+            std::string value;
+
+            if (ParseProperty(properties[i], &planetId, &name, &value)
+                && planetId >= 0 && planetId < static_cast<int>(state.planets.size())) {
+                state.planets[planetId].properties.push_back(std::make_pair(name, value));
+            }
+        }
+
+        state.turn = turn;
+        m_hasSnapshot = m_game->showSnapshot(state);
+
+    } else if ("D" == headerTokens[0]) {
+        if (!m_hasSnapshot) {
+            return;
+        }
+
+        GameDelta delta;
+        delta.turn = turn;
+        std::vector<std::string> lines = Tokenize(body, "\n");
+
+        for (size_t i = 0; i < lines.size(); ++i) {
+            std::vector<std::string> tokens = Tokenize(lines[i], " ");
+
+            if (tokens.size() == 4 && "C" == tokens[0]) {
+                PlanetChange change;
+                change.planetId = atoi(tokens[1].c_str());
+                change.owner = atoi(tokens[2].c_str());
+                change.numShips = atoi(tokens[3].c_str());
+                delta.planets.push_back(change);
+
+            } else if (tokens.size() == 7 && "F" == tokens[0]) {
+                FleetState fleet;
+                fleet.owner = atoi(tokens[1].c_str());
+                fleet.numShips = atoi(tokens[2].c_str());
+                fleet.sourceId = atoi(tokens[3].c_str());
+                fleet.destinationId = atoi(tokens[4].c_str());
+                fleet.totalTripLength = atoi(tokens[5].c_str());
+                fleet.turnsRemaining = atoi(tokens[6].c_str());
+                delta.newFleets.push_back(fleet);
+
+            } else if (!tokens.empty() && "V" == tokens[0]) {
+                PropertyChange property;
+                std::string name;
+
+                if (ParseProperty(tokens, &property.planetId, &name, &property.value)) {
+                    property.nameId = PropertyNames::intern(name);
+
+                    if (PropertyNames::NO_NAME != property.nameId) {
+                        delta.properties.push_back(property);
+                    }
+                }
+            }
+        }
+
+        m_game->showDelta(delta);
+
+    } else {
+        emit logError("Unknown message from the spectator server: " + header, this->objectName());
+    }
+}
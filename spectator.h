@@ -0,0 +1,119 @@
+//Available under GPL v3 license.
+//Author: Iouri Khramtsov.
+
+//This file contains the server that broadcasts games to spectators, and the matching client.
+
+#ifndef SPECTATOR_H
+#define SPECTATOR_H
+
+#include <list>
+#include <string>
+#include <QByteArray>
+#include <QIODevice>
+#include <QLocalServer>
+#include <QObject>
+#include <QString>
+#include <QTcpServer>
+#include "game.h"
+
+//Spectator stream protocol.  The server sends text messages, each made of a header
+//line, a body and a "go" line:
+//
+//  S <turn>            A snapshot of the whole game: P and F lines in the map format,
+//                      with actual owner ids.  Sent when a spectator connects, when a
+//                      new game starts, and to catch up spectators that fell behind.
+//  D <turn>            The changes made during a turn (see GameDelta):
+//                      C <planet id> <owner> <num ships>  for each changed planet,
+//                      F ...                              for each new fleet in flight.
+//
+//Both end with a line for each planet property set (in a snapshot) or changed (in a delta),
+//given by name since the name ids are only good within one process:
+//                      V <planet id> <name> <value>
+//
+//Addresses are "<port>" (server only; listens on all interfaces), "<host>:<port>"
+//for TCP, or "local:<name>" for a local (Unix domain) socket.
+
+//Broadcasts the game to any number of connected spectators.
+class SpectatorServer : public QObject {
+    Q_OBJECT
+
+public:
+    SpectatorServer(QObject* parent);
+    ~SpectatorServer();
+
+    //Start accepting spectators.  Return false if the address can't be listened on.
+    bool listen(const QString& address);
+
+    void setGame(PlanetWarsGame* game);
+
+public slots:
+    //Send everyone the new game.
+    void startGame();
+
+    //Send everyone the turn that just ended.
+    void sendTurn();
+
+private slots:
+    void acceptTcpConnection();
+    void acceptLocalConnection();
+    void onBytesWritten();
+    void onDisconnected();
+
+private:
+    //Spectators that have more than this queued up get a snapshot once they catch up,
+    //instead of every delta in between.
+    static const qint64 MAX_BACKLOG = 1024 * 1024;
+
+    struct Spectator {
+        QIODevice* socket;
+        bool isBehind;      //Whether deltas were skipped for this spectator.
+    };
+
+    typedef std::list<Spectator> SpectatorList;
+
+    void addSpectator(QIODevice* socket);
+    void sendSnapshot(Spectator& spectator);
+    qint64 getBacklog(QIODevice* socket) const;
+
+    PlanetWarsGame* m_game;
+    GameSnapshot m_state;   //The state the spectators should be seeing now.
+    QTcpServer* m_tcpServer;
+    QLocalServer* m_localServer;
+    SpectatorList m_spectators;
+};
+
+//Receives a game from a spectator server and shows it through a local game object,
+//which is never run itself.
+class SpectatorClient : public QObject {
+    Q_OBJECT
+
+public:
+    SpectatorClient(PlanetWarsGame* game, QObject* parent);
+
+    //Connect to the server.
+    void connectToServer(const QString& address);
+
+signals:
+    void logMessage(const std::string& message, const QString& sender);
+    void logError(const std::string& message, const QString& sender);
+
+private slots:
+    void readMessages();
+    void onConnected();
+    void onDisconnected();
+
+private:
+    //Messages are far smaller than this; a server that sends more without ending its
+    //message gets disconnected.
+    static const size_t MAX_BUFFER_SIZE = 64 * 1024 * 1024;
+
+    //Apply one complete message.
+    void processMessage(const std::string& header, const std::string& body);
+
+    PlanetWarsGame* m_game;
+    QIODevice* m_socket;
+    std::string m_buffer;       //Incoming data that doesn't make up a whole message yet.
+    bool m_hasSnapshot;         //Whether there's a state to apply deltas to.
+};
+
+#endif // SPECTATOR_H
@@ -0,0 +1,71 @@
+//Available under GPL v3 license.
+//Author: Iouri Khramtsov.
+
+//This file contains the sequential test used to decide A/B matches between bots.
+
+#include "sprt.h"
+#include <cmath>
+
+namespace {
+
+//Expected score of a bot that is a given number of Elo points stronger than its opponent.
+double ExpectedScore(double elo) {
+    return 1.0 / (1.0 + pow(10.0, -elo / 400.0));
+}
+
+}
+
+/*===================================================
+                Class Sprt.
+====================================================*/
+const double Sprt::PSEUDO_COUNT = 0.5;
+
+Sprt::Sprt(double elo0, double elo1, double alpha, double beta)
+    :m_score0(ExpectedScore(elo0)), m_score1(ExpectedScore(elo1)),
+      m_lowerBound(log(beta / (1.0 - alpha))), m_upperBound(log((1.0 - beta) / alpha)),
+      m_numWins(0), m_numDraws(0), m_numLosses(0) {
+}
+
+void Sprt::addScore(double score) {
+    if (score > 0.75) {
+        ++m_numWins;
+    } else if (score > 0.25) {
+        ++m_numDraws;
+    } else {
+        ++m_numLosses;
+    }
+}
+
+double Sprt::getLlr() const {
+    const double numGames = this->getNumGames();
+
+    if (0 == numGames) {
+        return 0;
+    }
+
+    //Work out the score and its variance with a pseudo-count added to each outcome, so that
+    //the variance isn't zero for a one-sided record (all wins, all losses or all draws).
+    const double wins = m_numWins + PSEUDO_COUNT;
+    const double draws = m_numDraws + PSEUDO_COUNT;
+    const double losses = m_numLosses + PSEUDO_COUNT;
+    const double total = wins + draws + losses;
+
+    const double score = (wins + 0.5 * draws) / total;
+    const double variance = (wins * (1.0 - score) * (1.0 - score)
+                             + draws * (0.5 - score) * (0.5 - score)
+                             + losses * score * score) / total;
+
+    return numGames * (m_score1 - m_score0) * (2.0 * score - m_score0 - m_score1) / (2.0 * variance);
+}
+
+Sprt::Decision Sprt::getDecision() const {
+    const double llr = this->getLlr();
+
+    if (llr >= m_upperBound) {
+        return ACCEPT_H1;
+    } else if (llr <= m_lowerBound) {
+        return ACCEPT_H0;
+    }
+
+    return UNDECIDED;
+}
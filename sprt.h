@@ -0,0 +1,55 @@
+//Available under GPL v3 license.
+//Author: Iouri Khramtsov.
+
+//This file contains the sequential test used to decide A/B matches between bots.
+
+#ifndef SPRT_H
+#define SPRT_H
+
+//A sequential probability ratio test of whether a bot is stronger than another by at least
+//elo1 (hypothesis H1) or by no more than elo0 (H0), given the error rates alpha (accepting H1
+//when H0 holds) and beta (accepting H0 when H1 holds).
+//
+//The games are counted as wins, draws and losses of the bot being tested, and the log-likelihood
+//ratio of the two hypotheses is worked out from the mean and variance of the scores (the
+//trinomial approximation used by most engine testing frameworks).  The test can be stopped as
+//soon as the ratio crosses either bound.
+class Sprt {
+public:
+    enum Decision {
+        UNDECIDED,
+        ACCEPT_H0,
+        ACCEPT_H1
+    };
+
+    Sprt(double elo0, double elo1, double alpha, double beta);
+
+    //Add the score of one game: 1 for a win, 0.5 for a draw, 0 for a loss.
+    void addScore(double score);
+
+    int getNumWins() const          {return m_numWins;}
+    int getNumDraws() const         {return m_numDraws;}
+    int getNumLosses() const        {return m_numLosses;}
+    int getNumGames() const         {return m_numWins + m_numDraws + m_numLosses;}
+
+    double getLowerBound() const    {return m_lowerBound;}
+    double getUpperBound() const    {return m_upperBound;}
+    double getLlr() const;
+
+    Decision getDecision() const;
+
+private:
+    //Games added to each outcome when working out the variance.
+    static const double PSEUDO_COUNT;
+
+    double m_score0;        //Expected score of a bot elo0 stronger than the other.
+    double m_score1;
+    double m_lowerBound;
+    double m_upperBound;
+
+    int m_numWins;
+    int m_numDraws;
+    int m_numLosses;
+};
+
+#endif // SPRT_H
@@ -0,0 +1,409 @@
+//Available under GPL v3 license.
+//Author: Iouri Khramtsov.
+
+//This file contains the tests of the rules of the game and of the C interface of the engine.
+
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "../planetwars.h"
+#include "../rules.h"
+#include "test.h"
+
+namespace {
+
+//Two players facing each other, with a neutral planet off to the side.  Planet 0 is 5 turns
+//from planet 1 and 10 turns from planet 2.
+const char* const TEST_MAP =
+        "P 0 0 1 100 5\n"
+        "P 3 4 2 100 5\n"
+        "P 10 0 0 20 3\n";
+
+StagedOrder MakeOrder(int sourceId, int destinationId, int numShips) {
+    StagedOrder order;
+    order.sourceId = sourceId;
+    order.destinationId = destinationId;
+    order.numShips = numShips;
+    return order;
+}
+
+void TestParseOrder() {
+    StagedOrder order;
+    std::string error;
+
+    CHECK(ParseOrder("3 1 25", &order, &error));
+    CHECK(3 == order.sourceId && 1 == order.destinationId && 25 == order.numShips);
+
+    CHECK(!ParseOrder("3 1", &order, &error));
+    CHECK("Expected 3 tokens on a move order line, have 2." == error);
+
+    CHECK(!CheckOrderRoute(MakeOrder(1, 1, 5), 3, &error));
+    CHECK(!CheckOrderRoute(MakeOrder(0, 3, 5), 3, &error));
+    CHECK(CheckOrderRoute(MakeOrder(0, 2, 5), 3, &error));
+
+    CHECK(!CheckOrderShips(MakeOrder(0, 1, 5), 1, 2, 100, &error));
+    CHECK(!CheckOrderShips(MakeOrder(0, 1, 50), 1, 1, 40, &error));
+    CHECK("Cannot send 50 ships from planet 0.  Planet has 40 ships." == error);
+    CHECK(CheckOrderShips(MakeOrder(0, 1, 40), 1, 1, 40, &error));
+}
+
+void TestBattle() {
+    //The largest force wins by the margin over the second largest.
+    const int forces[3] = {20, 35, 50};
+    int winnerId = -1;
+    int remainingShips = -1;
+    ResolveBattle<3>(forces, 0, &winnerId, &remainingShips);
+    CHECK(2 == winnerId && 15 == remainingShips);
+
+    //A tie leaves the planet with its owner and no ships.
+    const int tiedForces[3] = {0, 30, 30};
+    ResolveBattle<3>(tiedForces, 1, &winnerId, &remainingShips);
+    CHECK(1 == winnerId && 0 == remainingShips);
+}
+
+void TestAdvanceGameState() {
+    GameSnapshot state;
+    std::string error;
+    CHECK(ParseGameState(TEST_MAP, &state, &error));
+    state.turn = 0;
+
+    std::vector<std::vector<StagedOrder> > orders(2);
+    orders[0].push_back(MakeOrder(0, 1, 60));
+    orders[0].push_back(MakeOrder(0, 2, 30));
+    orders[1].push_back(MakeOrder(1, 0, 10));
+
+    TurnEvents events;
+    AdvanceGameState(orders, &state, &events);
+
+    //The ships leave before the planets grow.
+    CHECK(1 == state.turn);
+    CHECK(15 == state.planets[0].numShips);
+    CHECK(95 == state.planets[1].numShips);
+    CHECK(20 == state.planets[2].numShips);
+    CHECK(3 == events.launchedFleets.size());
+    CHECK(events.landedFleets.empty());
+
+    CHECK(3 == state.fleets.size());
+    CHECK(2 == state.fleets[2].owner && 5 == state.fleets[2].totalTripLength);
+    CHECK(4 == state.fleets[2].turnsRemaining);
+
+    //Both attacks land on turn 5; the fleet to the neutral planet flies on.
+    const std::vector<std::vector<StagedOrder> > noOrders(2);
+
+    for (int turn = 2; turn <= 5; ++turn) {
+        AdvanceGameState(noOrders, &state, &events);
+    }
+
+    CHECK(2 == events.landedFleets.size());
+    CHECK(0 == events.landedFleets[0].first && 1 == events.landedFleets[0].second.destinationId);
+    CHECK(2 == events.landedFleets[1].first && 0 == events.landedFleets[1].second.destinationId);
+    CHECK(0 == events.landedFleets[1].second.turnsRemaining);
+
+    CHECK(1 == state.planets[0].owner && 25 == state.planets[0].numShips);
+    CHECK(2 == state.planets[1].owner && 55 == state.planets[1].numShips);
+    CHECK(1 == state.fleets.size() && 5 == state.fleets[0].turnsRemaining);
+}
+
+void TestCapture() {
+    //A fleet launched onto a planet next door lands on the same turn, and the events count
+    //it after the fleets that were already in flight.
+    GameSnapshot state;
+    std::string error;
+    CHECK(ParseGameState("P 0 0 1 50 2\nP 1 0 0 10 4\nF 1 5 0 1 3 2\n", &state, &error));
+
+    std::vector<std::vector<StagedOrder> > orders(1);
+    orders[0].push_back(MakeOrder(0, 1, 30));
+
+    TurnEvents events;
+    AdvanceGameState(orders, &state, &events);
+
+    CHECK(1 == events.launchedFleets.size());
+    CHECK(1 == events.launchedFleets[0].turnsRemaining);
+    CHECK(1 == events.landedFleets.size());
+    CHECK(1 == events.landedFleets[0].first);
+
+    //The neutral planet doesn't grow, and falls to the 30 ships.
+    CHECK(1 == state.planets[1].owner && 20 == state.planets[1].numShips);
+    CHECK(22 == state.planets[0].numShips);
+    CHECK(1 == state.fleets.size() && 1 == state.fleets[0].turnsRemaining);
+}
+
+//Play out a turn the plain way, with one tally of every owner for every planet: the rules
+//the engine had before they were specialized by the number of players.
+void AdvanceReference(const std::vector<std::vector<StagedOrder> >& orders, GameSnapshot* state) {
+    std::vector<PlanetState>& planets = state->planets;
+    std::vector<FleetState> fleets;
+    const int numPlanets = static_cast<int>(planets.size());
+    const int numOwners = MAX_NUM_PLAYERS + 1;
+
+    ++state->turn;
+    fleets.swap(state->fleets);
+
+    for (size_t i = 0; i < orders.size(); ++i) {
+        for (size_t j = 0; j < orders[i].size(); ++j) {
+            const StagedOrder& order = orders[i][j];
+            const PlanetState& destination = planets[order.destinationId];
+            PlanetState& source = planets[order.sourceId];
+            source.numShips -= order.numShips;
+
+            FleetState fleet;
+            fleet.owner = static_cast<int>(i) + 1;
+            fleet.numShips = order.numShips;
+            fleet.sourceId = order.sourceId;
+            fleet.destinationId = order.destinationId;
+            fleet.totalTripLength = GetTripLength(source.x, source.y, destination.x, destination.y);
+            fleet.turnsRemaining = fleet.totalTripLength;
+            fleets.push_back(fleet);
+        }
+    }
+
+    for (int i = 0; i < numPlanets; ++i) {
+        if (0 != planets[i].owner) {
+            planets[i].numShips += planets[i].growthRate;
+        }
+    }
+
+    std::vector<int> forces(numPlanets * numOwners, 0);
+    std::vector<bool> hasArrivals(numPlanets, false);
+
+    for (size_t i = 0; i < fleets.size(); ++i) {
+        FleetState fleet = fleets[i];
+
+        if (--fleet.turnsRemaining > 0) {
+            state->fleets.push_back(fleet);
+
+        } else {
+            forces[fleet.destinationId * numOwners + fleet.owner] += fleet.numShips;
+            hasArrivals[fleet.destinationId] = true;
+        }
+    }
+
+    for (int i = 0; i < numPlanets; ++i) {
+        if (hasArrivals[i]) {
+            PlanetState& planet = planets[i];
+            forces[i * numOwners + planet.owner] += planet.numShips;
+            ResolveBattle<MAX_NUM_PLAYERS + 1>(&forces[i * numOwners], planet.owner,
+                                               &planet.owner, &planet.numShips);
+        }
+    }
+}
+
+//Make a map of numPlanets planets handed out among numPlayers players and the neutral one.
+GameSnapshot MakeRandomMap(int numPlayers, int numPlanets) {
+    GameSnapshot state;
+    state.turn = 0;
+
+    for (int i = 0; i < numPlanets; ++i) {
+        PlanetState planet;
+        planet.x = rand() % 25;
+        planet.y = rand() % 25;
+        planet.owner = (i <= numPlayers) ? i : 0;
+        planet.numShips = rand() % 100;
+        planet.growthRate = rand() % 6;
+        state.planets.push_back(planet);
+    }
+
+    return state;
+}
+
+//Give random legal orders for every player: each owned planet sends some of its ships
+//to a random planet, now and then.
+void MakeRandomOrders(const GameSnapshot& state, std::vector<std::vector<StagedOrder> >* orders) {
+    const int numPlanets = static_cast<int>(state.planets.size());
+
+    for (size_t i = 0; i < orders->size(); ++i) {
+        (*orders)[i].clear();
+    }
+
+    for (int i = 0; i < numPlanets; ++i) {
+        const PlanetState& planet = state.planets[i];
+
+        if (0 == planet.owner || planet.numShips <= 0 || 0 != rand() % 3) {
+            continue;
+        }
+
+        const int destinationId = (i + 1 + rand() % (numPlanets - 1)) % numPlanets;
+        const int numShips = rand() % (planet.numShips + 1);
+        (*orders)[planet.owner - 1].push_back(MakeOrder(i, destinationId, numShips));
+    }
+}
+
+bool IsSameState(const GameSnapshot& first, const GameSnapshot& second) {
+    if (first.turn != second.turn || first.planets.size() != second.planets.size()
+        || first.fleets.size() != second.fleets.size()) {
+        return false;
+    }
+
+    for (size_t i = 0; i < first.planets.size(); ++i) {
+        if (first.planets[i].owner != second.planets[i].owner
+            || first.planets[i].numShips != second.planets[i].numShips) {
+            return false;
+        }
+    }
+
+    for (size_t i = 0; i < first.fleets.size(); ++i) {
+        const FleetState& a = first.fleets[i];
+        const FleetState& b = second.fleets[i];
+
+        if (a.owner != b.owner || a.numShips != b.numShips || a.sourceId != b.sourceId
+            || a.destinationId != b.destinationId || a.turnsRemaining != b.turnsRemaining) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+void TestSameResults() {
+    //The rules picked for the number of players play the same games as the plain ones,
+    //with the working space kept from turn to turn.
+    srand(12345);
+
+    for (int numPlayers = 2; numPlayers <= MAX_NUM_PLAYERS; ++numPlayers) {
+        for (int game = 0; game < 5; ++game) {
+            GameSnapshot state = MakeRandomMap(numPlayers, numPlayers + 1 + rand() % 20);
+            GameSnapshot reference = state;
+            std::vector<std::vector<StagedOrder> > orders(numPlayers);
+            TurnEvents events;
+            bool isSame = true;
+
+            for (int turn = 0; turn < 200 && isSame; ++turn) {
+                MakeRandomOrders(state, &orders);
+                AdvanceGameState(orders, &state, &events);
+                AdvanceReference(orders, &reference);
+                isSame = IsSameState(state, reference);
+            }
+
+            CHECK(isSame);
+        }
+    }
+}
+
+void TestStranded() {
+    GameSnapshot state;
+    std::string error;
+
+    //Player 2 can empty its planet before the fleet lands, leaving only the 5 ships grown
+    //that turn, so 20 ships may still take it.
+    CHECK(ParseGameState("P 0 0 2 100 5\nP 9 0 0 10 1\nF 1 20 1 0 9 4\n", &state, &error));
+    CHECK(!IsStranded(state, 1));
+    CHECK(!IsStranded(state, 2));
+
+    //No more than the grown ships can't take it.
+    CHECK(ParseGameState("P 0 0 2 100 5\nP 9 0 0 10 1\nF 1 5 1 0 9 4\n", &state, &error));
+    CHECK(IsStranded(state, 1));
+
+    //A neutral planet keeps its ships, unless a third player's fleet takes some out.
+    CHECK(ParseGameState("P 0 0 0 30 5\nP 9 0 2 10 1\nF 1 20 1 0 9 4\n", &state, &error));
+    CHECK(IsStranded(state, 1));
+
+    CHECK(ParseGameState("P 0 0 0 30 5\nP 9 0 2 10 1\nF 1 20 1 0 9 4\nF 2 15 1 0 9 6\n",
+                         &state, &error));
+    CHECK(!IsStranded(state, 1));
+}
+
+void TestCreateFromMap() {
+    char error[256];
+
+    pw_game* game = pw_create_from_map(TEST_MAP, error, sizeof(error));
+    CHECK(NULL != game);
+    CHECK('\0' == error[0]);
+    CHECK(0 == pw_get_turn(game));
+    pw_destroy(game);
+
+    CHECK(NULL == pw_create_from_map(NULL, error, sizeof(error)));
+    CHECK(0 == strcmp("No map given.", error));
+
+    CHECK(NULL == pw_create_from_map("P 0 0 9 100 5\n", error, sizeof(error)));
+    CHECK(0 == strcmp("Planet 0 has an invalid owner 9.", error));
+
+    CHECK(NULL == pw_create_from_map("P 0 0 1 100 5\nP 3 4 0 10 1\nF 0 5 0 1 5 3\n",
+                                     error, sizeof(error)));
+    CHECK(0 == strcmp("Fleet 0 has an invalid owner 0.", error));
+
+    //The message is cut short to fit the buffer.
+    char shortError[5];
+    CHECK(NULL == pw_create_from_map(NULL, shortError, sizeof(shortError)));
+    CHECK(0 == strcmp("No m", shortError));
+}
+
+void TestSetOrders() {
+    char error[256];
+    pw_game* game = pw_create_from_map(TEST_MAP, error, sizeof(error));
+
+    CHECK(-1 == pw_set_orders(game, 0, "0 1 10", error, sizeof(error)));
+    CHECK(0 == strcmp("Player id 0 is out of range.", error));
+
+    //The ships of earlier orders are spoken for.
+    CHECK(-1 == pw_set_orders(game, 1, "0 1 60\n0 2 50\n", error, sizeof(error)));
+    CHECK(0 == strcmp("Error on line 2 of the orders.  "
+                      "Cannot send 50 ships from planet 0.  Planet has 40 ships.", error));
+
+    CHECK(-1 == pw_set_orders(game, 2, "0 1 10", error, sizeof(error)));
+    CHECK(0 == strcmp("Error on line 1 of the orders.  "
+                      "Source planet 0 does not belong to this player.", error));
+
+    //Rejected orders leave nothing behind.
+    CHECK(0 == pw_step(game));
+    pw_planet planets[3];
+    CHECK(3 == pw_get_planets(game, planets, 3));
+    CHECK(105 == planets[0].num_ships);
+    CHECK(0 == pw_get_fleets(game, NULL, 0));
+
+    pw_destroy(game);
+}
+
+void TestPlayGame() {
+    char error[256];
+    pw_game* game = pw_create_from_map(TEST_MAP, error, sizeof(error));
+
+    CHECK(0 == pw_set_orders(game, 1, "# Attack.\n0 1 60\n0 2 30\ngo\n0 1 5\n", error, sizeof(error)));
+    CHECK(0 == pw_set_orders(game, 2, "1 0 10", error, sizeof(error)));
+
+    for (int i = 0; i < 6; ++i) {
+        CHECK(0 == pw_step(game));
+    }
+
+    CHECK(6 == pw_get_turn(game));
+
+    pw_planet planets[3];
+    CHECK(3 == pw_get_planets(game, planets, 3));
+    CHECK(1 == planets[0].owner && 30 == planets[0].num_ships);
+    CHECK(2 == planets[1].owner && 60 == planets[1].num_ships);
+    CHECK(0 == planets[2].owner && 20 == planets[2].num_ships);
+    CHECK(3 == planets[1].x && 4 == planets[1].y && 5 == planets[1].growth_rate);
+
+    pw_fleet fleets[2];
+    CHECK(1 == pw_get_fleets(game, fleets, 2));
+    CHECK(1 == fleets[0].owner && 30 == fleets[0].num_ships);
+    CHECK(0 == fleets[0].source_id && 2 == fleets[0].destination_id);
+    CHECK(10 == fleets[0].total_trip_length && 4 == fleets[0].turns_remaining);
+
+    char text[256];
+    const size_t length = pw_format_state(game, text, sizeof(text));
+    CHECK(length == strlen(text));
+    CHECK(NULL != strstr(text, "F 1 30 0 2 10 4\n"));
+
+    //The length is reported in full even when the text doesn't fit.
+    char shortText[8];
+    CHECK(length == pw_format_state(game, shortText, sizeof(shortText)));
+    CHECK(7 == strlen(shortText));
+
+    pw_destroy(game);
+}
+
+}
+
+void TestEngine() {
+    TestParseOrder();
+    TestBattle();
+    TestAdvanceGameState();
+    TestCapture();
+    TestSameResults();
+    TestStranded();
+    TestCreateFromMap();
+    TestSetOrders();
+    TestPlayGame();
+}
@@ -0,0 +1,22 @@
+//Available under GPL v3 license.
+//Author: Iouri Khramtsov.
+
+//This file contains the runner of the tests of the parts that don't need Qt.
+
+#include <cstdio>
+#include "test.h"
+
+int g_numFailures = 0;
+
+int main(int, char**) {
+    TestSprt();
+    TestEngine();
+
+    if (0 != g_numFailures) {
+        fprintf(stderr, "%d checks failed.\n", g_numFailures);
+        return 1;
+    }
+
+    printf("All checks passed.\n");
+    return 0;
+}
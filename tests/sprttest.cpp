@@ -0,0 +1,81 @@
+//Available under GPL v3 license.
+//Author: Iouri Khramtsov.
+
+//This file contains the tests of the sequential test used by the match runner.
+
+#include "../sprt.h"
+#include "test.h"
+
+namespace {
+
+//Add the same score until the test decides; return the number of games it took, or -1.
+int PlayUntilDecided(Sprt* test, double score, int maxGames) {
+    for (int game = 0; game < maxGames; ++game) {
+        if (Sprt::UNDECIDED != test->getDecision()) {
+            return game;
+        }
+
+        test->addScore(score);
+    }
+
+    return (Sprt::UNDECIDED != test->getDecision()) ? maxGames : -1;
+}
+
+void TestNoGames() {
+    Sprt test(0, 5, 0.05, 0.05);
+    CHECK(0 == test.getLlr());
+    CHECK(Sprt::UNDECIDED == test.getDecision());
+}
+
+void TestAllLosses() {
+    //A bot that loses every game is no stronger; that should be clear in a few dozen games.
+    Sprt test(0, 5, 0.05, 0.05);
+    const int numGames = PlayUntilDecided(&test, 0, 1000);
+
+    CHECK(numGames > 0 && numGames < 100);
+    CHECK(Sprt::ACCEPT_H0 == test.getDecision());
+    CHECK(test.getNumLosses() == test.getNumGames());
+}
+
+void TestAllWins() {
+    Sprt test(0, 5, 0.05, 0.05);
+    const int numGames = PlayUntilDecided(&test, 1, 1000);
+
+    CHECK(numGames > 0 && numGames < 100);
+    CHECK(Sprt::ACCEPT_H1 == test.getDecision());
+    CHECK(test.getNumWins() == test.getNumGames());
+}
+
+void TestBalancedRecord() {
+    //Even bots can't be told apart from bots 5 Elo apart in a hundred games.
+    Sprt test(0, 5, 0.05, 0.05);
+
+    for (int game = 0; game < 100; ++game) {
+        test.addScore(0 == game % 3 ? 0.5 : (game % 2));
+    }
+
+    CHECK(test.getNumWins() > 0 && test.getNumDraws() > 0 && test.getNumLosses() > 0);
+    CHECK(Sprt::UNDECIDED == test.getDecision());
+    CHECK(test.getLlr() > test.getLowerBound() && test.getLlr() < test.getUpperBound());
+}
+
+void TestStrongerBot() {
+    //Two wins for every loss is far more than 5 Elo, and is accepted in the end.
+    Sprt test(0, 5, 0.05, 0.05);
+
+    for (int game = 0; game < 3000 && Sprt::UNDECIDED == test.getDecision(); ++game) {
+        test.addScore(0 == game % 3 ? 0 : 1);
+    }
+
+    CHECK(Sprt::ACCEPT_H1 == test.getDecision());
+}
+
+} //namespace
+
+void TestSprt() {
+    TestNoGames();
+    TestAllLosses();
+    TestAllWins();
+    TestBalancedRecord();
+    TestStrongerBot();
+}
@@ -0,0 +1,27 @@
+//Available under GPL v3 license.
+//Author: Iouri Khramtsov.
+
+//This file contains the checks shared by the tests.
+
+#ifndef TEST_H
+#define TEST_H
+
+#include <cstdio>
+
+//Number of checks that have failed so far.
+extern int g_numFailures;
+
+//Check a condition; if it doesn't hold, report where and go on with the test.
+#define CHECK(condition) \
+    do { \
+        if (!(condition)) { \
+            fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #condition); \
+            ++g_numFailures; \
+        } \
+    } while (0)
+
+//The test suites.
+void TestSprt();
+void TestEngine();
+
+#endif // TEST_H
@@ -0,0 +1,11 @@
+# Tests of the parts that don't need Qt.  Run the built program; it fails if any check does.
+
+TEMPLATE = app
+CONFIG += console
+CONFIG -= qt app_bundle
+TARGET = tests
+INCLUDEPATH += . ..
+
+# Input
+HEADERS += test.h ../sprt.h ../planetwars.h ../rules.h ../utils.h
+SOURCES += main.cpp sprttest.cpp enginetest.cpp ../sprt.cpp ../planetwars.cpp ../rules.cpp ../utils.cpp
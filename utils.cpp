@@ -38,3 +38,14 @@ std::vector<std::string> Tokenize(const std::string& s, const std::string& delim
 
     return tokens;
 }
+
+unsigned long long HashBytes(const char* data, size_t size) {
+    unsigned long long hash = 14695981039346656037ULL;
+
+    for (size_t i = 0; i < size; ++i) {
+        hash ^= static_cast<uchar>(data[i]);
+        hash *= 1099511628211ULL;
+    }
+
+    return hash;
+}
@@ -15,5 +15,8 @@ std::string TrimSpaces(const std::string& str);
 //Split a string into tokens given delimeters to use during tokenization.
 std::vector<std::string> Tokenize(const std::string& s, const std::string& delimiters);
 
+//Hash a block of bytes (64-bit FNV-1a).
+unsigned long long HashBytes(const char* data, size_t size);
+
 
 #endif // UTILS_H